@@ -179,6 +179,18 @@ namespace vigra
 
         virtual unsigned int getOffset() const = 0;
 
+        // Restrict decoding to the rectangle starting at 'ul' with the
+        // given size. Must be called before the first nextScanline().
+        // Codecs that can skip the data outside the region return true
+        // and afterwards report the region's size in getWidth() and
+        // getHeight(). The default returns false, and the caller has
+        // to crop the full scanlines itself.
+        virtual bool setRegionOfInterest( const vigra::Diff2D & /*ul*/,
+                                          const vigra::Size2D & /*size*/ )
+        {
+            return false;
+        }
+
         virtual const void * currentScanlineOfBand( unsigned int ) const = 0;
         virtual void nextScanline() = 0;
 
@@ -228,6 +240,23 @@ namespace vigra
         {
         }
 
+        // zlib level (0 ... 9, or -1 for the library default) and strategy
+        // ("DEFAULT", "FILTERED", "HUFFMAN_ONLY", "RLE", "FIXED") of
+        // deflate compressed image data. Other codecs ignore them.
+        virtual void setCompressionLevel( int /*level*/ )
+        {
+        }
+        virtual void setCompressionStrategy( const std::string & /*strategy*/ )
+        {
+        }
+
+        // Number of threads that may compress independent parts of the
+        // image data concurrently, with the semantics of
+        // ParallelOptions::numThreads(). The default ignores it.
+        virtual void setNumThreads( int /*n*/ )
+        {
+        }
+
         virtual void * currentScanlineOfBand( unsigned int ) = 0;
         virtual void nextScanline() = 0;
 
@@ -210,6 +210,21 @@
     #define VIGRA_EXPORT
 #endif
 
+// multi-threading is available when the compiler provides the C++11 
+// thread support library (define VIGRA_SINGLE_THREADED to switch it off)
+#if !defined(VIGRA_SINGLE_THREADED) && \
+    (__cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700))
+    #define VIGRA_HAS_STD_THREADS
+#endif
+
+// destructors are implicitly noexcept in C++11, but the InitProxy classes
+// of the kernels report errors by throwing from their destructors
+#if __cplusplus >= 201103L
+    #define VIGRA_DESTRUCTOR_MAY_THROW noexcept(false)
+#else
+    #define VIGRA_DESTRUCTOR_MAY_THROW
+#endif
+
 namespace vigra {
 
 #ifndef SPECIAL_STDEXCEPTION_DEFINITION_NEEDED
@@ -0,0 +1,469 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2011 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_HDF5BLOCKWISE_HXX
+#define VIGRA_HDF5BLOCKWISE_HXX
+
+#include "config.hxx"
+#include "hdf5impex.hxx"
+#include "multi_array.hxx"
+#include "multi_convolution.hxx"
+#include "threadpool.hxx"
+#include <string>
+#include <algorithm>
+
+namespace vigra {
+
+/** \addtogroup MultiArrayConvolutionFilters
+*/
+//@{
+
+/********************************************************/
+/*                                                      */
+/*                   BlockwiseOptions                   */
+/*                                                      */
+/********************************************************/
+
+/** \brief Options for the blockwise filters on HDF5 datasets.
+
+    In addition to the number of threads (see \ref vigra::ParallelOptions),
+    the options specify the shape of the blocks (default: 128 along every
+    dimension) and the compression level of the output dataset
+    (default: 0, i.e. no compression). The output dataset is chunked with
+    the block shape.
+
+    <b>\#include</b> \<vigra/hdf5blockwise.hxx\><br>
+    Namespace: vigra
+*/
+template <unsigned int N>
+class BlockwiseOptions
+: public ParallelOptions
+{
+  public:
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    BlockwiseOptions()
+    : blockShape_(128),
+      compression_(0)
+    {}
+
+        /** Shape of the blocks that are processed independently (excluding the halo).
+        */
+    BlockwiseOptions & blockShape(Shape const & shape)
+    {
+        blockShape_ = shape;
+        return *this;
+    }
+
+        /** Number of threads that process blocks concurrently
+            (see \ref vigra::ParallelOptions::numThreads()).
+        */
+    BlockwiseOptions & numThreads(int n)
+    {
+        ParallelOptions::numThreads(n);
+        return *this;
+    }
+
+        /** Deflate compression level of the output dataset (0 ... 9).
+        */
+    BlockwiseOptions & compression(int level)
+    {
+        compression_ = level;
+        return *this;
+    }
+
+    Shape getBlockShape() const
+    {
+        return blockShape_;
+    }
+
+    int getCompression() const
+    {
+        return compression_;
+    }
+
+    Shape blockShape_;
+    int compression_;
+};
+
+//@}
+
+namespace detail {
+
+inline MultiArrayIndex
+gaussianHaloWidth(double sigma, int maxOrder)
+{
+    MultiArrayIndex halo = 0;
+    for(int order = 0; order <= maxOrder; ++order)
+    {
+        Kernel1D<double> kernel;
+        kernel.initGaussianDerivative(sigma, order);
+        halo = std::max<MultiArrayIndex>(halo, std::max(-kernel.left(), kernel.right()));
+    }
+    return halo;
+}
+
+template <class T>
+struct BlockwiseHDF5Result
+{
+    template <unsigned int N>
+    static void create(HDF5File & file, std::string const & name,
+                       TinyVector<MultiArrayIndex, N> const & shape,
+                       TinyVector<MultiArrayIndex, N> const & chunks, int compression)
+    {
+        file.createDataset<N, T>(name, shape, T(), chunks, compression);
+    }
+
+    template <unsigned int N>
+    static void write(HDF5File & file, std::string const & name,
+                      TinyVector<MultiArrayIndex, N> const & offset,
+                      MultiArrayView<N, T, UnstridedArrayTag> const & block)
+    {
+        file.writeBlock(name, offset, block);
+    }
+};
+
+    // vector-valued results are stored with the channel as innermost dimension
+    // (the same layout as HDF5File::write() uses for TinyVector arrays)
+template <class T, int SIZE>
+struct BlockwiseHDF5Result<TinyVector<T, SIZE> >
+{
+    template <unsigned int N>
+    static void create(HDF5File & file, std::string const & name,
+                       TinyVector<MultiArrayIndex, N> const & shape,
+                       TinyVector<MultiArrayIndex, N> const & chunks, int compression)
+    {
+        typename MultiArrayShape<N+1>::type vshape(SIZE), vchunks(SIZE);
+        for(unsigned int k=0; k<N; ++k)
+        {
+            vshape[k+1] = shape[k];
+            vchunks[k+1] = chunks[k];
+        }
+        file.createDataset<N+1, T>(name, vshape, T(), vchunks, compression);
+    }
+
+    template <unsigned int N>
+    static void write(HDF5File & file, std::string const & name,
+                      TinyVector<MultiArrayIndex, N> const & offset,
+                      MultiArrayView<N, TinyVector<T, SIZE>, UnstridedArrayTag> const & block)
+    {
+        typename MultiArrayShape<N+1>::type voffset, vshape(SIZE);
+        for(unsigned int k=0; k<N; ++k)
+        {
+            voffset[k+1] = offset[k];
+            vshape[k+1] = block.shape(k);
+        }
+        MultiArrayView<N+1, T, UnstridedArrayTag> scalarView(vshape, (T *)block.data());
+        file.writeBlock(name, voffset, scalarView);
+    }
+};
+
+    // Process one block: read it together with its halo, apply the filter, and
+    // write back the interior. The HDF5 library is not thread-safe, so all
+    // file accesses are serialized by the mutex, whereas the filters run concurrently.
+template <unsigned int N, class Filter>
+struct BlockwiseHDF5Functor
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef typename Filter::value_type       ValueType;
+    typedef typename Filter::result_type      ResultType;
+
+    HDF5File * source, * dest;
+    std::string sourceName, destName;
+    Filter filter;
+    Shape shape, blockShape, blockCount;
+    MultiArrayIndex halo;
+    Mutex * mutex;
+
+    void operator()(int /* threadIndex */, std::ptrdiff_t blockIndex) const
+    {
+        Shape begin, end, haloBegin, haloEnd;
+        for(unsigned int k=0; k<N; ++k)
+        {
+            begin[k] = (blockIndex % blockCount[k]) * blockShape[k];
+            blockIndex /= blockCount[k];
+            end[k] = std::min(begin[k] + blockShape[k], shape[k]);
+            haloBegin[k] = std::max<MultiArrayIndex>(begin[k] - halo, 0);
+            haloEnd[k] = std::min(end[k] + halo, shape[k]);
+        }
+
+        MultiArray<N, ValueType> in(haloEnd - haloBegin);
+        {
+            LockGuard lock(*mutex);
+            source->readBlock(sourceName, haloBegin, haloEnd - haloBegin, in);
+        }
+
+        MultiArray<N, ResultType> out(in.shape());
+        filter(in, out);
+
+        MultiArray<N, ResultType> interior(out.subarray(begin - haloBegin, end - haloBegin));
+        {
+            LockGuard lock(*mutex);
+            BlockwiseHDF5Result<ResultType>::template write<N>(*dest, destName, begin, interior);
+        }
+    }
+};
+
+template <unsigned int N, class Filter>
+void
+blockwiseFilterHDF5(HDF5File & source, std::string const & sourceName,
+                    HDF5File & dest, std::string const & destName,
+                    Filter const & filter, MultiArrayIndex halo,
+                    BlockwiseOptions<N> const & options, const char * function)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    vigra_precondition(&source != &dest ||
+                       source.get_absolute_path(sourceName) != dest.get_absolute_path(destName),
+        std::string(function) + "(): source and destination must be different datasets.");
+    vigra_precondition(source.getDatasetDimensions(sourceName) == (hssize_t)N,
+        std::string(function) + "(): dimension of the source dataset doesn't match BlockwiseOptions<N>.");
+
+    ArrayVector<hsize_t> datasetShape = source.getDatasetShape(sourceName);
+    Shape blockShape = options.getBlockShape(), shape, chunks, blockCount;
+    std::ptrdiff_t blocks = 1;
+    for(unsigned int k=0; k<N; ++k)
+    {
+        vigra_precondition(blockShape[k] > 0,
+            std::string(function) + "(): block shape must be positive.");
+        shape[k] = datasetShape[k];
+        chunks[k] = std::min(blockShape[k], shape[k]);
+        blockCount[k] = (shape[k] + blockShape[k] - 1) / blockShape[k];
+        blocks *= blockCount[k];
+    }
+
+    BlockwiseHDF5Result<typename Filter::result_type>::template create<N>(dest, destName, shape, chunks,
+                                                                        options.getCompression());
+    if(blocks == 0)
+        return;
+
+    Mutex mutex;
+    BlockwiseHDF5Functor<N, Filter> f;
+    f.source = &source;
+    f.dest = &dest;
+    f.sourceName = sourceName;
+    f.destName = destName;
+    f.filter = filter;
+    f.shape = shape;
+    f.blockShape = blockShape;
+    f.blockCount = blockCount;
+    f.halo = halo;
+    f.mutex = &mutex;
+
+    parallel_foreach(options, blocks, f);
+    dest.flushToDisk();
+}
+
+template <class T>
+struct BlockwiseGaussianSmoothing
+{
+    typedef T value_type;
+    typedef T result_type;
+
+    double sigma;
+
+    template <unsigned int N>
+    void operator()(MultiArrayView<N, T, UnstridedArrayTag> const & in,
+                    MultiArrayView<N, T, UnstridedArrayTag> out) const
+    {
+        gaussianSmoothMultiArray(srcMultiArrayRange(in), destMultiArray(out), sigma);
+    }
+};
+
+template <class T, unsigned int N>
+struct BlockwiseGaussianGradient
+{
+    typedef T value_type;
+    typedef TinyVector<T, N> result_type;
+
+    double sigma;
+
+    void operator()(MultiArrayView<N, T, UnstridedArrayTag> const & in,
+                    MultiArrayView<N, result_type, UnstridedArrayTag> out) const
+    {
+        gaussianGradientMultiArray(srcMultiArrayRange(in), destMultiArray(out), sigma);
+    }
+};
+
+template <class T, unsigned int N>
+struct BlockwiseHessianOfGaussian
+{
+    typedef T value_type;
+    typedef TinyVector<T, N*(N+1)/2> result_type;
+
+    double sigma;
+
+    void operator()(MultiArrayView<N, T, UnstridedArrayTag> const & in,
+                    MultiArrayView<N, result_type, UnstridedArrayTag> out) const
+    {
+        hessianOfGaussianMultiArray(srcMultiArrayRange(in), destMultiArray(out), sigma);
+    }
+};
+
+} // namespace detail
+
+/** \addtogroup MultiArrayConvolutionFilters
+*/
+//@{
+
+/********************************************************/
+/*                                                      */
+/*                  gaussianSmoothHDF5                  */
+/*                                                      */
+/********************************************************/
+
+/** \brief Blockwise Gaussian smoothing of an HDF5 dataset.
+
+    These functions apply \ref gaussianSmoothMultiArray(), \ref gaussianGradientMultiArray(),
+    and \ref hessianOfGaussianMultiArray() to N-dimensional datasets that are too big to
+    be loaded into memory. The source dataset is read block by block
+    (\ref HDF5File::readBlock()), where each block is enlarged by a halo whose width
+    equals the radius of the filter kernels. The filter is applied to the enlarged block,
+    and the interior is written to the destination dataset (\ref HDF5File::writeBlock()),
+    which is created (or replaced) with the same shape as the source, element type
+    <tt>T</tt>, and chunks of the block shape. Since the halo contains all data
+    the interior depends on, the result is identical to the result of the in-memory
+    functions.
+
+    The peak memory consumption is determined by the block shape and the number
+    of threads: each thread holds one enlarged block and its result. Independent blocks
+    are filtered concurrently (see \ref vigra::BlockwiseOptions), while the accesses
+    to the HDF5 library (which is not thread-safe) are serialized.
+
+    The source data are converted to <tt>T</tt> upon reading (which must therefore be
+    specified explicitly). The gradient and the Hessian are stored as datasets with
+    an additional innermost dimension of size N resp. N*(N+1)/2, like in
+    \ref HDF5File::write() for <tt>TinyVector</tt> arrays. The source and destination
+    may reside in the same file, but must be different datasets.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <class T, unsigned int N>
+        void
+        gaussianSmoothHDF5(HDF5File & source, std::string const & sourceName,
+                           HDF5File & dest, std::string const & destName,
+                           double sigma, BlockwiseOptions<N> const & options);
+
+        template <class T, unsigned int N>
+        void
+        gaussianGradientHDF5(HDF5File & source, std::string const & sourceName,
+                             HDF5File & dest, std::string const & destName,
+                             double sigma, BlockwiseOptions<N> const & options);
+
+        template <class T, unsigned int N>
+        void
+        hessianOfGaussianHDF5(HDF5File & source, std::string const & sourceName,
+                              HDF5File & dest, std::string const & destName,
+                              double sigma, BlockwiseOptions<N> const & options);
+    }
+    \endcode
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/hdf5blockwise.hxx\><br>
+    Namespace: vigra
+
+    \code
+    HDF5File file("stack.h5", HDF5File::Open);
+
+    // smooth the 3D dataset "raw" in blocks of 256^3 voxels using 16 threads
+    gaussianSmoothHDF5<float>(file, "raw", file, "smoothed", 2.0,
+                              BlockwiseOptions<3>().blockShape(Shape3(256)).numThreads(16));
+    \endcode
+
+    \see gaussianSmoothMultiArray(), gaussianGradientMultiArray(), hessianOfGaussianMultiArray()
+*/
+doxygen_overloaded_function(template <...> void gaussianSmoothHDF5)
+
+template <class T, unsigned int N>
+void
+gaussianSmoothHDF5(HDF5File & source, std::string const & sourceName,
+                   HDF5File & dest, std::string const & destName,
+                   double sigma, BlockwiseOptions<N> const & options = BlockwiseOptions<N>())
+{
+    vigra_precondition(sigma > 0.0, "gaussianSmoothHDF5(): Scale must be positive.");
+
+    detail::BlockwiseGaussianSmoothing<T> filter;
+    filter.sigma = sigma;
+    detail::blockwiseFilterHDF5(source, sourceName, dest, destName, filter,
+                                detail::gaussianHaloWidth(sigma, 0), options,
+                                "gaussianSmoothHDF5");
+}
+
+/** \brief Blockwise Gaussian gradient of an HDF5 dataset.
+
+    See \ref gaussianSmoothHDF5() for a detailed description.
+*/
+template <class T, unsigned int N>
+void
+gaussianGradientHDF5(HDF5File & source, std::string const & sourceName,
+                     HDF5File & dest, std::string const & destName,
+                     double sigma, BlockwiseOptions<N> const & options = BlockwiseOptions<N>())
+{
+    vigra_precondition(sigma > 0.0, "gaussianGradientHDF5(): Scale must be positive.");
+
+    detail::BlockwiseGaussianGradient<T, N> filter;
+    filter.sigma = sigma;
+    detail::blockwiseFilterHDF5(source, sourceName, dest, destName, filter,
+                                detail::gaussianHaloWidth(sigma, 1), options,
+                                "gaussianGradientHDF5");
+}
+
+/** \brief Blockwise Hessian of Gaussian of an HDF5 dataset.
+
+    See \ref gaussianSmoothHDF5() for a detailed description.
+*/
+template <class T, unsigned int N>
+void
+hessianOfGaussianHDF5(HDF5File & source, std::string const & sourceName,
+                      HDF5File & dest, std::string const & destName,
+                      double sigma, BlockwiseOptions<N> const & options = BlockwiseOptions<N>())
+{
+    vigra_precondition(sigma > 0.0, "hessianOfGaussianHDF5(): Scale must be positive.");
+
+    detail::BlockwiseHessianOfGaussian<T, N> filter;
+    filter.sigma = sigma;
+    detail::blockwiseFilterHDF5(source, sourceName, dest, destName, filter,
+                                detail::gaussianHaloWidth(sigma, 2), options,
+                                "hessianOfGaussianHDF5");
+}
+
+//@}
+
+} // namespace vigra
+
+#endif // VIGRA_HDF5BLOCKWISE_HXX
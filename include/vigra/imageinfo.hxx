@@ -253,6 +253,39 @@ class ImageExportInfo
     
     VIGRA_EXPORT const char * getCompression() const;
 
+        /** Set the zlib compression level of deflate compressed image data.
+
+            Recognized by PNG and by TIFF with "DEFLATE" compression. Valid
+            levels range from 0 (no compression) to 9 (best compression).
+            The default -1 selects zlib's default level (6).
+         **/
+    VIGRA_EXPORT ImageExportInfo & setCompressionLevel( int level );
+
+    VIGRA_EXPORT int getCompressionLevel() const;
+
+        /** Set the zlib compression strategy of deflate compressed image data.
+
+            Recognized by PNG and by TIFF with "DEFLATE" compression. Valid
+            arguments are "DEFAULT", "FILTERED", "HUFFMAN_ONLY", "RLE" and
+            "FIXED" (see the zlib documentation of <tt>deflateInit2()</tt>).
+            "RLE" is often as good as "DEFAULT" for images, but much faster.
+         **/
+    VIGRA_EXPORT ImageExportInfo & setCompressionStrategy( const char * strategy );
+
+    VIGRA_EXPORT const char * getCompressionStrategy() const;
+
+        /** Set the number of threads that compress the image data.
+
+            PNG files and "DEFLATE" compressed TIFF files are then
+            compressed in independent parts, one per thread. The
+            values have the same meaning as in ParallelOptions::numThreads():
+            <tt>ParallelOptions::Auto</tt> (-1) uses one thread per core, and 0 or 1
+            (the default) compresses the data in the calling thread.
+         **/
+    VIGRA_EXPORT ImageExportInfo & setNumThreads( int n );
+
+    VIGRA_EXPORT int getNumThreads() const;
+
         /** Set the pixel type of the image file. Possible values are:
             <DL>
             <DT>"UINT8"<DD> 8-bit unsigned integer (unsigned char)
@@ -352,7 +385,8 @@ class ImageExportInfo
     VIGRA_EXPORT ImageExportInfo & setICCProfile(const ICCProfile & profile);
 
   private:
-    std::string m_filename, m_filetype, m_pixeltype, m_comp;
+    std::string m_filename, m_filetype, m_pixeltype, m_comp, m_comp_strategy;
+    int m_comp_level, m_num_threads;
     float m_x_res, m_y_res;
     Diff2D m_pos;
     ICCProfile m_icc_profile;
@@ -523,12 +557,30 @@ class ImageImportInfo
          **/
     VIGRA_EXPORT const ICCProfile & getICCProfile() const;
 
+        /** Restrict importImage() to the given sub-rectangle of the image.
+
+            The destination image must have the size of the region.
+            Codecs that store the image in independently decodable
+            pieces (tiled and stripped TIFF) only decode the tiles or
+            strips that intersect the region, so that small regions of
+            very large files can be read quickly. Other codecs decode
+            the full scanlines and discard the pixels outside the region.
+            The region must be non-empty and lie inside the image.
+            By default, the region covers the entire image.
+         **/
+    VIGRA_EXPORT ImageImportInfo & setRegionOfInterest( Rect2D const & roi );
+
+        /** Get the region that importImage() will read.
+         **/
+    VIGRA_EXPORT Rect2D const & getRegionOfInterest() const;
+
   private:
     std::string m_filename, m_filetype, m_pixeltype;
     int m_width, m_height, m_num_bands, m_num_extra_bands;
     float m_x_res, m_y_res;
     Diff2D m_pos;
     Size2D m_canvas_size;
+    Rect2D m_roi;
     ICCProfile m_icc_profile;
 };
 
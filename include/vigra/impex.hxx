@@ -69,12 +69,161 @@
 #include "multi_array.hxx"
 #include <typeinfo>
 #include <iostream>
+#include <cstring>
 
 // TODO
 // next refactoring: pluggable conversion algorithms
 
 namespace vigra
 {
+
+namespace detail {
+
+// Whole-scanline transfer between the interleaved buffers of a codec
+// and images whose rows are plain arrays of pixels. The generic
+// readScanline()/writeScanline() return false, and read_bands() etc.
+// fall back to their per-pixel accessor loops. The overloads for const
+// and mutable row pointers are both needed, because the generic version
+// would otherwise be the better match for the latter. Pixel rows are
+// addressed through a pointer to the row's first component rather than
+// through one pixel's begin(), which must not be advanced past that pixel.
+
+template <class SrcValueType, class DstValueType>
+inline void
+convertScanline(SrcValueType const * src, DstValueType * dest, std::size_t n)
+{
+    for(std::size_t i = 0; i < n; ++i)
+        dest[i] = RequiresExplicitCast<DstValueType>::cast(src[i]);
+}
+
+template <class T>
+inline void
+convertScanline(T const * src, T * dest, std::size_t n)
+{
+    std::memcpy(dest, src, n*sizeof(T));
+}
+
+// true if the current scanline of 'codec' holds the bands pixel by pixel
+// without gaps, i.e. band b of pixel x is at currentScanlineOfBand(0)[x*num_bands+b]
+template <class ValueType, class Codec>
+inline bool
+isInterleavedScanline(Codec * codec, unsigned int num_bands)
+{
+    if(codec->getOffset() != num_bands)
+        return false;
+    ValueType const * band0 = static_cast<ValueType const *>(codec->currentScanlineOfBand(0));
+    for(unsigned int b = 1; b < num_bands; ++b)
+        if(static_cast<ValueType const *>(codec->currentScanlineOfBand(b)) != band0 + b)
+            return false;
+    return true;
+}
+
+template <class SrcValueType, class DstRowIterator, class Accessor>
+inline bool
+readScanline(SrcValueType const *, DstRowIterator, Accessor, unsigned int)
+{
+    return false;
+}
+
+template <class SrcValueType, class T>
+inline bool
+readScanline(SrcValueType const * src, T * dest, StandardValueAccessor<T>, unsigned int width)
+{
+    convertScanline(src, dest, width);
+    return true;
+}
+
+template <class SrcValueType, class T, unsigned int R, unsigned int G, unsigned int B>
+inline bool
+readScanline(SrcValueType const * src, RGBValue<T, R, G, B> * dest,
+             RGBAccessor<RGBValue<T, R, G, B> >, unsigned int width)
+{
+    if(sizeof(RGBValue<T, R, G, B>) != 3*sizeof(T) || R != 0 || G != 1 || B != 2)
+        return false;
+    convertScanline(src, reinterpret_cast<T *>(dest), 3*width);
+    return true;
+}
+
+template <class SrcValueType, class T, int N>
+inline bool
+readScanline(SrcValueType const * src, TinyVector<T, N> * dest,
+             VectorAccessor<TinyVector<T, N> >, unsigned int width)
+{
+    if(sizeof(TinyVector<T, N>) != N*sizeof(T))
+        return false;
+    convertScanline(src, reinterpret_cast<T *>(dest), N*width);
+    return true;
+}
+
+template <class SrcRowIterator, class Accessor, class DstValueType>
+inline bool
+writeScanline(SrcRowIterator, Accessor, DstValueType *, unsigned int)
+{
+    return false;
+}
+
+template <class T, class DstValueType>
+inline bool
+writeScanline(T const * src, StandardConstValueAccessor<T>, DstValueType * dest, unsigned int width)
+{
+    convertScanline(src, dest, width);
+    return true;
+}
+
+template <class T, class DstValueType>
+inline bool
+writeScanline(T * src, StandardValueAccessor<T>, DstValueType * dest, unsigned int width)
+{
+    convertScanline(src, dest, width);
+    return true;
+}
+
+template <class T, unsigned int R, unsigned int G, unsigned int B, class DstValueType>
+inline bool
+writeScanline(RGBValue<T, R, G, B> const * src, RGBAccessor<RGBValue<T, R, G, B> >,
+              DstValueType * dest, unsigned int width)
+{
+    if(sizeof(RGBValue<T, R, G, B>) != 3*sizeof(T) || R != 0 || G != 1 || B != 2)
+        return false;
+    convertScanline(reinterpret_cast<T const *>(src), dest, 3*width);
+    return true;
+}
+
+template <class T, unsigned int R, unsigned int G, unsigned int B, class DstValueType>
+inline bool
+writeScanline(RGBValue<T, R, G, B> * src, RGBAccessor<RGBValue<T, R, G, B> >,
+              DstValueType * dest, unsigned int width)
+{
+    if(sizeof(RGBValue<T, R, G, B>) != 3*sizeof(T) || R != 0 || G != 1 || B != 2)
+        return false;
+    convertScanline(reinterpret_cast<T const *>(src), dest, 3*width);
+    return true;
+}
+
+template <class T, int N, class DstValueType>
+inline bool
+writeScanline(TinyVector<T, N> const * src, VectorAccessor<TinyVector<T, N> >,
+              DstValueType * dest, unsigned int width)
+{
+    if(sizeof(TinyVector<T, N>) != N*sizeof(T))
+        return false;
+    convertScanline(reinterpret_cast<T const *>(src), dest, N*width);
+    return true;
+}
+
+template <class T, int N, class DstValueType>
+inline bool
+writeScanline(TinyVector<T, N> * src, VectorAccessor<TinyVector<T, N> >,
+              DstValueType * dest, unsigned int width)
+{
+    if(sizeof(TinyVector<T, N>) != N*sizeof(T))
+        return false;
+    convertScanline(reinterpret_cast<T const *>(src), dest, N*width);
+    return true;
+}
+
+} // namespace detail
+
 /** \addtogroup VigraImpex
 **/
 //@{
@@ -131,6 +280,10 @@ namespace vigra
             {
                 dec->nextScanline();
                 xs = ys.rowIterator();
+                if(detail::isInterleavedScanline<SrcValueType>(dec, num_bands) &&
+                   detail::readScanline(static_cast< SrcValueType const * >(dec->currentScanlineOfBand(0)),
+                                        xs, a, width))
+                    continue;
                 scanline0 = static_cast< SrcValueType const * >
                     (dec->currentScanlineOfBand(0));
                 scanline1 = static_cast< SrcValueType const * >
@@ -158,6 +311,11 @@ namespace vigra
             for( size_type y = 0; y < height; ++y, ++ys.y ) 
             {
                 dec->nextScanline();
+                xs = ys.rowIterator();
+                if(detail::isInterleavedScanline<SrcValueType>(dec, num_bands) &&
+                   detail::readScanline(static_cast< SrcValueType const * >(dec->currentScanlineOfBand(0)),
+                                        xs, a, width))
+                    continue;
                 for( size_type b = 0; b < num_bands; ++b ) 
                 {
                     xs = ys.rowIterator();
@@ -205,6 +363,10 @@ namespace vigra
         {
             dec->nextScanline();
             xs = ys.rowIterator();
+            if(detail::isInterleavedScanline<SrcValueType>(dec, num_bands) &&
+               detail::readScanline(static_cast< SrcValueType const * >(dec->currentScanlineOfBand(0)),
+                                    xs, a, width))
+                continue;
             scanline0 = static_cast< SrcValueType const * >
                 (dec->currentScanlineOfBand(0));
             scanline1 = static_cast< SrcValueType const * >
@@ -253,6 +415,10 @@ namespace vigra
         {
             dec->nextScanline();
             xs = ys.rowIterator();
+            if(detail::isInterleavedScanline<SrcValueType>(dec, num_bands) &&
+               detail::readScanline(static_cast< SrcValueType const * >(dec->currentScanlineOfBand(0)),
+                                    xs, a, width))
+                continue;
             scanline0 = static_cast< SrcValueType const * >
                 (dec->currentScanlineOfBand(0));
             scanline1 = static_cast< SrcValueType const * >
@@ -303,6 +469,10 @@ namespace vigra
         {
             dec->nextScanline();
             xs = ys.rowIterator();
+            if(detail::isInterleavedScanline<SrcValueType>(dec, num_bands) &&
+               detail::readScanline(static_cast< SrcValueType const * >(dec->currentScanlineOfBand(0)),
+                                    xs, a, width))
+                continue;
             scanline0 = static_cast< SrcValueType const * >
                 (dec->currentScanlineOfBand(0));
             scanline1 = static_cast< SrcValueType const * >
@@ -361,6 +531,8 @@ namespace vigra
             dec->nextScanline();
             xs = ys.rowIterator();
             scanline = static_cast< SrcValueType const * >(dec->currentScanlineOfBand(0));
+            if(detail::readScanline(scanline, xs, a, width))
+                continue;
             for( size_type x = 0; x < width; ++x, ++xs )
                 a.set( scanline[x], xs );
         }
@@ -639,6 +811,12 @@ doxygen_overloaded_function(template <...> void importImage)
             DstValueType * scanline1;
             for( size_type y = 0; y < height; ++y, ++ys.y ) {
                 xs = ys.rowIterator();
+                if(detail::isInterleavedScanline<DstValueType>(enc, num_bands) &&
+                   detail::writeScanline(xs, a, static_cast< DstValueType * >(enc->currentScanlineOfBand(0)), width))
+                {
+                    enc->nextScanline();
+                    continue;
+                }
                 scanline0 = static_cast< DstValueType * >
                         (enc->currentScanlineOfBand(0));
                 scanline1 = static_cast< DstValueType * >
@@ -662,6 +840,12 @@ doxygen_overloaded_function(template <...> void importImage)
             DstValueType * scanline2;
             for( size_type y = 0; y < height; ++y, ++ys.y ) {
                 xs = ys.rowIterator();
+                if(detail::isInterleavedScanline<DstValueType>(enc, num_bands) &&
+                   detail::writeScanline(xs, a, static_cast< DstValueType * >(enc->currentScanlineOfBand(0)), width))
+                {
+                    enc->nextScanline();
+                    continue;
+                }
                 scanline0 = static_cast< DstValueType * >
                         (enc->currentScanlineOfBand(0));
                 scanline1 = static_cast< DstValueType * >
@@ -689,6 +873,12 @@ doxygen_overloaded_function(template <...> void importImage)
             DstValueType * scanline3;
             for( size_type y = 0; y < height; ++y, ++ys.y ) {
                 xs = ys.rowIterator();
+                if(detail::isInterleavedScanline<DstValueType>(enc, num_bands) &&
+                   detail::writeScanline(xs, a, static_cast< DstValueType * >(enc->currentScanlineOfBand(0)), width))
+                {
+                    enc->nextScanline();
+                    continue;
+                }
                 scanline0 = static_cast< DstValueType * >
                         (enc->currentScanlineOfBand(0));
                 scanline1 = static_cast< DstValueType * >
@@ -715,6 +905,13 @@ doxygen_overloaded_function(template <...> void importImage)
           {
             // General case
             for( size_type y = 0; y < height; ++y, ++ys.y ) {
+                xs = ys.rowIterator();
+                if(detail::isInterleavedScanline<DstValueType>(enc, num_bands) &&
+                   detail::writeScanline(xs, a, static_cast< DstValueType * >(enc->currentScanlineOfBand(0)), width))
+                {
+                    enc->nextScanline();
+                    continue;
+                }
                 for( size_type b = 0; b < num_bands; ++b ) {
                     xs = ys.rowIterator();
                     scanline = static_cast< DstValueType * >
@@ -805,8 +1002,9 @@ doxygen_overloaded_function(template <...> void importImage)
         for(  y = 0; y < height; ++y, ++ys.y ) {
             xs = ys.rowIterator();
             scanline = static_cast< DstValueType * >(enc->currentScanlineOfBand(0));
-            for( size_type x = 0; x < width; ++x, ++xs, ++scanline )
-                *scanline = detail::RequiresExplicitCast<DstValueType>::cast(a(xs));
+            if(!detail::writeScanline(xs, a, scanline, width))
+                for( size_type x = 0; x < width; ++x, ++xs, ++scanline )
+                    *scanline = detail::RequiresExplicitCast<DstValueType>::cast(a(xs));
             enc->nextScanline();
         }
     } // write_band()
@@ -40,6 +40,7 @@
 #include "voxelneighborhood.hxx"
 #include "multi_array.hxx"
 #include "union_find.hxx"
+#include "threadpool.hxx"
 
 namespace vigra{
 
@@ -599,6 +600,367 @@ unsigned int labelVolumeWithBackground(SrcIterator s_Iter, SrcShape srcShape, Sr
     return count;
 }
 
+namespace detail {
+
+    // label one slab of z-planes with the sequential algorithm
+template <class SrcIterator, class SrcAccessor, class SrcShape,
+          class DestIterator, class DestAccessor,
+          class Neighborhood3D, class ValueType, class EqualityFunctor>
+struct LabelVolumeSlabFunctor
+{
+    SrcIterator s_Iter;
+    SrcShape srcShape;
+    SrcAccessor sa;
+    DestIterator d_Iter;
+    DestAccessor da;
+    EqualityFunctor equal;
+    bool hasBackground;
+    ValueType backgroundValue;
+    int const * slabBegin;
+    unsigned int * counts;
+
+    void operator()(int, std::ptrdiff_t k) const
+    {
+        SrcIterator zs = s_Iter;
+        DestIterator zd = d_Iter;
+        zs.dim2() += slabBegin[k];
+        zd.dim2() += slabBegin[k];
+        SrcShape shape(srcShape);
+        shape[2] = slabBegin[k+1] - slabBegin[k];
+        if(hasBackground)
+            counts[k] = labelVolumeWithBackground(zs, shape, sa, zd, da, Neighborhood3D(),
+                                                  backgroundValue, equal);
+        else
+            counts[k] = labelVolume(zs, shape, sa, zd, da, Neighborhood3D(), equal);
+    }
+};
+
+    // replace the slab-local labels by the final labels
+template <class DestIterator, class DestAccessor, class SrcShape, class UnionFind>
+struct LabelVolumeRelabelFunctor
+{
+    DestIterator d_Iter;
+    DestAccessor da;
+    SrcShape srcShape;
+    int const * slabBegin;
+    std::size_t const * offsets;
+    UnionFind const * label;
+
+    void operator()(int, std::ptrdiff_t k) const
+    {
+        typedef typename DestAccessor::value_type LabelType;
+        DestIterator zd = d_Iter;
+        zd.dim2() += slabBegin[k];
+        for(int z = slabBegin[k]; z != slabBegin[k+1]; ++z, ++zd.dim2())
+        {
+            DestIterator yd(zd);
+            for(int y = 0; y != srcShape[1]; ++y, ++yd.dim1())
+            {
+                DestIterator xd(yd);
+                for(int x = 0; x != srcShape[0]; ++x, ++xd.dim0())
+                {
+                    std::size_t l = (std::size_t)da(xd);
+                    if(l != 0)
+                        da.set((LabelType)(*label)[l + offsets[k]], xd);
+                }
+            }
+        }
+    }
+};
+
+template <class SrcIterator, class SrcAccessor,class SrcShape,
+          class DestIterator, class DestAccessor,
+          class Neighborhood3D, class ValueType, class EqualityFunctor>
+unsigned int labelVolumeParallel(SrcIterator s_Iter, SrcShape srcShape, SrcAccessor sa,
+                                 DestIterator d_Iter, DestAccessor da,
+                                 Neighborhood3D neighborhood3D, EqualityFunctor equal,
+                                 bool hasBackground, ValueType backgroundValue,
+                                 ParallelOptions const & options)
+{
+    int w = srcShape[0], h = srcShape[1], d = srcShape[2];
+    ThreadPool pool(options);
+    int slabCount = std::min(d, pool.numThreads());
+    if(slabCount < 2)
+    {
+        if(hasBackground)
+            return labelVolumeWithBackground(s_Iter, srcShape, sa, d_Iter, da, neighborhood3D,
+                                             backgroundValue, equal);
+        else
+            return labelVolume(s_Iter, srcShape, sa, d_Iter, da, neighborhood3D, equal);
+    }
+
+    // pass 1: label each slab of z-planes independently. Each slab
+    // numbers its regions 1, 2, ... in scan order.
+    ArrayVector<int> slabBegin(slabCount+1);
+    for(int k=0; k<=slabCount; ++k)
+        slabBegin[k] = (int)((std::ptrdiff_t)k*d / slabCount);
+    ArrayVector<unsigned int> counts(slabCount);
+    LabelVolumeSlabFunctor<SrcIterator, SrcAccessor, SrcShape, DestIterator, DestAccessor,
+                           Neighborhood3D, ValueType, EqualityFunctor> 
+        labelSlab = { s_Iter, srcShape, sa, d_Iter, da, equal, hasBackground, backgroundValue,
+                      slabBegin.data(), counts.data() };
+    parallel_foreach(pool, slabCount, labelSlab);
+
+    // global label = local label + offset of the slab. Since the slabs
+    // are in scan order, a smaller global label always belongs to a region
+    // part that starts earlier in scan order.
+    ArrayVector<std::size_t> offsets(slabCount+1, 0);
+    for(int k=0; k<slabCount; ++k)
+        offsets[k+1] = offsets[k] + counts[k];
+    detail::UnionFindArray<std::size_t> label(offsets[slabCount]+1);
+
+    // pass 2: merge the regions across the slab boundaries, using the 
+    // same neighbor comparisons as the sequential algorithm
+    NeighborOffsetCirculator<Neighborhood3D> nce(Neighborhood3D::CausalLast);
+    ++nce;
+    for(int k=1; k<slabCount; ++k)
+    {
+        SrcIterator ys = s_Iter;
+        DestIterator yd = d_Iter;
+        ys.dim2() += slabBegin[k];
+        yd.dim2() += slabBegin[k];
+        for(int y = 0; y != h; ++y, ++ys.dim1(), ++yd.dim1())
+        {
+            SrcIterator xs(ys);
+            DestIterator xd(yd);
+            for(int x = 0; x != w; ++x, ++xs.dim0(), ++xd.dim0())
+            {
+                if(hasBackground && equal(sa(xs), backgroundValue))
+                    continue;
+                std::size_t current = (std::size_t)da(xd) + offsets[k];
+                NeighborOffsetCirculator<Neighborhood3D> nc(Neighborhood3D::CausalFirst);
+                do
+                {
+                    Diff3D const & diff = *nc;
+                    if(diff[2] == -1 && x + diff[0] >= 0 && x + diff[0] < w 
+                                     && y + diff[1] >= 0 && y + diff[1] < h
+                                     && equal(sa(xs), sa(xs, diff)))
+                    {
+                        std::size_t neighbor = (std::size_t)da(xd, diff);
+                        if(neighbor != 0)
+                            neighbor += offsets[k-1];
+                        current = label.makeUnion(neighbor, current);
+                    }
+                    ++nc;
+                }
+                while(nc != nce);
+            }
+        }
+    }
+
+    // the roots are the region parts that come first in scan order, so
+    // that the final labels are the same as in the sequential algorithm
+    unsigned int count = label.makeContiguous();
+    vigra_invariant(count <= (std::size_t)NumericTraits<typename DestAccessor::value_type>::max(),
+        "connected components: Need more labels than can be represented in the destination type.");
+
+    // pass 3: write the final labels
+    LabelVolumeRelabelFunctor<DestIterator, DestAccessor, SrcShape, 
+                              detail::UnionFindArray<std::size_t> >
+        relabel = { d_Iter, da, srcShape, slabBegin.data(), offsets.data(), &label };
+    parallel_foreach(pool, slabCount, relabel);
+    return count;
+}
+
+} // namespace detail
+
+
+/********************************************************/
+/*                                                      */
+/*              parallel connected components           */
+/*                                                      */
+/********************************************************/
+
+/** \brief Find the connected components of a segmented volume in parallel.
+
+    These variants of \ref labelVolume(), \ref labelVolumeSix() and 
+    \ref labelVolumeWithBackground() take an additional \ref vigra::ParallelOptions
+    argument. The volume is split into one slab of z-planes per thread. Each
+    slab is labeled by the sequential algorithm with its own union-find array. 
+    A second pass merges the regions that touch across the slab boundaries, and 
+    a final parallel pass assigns the final labels. The result (including the
+    numbering of the regions in scan order) is identical to the sequential 
+    version, regardless of the number of threads.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <class SrcIterator, class SrcAccessor,class SrcShape,
+                  class DestIterator, class DestAccessor,
+                  class Neighborhood3D, class EqualityFunctor>
+        unsigned int labelVolume(SrcIterator s_Iter, SrcShape srcShape, SrcAccessor sa,
+                                 DestIterator d_Iter, DestAccessor da,
+                                 Neighborhood3D neighborhood3D, EqualityFunctor equal,
+                                 ParallelOptions const & options);
+
+        template <class SrcIterator, class SrcAccessor,class SrcShape,
+                  class DestIterator, class DestAccessor,
+                  class Neighborhood3D>
+        unsigned int labelVolume(triple<SrcIterator, SrcShape, SrcAccessor> src,
+                                 pair<DestIterator, DestAccessor> dest,
+                                 Neighborhood3D neighborhood3D, 
+                                 ParallelOptions const & options);
+
+        template <class SrcIterator, class SrcAccessor,class SrcShape,
+                  class DestIterator, class DestAccessor>
+        unsigned int labelVolumeSix(triple<SrcIterator, SrcShape, SrcAccessor> src,
+                                    pair<DestIterator, DestAccessor> dest,
+                                    ParallelOptions const & options);
+
+        template <class SrcIterator, class SrcAccessor,class SrcShape,
+                  class DestIterator, class DestAccessor,
+                  class Neighborhood3D, class ValueType, class EqualityFunctor>
+        unsigned int labelVolumeWithBackground(SrcIterator s_Iter, SrcShape srcShape, SrcAccessor sa,
+                                               DestIterator d_Iter, DestAccessor da,
+                                               Neighborhood3D neighborhood3D, ValueType background_value,
+                                               EqualityFunctor equal, 
+                                               ParallelOptions const & options);
+
+        template <class SrcIterator, class SrcAccessor,class SrcShape,
+                  class DestIterator, class DestAccessor,
+                  class Neighborhood3D, class ValueType>
+        unsigned int labelVolumeWithBackground(triple<SrcIterator, SrcShape, SrcAccessor> src,
+                                               pair<DestIterator, DestAccessor> dest,
+                                               Neighborhood3D neighborhood3D, ValueType background_value,
+                                               ParallelOptions const & options);
+    }
+    \endcode
+
+    (The remaining combinations of argument objects and optional arguments 
+    are also provided.)
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/labelvolume.hxx\><br>
+    Namespace: vigra
+
+    \code
+    typedef vigra::MultiArray<3,int> IntVolume;
+    IntVolume src(IntVolume::difference_type(w,h,d));
+    IntVolume dest(IntVolume::difference_type(w,h,d));
+    
+    // find 26-connected regions using 8 threads
+    int max_region_label = vigra::labelVolume(srcMultiArrayRange(src), destMultiArray(dest), 
+                                              NeighborCode3DTwentySix(), 
+                                              ParallelOptions().numThreads(8));
+    \endcode
+*/
+doxygen_overloaded_function(template <...> unsigned int labelVolume)
+
+template <class SrcIterator, class SrcAccessor,class SrcShape,
+          class DestIterator, class DestAccessor,
+          class Neighborhood3D, class EqualityFunctor>
+unsigned int labelVolume(SrcIterator s_Iter, SrcShape srcShape, SrcAccessor sa,
+                         DestIterator d_Iter, DestAccessor da,
+                         Neighborhood3D neighborhood3D, EqualityFunctor equal,
+                         ParallelOptions const & options)
+{
+    return detail::labelVolumeParallel(s_Iter, srcShape, sa, d_Iter, da, neighborhood3D, equal, 
+                                       false, typename SrcAccessor::value_type(), options);
+}
+
+template <class SrcIterator, class SrcAccessor,class SrcShape,
+          class DestIterator, class DestAccessor,
+          class Neighborhood3D>
+unsigned int labelVolume(SrcIterator s_Iter, SrcShape srcShape, SrcAccessor sa,
+                         DestIterator d_Iter, DestAccessor da,
+                         Neighborhood3D neighborhood3D,
+                         ParallelOptions const & options)
+{
+    return labelVolume(s_Iter, srcShape, sa, d_Iter, da, neighborhood3D, 
+                       std::equal_to<typename SrcAccessor::value_type>(), options);
+}
+
+template <class SrcIterator, class SrcAccessor,class SrcShape,
+          class DestIterator, class DestAccessor,
+          class Neighborhood3D>
+unsigned int labelVolume(triple<SrcIterator, SrcShape, SrcAccessor> src,
+                         pair<DestIterator, DestAccessor> dest,
+                         Neighborhood3D neighborhood3D,
+                         ParallelOptions const & options)
+{
+    return labelVolume(src.first, src.second, src.third, dest.first, dest.second, neighborhood3D, 
+                       std::equal_to<typename SrcAccessor::value_type>(), options);
+}
+
+template <class SrcIterator, class SrcAccessor,class SrcShape,
+          class DestIterator, class DestAccessor,
+          class Neighborhood3D, class EqualityFunctor>
+unsigned int labelVolume(triple<SrcIterator, SrcShape, SrcAccessor> src,
+                         pair<DestIterator, DestAccessor> dest,
+                         Neighborhood3D neighborhood3D, EqualityFunctor equal,
+                         ParallelOptions const & options)
+{
+    return labelVolume(src.first, src.second, src.third, dest.first, dest.second, neighborhood3D, 
+                       equal, options);
+}
+
+template <class SrcIterator, class SrcAccessor,class SrcShape,
+          class DestIterator, class DestAccessor>
+unsigned int labelVolumeSix(triple<SrcIterator, SrcShape, SrcAccessor> src,
+                            pair<DestIterator, DestAccessor> dest,
+                            ParallelOptions const & options)
+{
+    return labelVolume(src.first, src.second, src.third, dest.first, dest.second, NeighborCode3DSix(), 
+                       std::equal_to<typename SrcAccessor::value_type>(), options);
+}
+
+template <class SrcIterator, class SrcAccessor,class SrcShape,
+          class DestIterator, class DestAccessor,
+          class Neighborhood3D,
+          class ValueType, class EqualityFunctor>
+unsigned int labelVolumeWithBackground(SrcIterator s_Iter, SrcShape srcShape, SrcAccessor sa,
+                                       DestIterator d_Iter, DestAccessor da,
+                                       Neighborhood3D neighborhood3D,
+                                       ValueType backgroundValue, EqualityFunctor equal,
+                                       ParallelOptions const & options)
+{
+    return detail::labelVolumeParallel(s_Iter, srcShape, sa, d_Iter, da, neighborhood3D, equal, 
+                                       true, backgroundValue, options);
+}
+
+template <class SrcIterator, class SrcAccessor,class SrcShape,
+          class DestIterator, class DestAccessor,
+          class Neighborhood3D,
+          class ValueType>
+unsigned int labelVolumeWithBackground(SrcIterator s_Iter, SrcShape srcShape, SrcAccessor sa,
+                                       DestIterator d_Iter, DestAccessor da,
+                                       Neighborhood3D neighborhood3D, ValueType backgroundValue,
+                                       ParallelOptions const & options)
+{
+    return labelVolumeWithBackground(s_Iter, srcShape, sa, d_Iter, da, neighborhood3D, backgroundValue, 
+                                     std::equal_to<typename SrcAccessor::value_type>(), options);
+}
+
+template <class SrcIterator, class SrcAccessor,class SrcShape,
+          class DestIterator, class DestAccessor,
+          class Neighborhood3D,
+          class ValueType>
+unsigned int labelVolumeWithBackground(triple<SrcIterator, SrcShape, SrcAccessor> src,
+                                       pair<DestIterator, DestAccessor> dest,
+                                       Neighborhood3D neighborhood3D, ValueType backgroundValue,
+                                       ParallelOptions const & options)
+{
+    return labelVolumeWithBackground(src.first, src.second, src.third, dest.first, dest.second, 
+                                     neighborhood3D, backgroundValue, 
+                                     std::equal_to<typename SrcAccessor::value_type>(), options);
+}
+
+template <class SrcIterator, class SrcAccessor,class SrcShape,
+          class DestIterator, class DestAccessor,
+          class Neighborhood3D,
+          class ValueType, class EqualityFunctor>
+unsigned int labelVolumeWithBackground(triple<SrcIterator, SrcShape, SrcAccessor> src,
+                                       pair<DestIterator, DestAccessor> dest,
+                                       Neighborhood3D neighborhood3D, ValueType backgroundValue, 
+                                       EqualityFunctor equal,
+                                       ParallelOptions const & options)
+{
+    return labelVolumeWithBackground(src.first, src.second, src.third, dest.first, dest.second, 
+                                     neighborhood3D, backgroundValue, equal, options);
+}
+
 //@}
 
 } //end of namespace vigra
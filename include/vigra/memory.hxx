@@ -37,6 +37,8 @@
 #define VIGRA_MEMORY_HXX
 
 #include "metaprogramming.hxx"
+#include <memory>
+#include <vector>
 
 namespace vigra { 
 
@@ -104,6 +106,140 @@ using std::destroy;
 
 #endif
 
+/********************************************************************/
+
+} // namespace detail
+
+    /** \brief Counters of the record arena of an algorithm.
+
+        Algorithms that allocate many small records (e.g. \ref seededRegionGrowing())
+        can report how their arena used the heap: <tt>blockCount</tt> blocks of
+        <tt>blockSize</tt> records each were requested, at most <tt>peakSize</tt>
+        records were in use at the same time, and <tt>allocationCount</tt>
+        records were handed out in total.
+
+        <b>\#include</b> \<vigra/memory.hxx\><br>
+        Namespace: vigra
+    */
+struct BlockAllocatorStatistics
+{
+    std::size_t blockSize, blockCount, peakSize, allocationCount;
+
+    BlockAllocatorStatistics()
+    : blockSize(0), blockCount(0), peakSize(0), allocationCount(0)
+    {}
+};
+
+namespace detail {
+
+    // Arena for many small objects of the same type, e.g. the candidate
+    // records of seeded region growing. Storage is obtained from the heap
+    // in blocks of 'blockSize' objects and is only returned when the arena
+    // is destroyed. Objects returned by deallocate() are reused in LIFO order.
+    // The arena hands out uninitialized memory, i.e. the caller must construct
+    // and destroy the objects (objects which are still alive when the arena
+    // is destroyed are not destroyed).
+    // The counters allow to check how often the heap was actually called.
+template <class T, class Alloc = std::allocator<T> >
+class BlockAllocator
+{
+  public:
+    typedef std::size_t size_type;
+
+    explicit BlockAllocator(size_type blockSize = 4096)
+    : blockSize_(blockSize > 0 ? blockSize : 1),
+      used_(blockSize_),
+      size_(0), peakSize_(0), allocationCount_(0)
+    {}
+
+    ~BlockAllocator()
+    {
+        for(size_type k=0; k<blocks_.size(); ++k)
+            alloc_.deallocate(blocks_[k], blockSize_);
+    }
+
+    T * allocate()
+    {
+        ++allocationCount_;
+        if(++size_ > peakSize_)
+            peakSize_ = size_;
+
+        if(!freelist_.empty())
+        {
+            T * res = freelist_.back();
+            freelist_.pop_back();
+            return res;
+        }
+        if(used_ == blockSize_)
+        {
+            blocks_.push_back(alloc_.allocate(blockSize_));
+            used_ = 0;
+        }
+        return blocks_.back() + used_++;
+    }
+
+    void deallocate(T * p)
+    {
+        --size_;
+        freelist_.push_back(p);
+    }
+
+        // number of objects per block
+    size_type blockSize() const
+    {
+        return blockSize_;
+    }
+
+        // number of blocks requested from the heap
+    size_type blockCount() const
+    {
+        return blocks_.size();
+    }
+
+        // number of objects that fit into the blocks requested so far
+    size_type capacity() const
+    {
+        return blocks_.size() * blockSize_;
+    }
+
+        // number of objects currently in use
+    size_type size() const
+    {
+        return size_;
+    }
+
+        // maximum number of objects that were in use at the same time
+    size_type peakSize() const
+    {
+        return peakSize_;
+    }
+
+        // total number of calls to allocate()
+    size_type allocationCount() const
+    {
+        return allocationCount_;
+    }
+
+        // all of the above counters
+    BlockAllocatorStatistics statistics() const
+    {
+        BlockAllocatorStatistics res;
+        res.blockSize = blockSize_;
+        res.blockCount = blocks_.size();
+        res.peakSize = peakSize_;
+        res.allocationCount = allocationCount_;
+        return res;
+    }
+
+  private:
+    BlockAllocator(BlockAllocator const &);
+    BlockAllocator & operator=(BlockAllocator const &);
+
+    Alloc alloc_;
+    std::vector<T *> blocks_, freelist_;
+    size_type blockSize_, used_, size_, peakSize_, allocationCount_;
+};
+
 } } // namespace vigra::detail
 
 #endif // VIGRA_MEMORY_HXX
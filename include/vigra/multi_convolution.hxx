@@ -47,6 +47,8 @@
 #include "metaprogramming.hxx"
 #include "multi_pointoperators.hxx"
 #include "functorexpression.hxx"
+#include "threadpool.hxx"
+#include <algorithm>
 
 namespace vigra
 {
@@ -117,6 +119,116 @@ internalSeparableConvolveMultiArrayTmp(
     }
 }
 
+/********************************************************/
+/*                                                      */
+/*         parallel separable convolution helpers       */
+/*                                                      */
+/********************************************************/
+
+    // Convolve all lines along dimension 'dim' that lie in one slab of the array.
+    // The array is cut into slabs along 'splitDim' (which must differ from 'dim'),
+    // so that all slabs contain complete lines and can be processed independently.
+    // Each line is computed exactly as in the sequential version.
+template <class SrcIterator, class Shape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Kernel>
+struct SeparableConvolveSlabFunctor
+{
+    typedef typename NumericTraits<typename DestAccessor::value_type>::RealPromote TmpType;
+    enum { N = 1 + SrcIterator::level };
+
+    SrcIterator si;
+    Shape shape;
+    SrcAccessor src;
+    DestIterator di;
+    DestAccessor dest;
+    Kernel const * kernel;
+    int dim, splitDim;
+    MultiArrayIndex slabCount;
+
+    void operator()(int /* threadIndex */, std::ptrdiff_t slab) const
+    {
+        MultiArrayIndex begin = slab * shape[splitDim] / slabCount,
+                        end   = (slab + 1) * shape[splitDim] / slabCount;
+        if(begin == end)
+            return;
+
+        Shape offset, slabShape(shape);
+        offset[splitDim] = begin;
+        slabShape[splitDim] = end - begin;
+
+        ArrayVector<TmpType> tmp( shape[dim] );
+
+        MultiArrayNavigator<SrcIterator, N> snav( si + offset, slabShape, dim );
+        MultiArrayNavigator<DestIterator, N> dnav( di + offset, slabShape, dim );
+
+        for( ; snav.hasMore(); snav++, dnav++ )
+        {
+             // first copy source to temp for maximum cache efficiency
+             copyLine( snav.begin(), snav.end(), src,
+                       tmp.begin(), typename AccessorTraits<TmpType>::default_accessor() );
+
+             convolveLine( srcIterRange(tmp.begin(), tmp.end(),
+                                        typename AccessorTraits<TmpType>::default_const_accessor()),
+                           destIter( dnav.begin(), dest ),
+                           kernel1d( *kernel ) );
+        }
+    }
+};
+
+template <class SrcIterator, class Shape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Kernel>
+void
+parallelConvolveLines(ThreadPool & pool,
+                      SrcIterator si, Shape const & shape, SrcAccessor src,
+                      DestIterator di, DestAccessor dest,
+                      int dim, Kernel const & kernel)
+{
+    enum { N = 1 + SrcIterator::level };
+
+    // cut along the outermost other dimension (it has the largest stride)
+    int splitDim = (dim == N-1)
+                       ? N-2
+                       : N-1;
+
+    SeparableConvolveSlabFunctor<SrcIterator, Shape, SrcAccessor,
+                                 DestIterator, DestAccessor, Kernel> f;
+    f.si = si;
+    f.shape = shape;
+    f.src = src;
+    f.di = di;
+    f.dest = dest;
+    f.kernel = &kernel;
+    f.dim = dim;
+    f.splitDim = splitDim;
+    // several slabs per thread for load balancing
+    f.slabCount = std::min<MultiArrayIndex>(shape[splitDim], 4*pool.numThreads());
+
+    parallel_foreach(pool, f.slabCount, f);
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class KernelIterator>
+void
+internalSeparableConvolveMultiArrayTmp(
+                      SrcIterator si, SrcShape const & shape, SrcAccessor src,
+                      DestIterator di, DestAccessor dest, KernelIterator kit,
+                      ThreadPool & pool)
+{
+    enum { N = 1 + SrcIterator::level };
+
+    if(N == 1 || pool.numThreads() == 1)
+    {
+        internalSeparableConvolveMultiArrayTmp(si, shape, src, di, dest, kit);
+        return;
+    }
+
+    // the first pass reads from the source, the others work in-place on the destination
+    parallelConvolveLines(pool, si, shape, src, di, dest, 0, *kit);
+    ++kit;
+
+    for( int d = 1; d < N; ++d, ++kit )
+        parallelConvolveLines(pool, di, shape, dest, di, dest, d, *kit);
+}
 
 } // namespace detail
 
@@ -176,6 +288,23 @@ internalSeparableConvolveMultiArrayTmp(
         separableConvolveMultiArray(SrcIterator siter, SrcShape const & shape, SrcAccessor src,
                                     DestIterator diter, DestAccessor dest,
                                     KernelIterator kernels);
+
+        // multi-threaded variants of the above
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class T>
+        void
+        separableConvolveMultiArray(SrcIterator siter, SrcShape const & shape, SrcAccessor src,
+                                    DestIterator diter, DestAccessor dest,
+                                    Kernel1D<T> const & kernel,
+                                    ParallelOptions const & options);
+
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class KernelIterator>
+        void
+        separableConvolveMultiArray(SrcIterator siter, SrcShape const & shape, SrcAccessor src,
+                                    DestIterator diter, DestAccessor dest,
+                                    KernelIterator kernels,
+                                    ParallelOptions const & options);
     }
     \endcode
 
@@ -197,9 +326,32 @@ internalSeparableConvolveMultiArrayTmp(
         separableConvolveMultiArray(triple<SrcIterator, SrcShape, SrcAccessor> const & source,
                                     pair<DestIterator, DestAccessor> const & dest,
                                     KernelIterator kernels);
+
+        // multi-threaded variants of the above
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class T>
+        void
+        separableConvolveMultiArray(triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                    pair<DestIterator, DestAccessor> const & dest,
+                                    Kernel1D<T> const & kernel,
+                                    ParallelOptions const & options);
+
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class KernelIterator>
+        void
+        separableConvolveMultiArray(triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                    pair<DestIterator, DestAccessor> const & dest,
+                                    KernelIterator kernels,
+                                    ParallelOptions const & options);
     }
     \endcode
 
+    The variants with a \ref vigra::ParallelOptions argument distribute the work over
+    a pool of <tt>options.getNumThreads()</tt> threads. Each pass along one dimension
+    is split into slabs of complete 1D lines which are convolved independently.
+    Since every line is computed exactly as in the sequential version, the
+    result is identical to the sequential result, regardless of the number of threads.
+
     <b> Usage:</b>
 
     <b>\#include</b> \<vigra/multi_convolution.hxx\>
@@ -217,6 +369,10 @@ internalSeparableConvolveMultiArrayTmp(
     // perform Gaussian smoothing on all dimensions
     separableConvolveMultiArray(srcMultiArrayRange(source), destMultiArray(dest), 
                                 kernels.begin());
+
+    // the same, using 8 threads
+    separableConvolveMultiArray(srcMultiArrayRange(source), destMultiArray(dest), 
+                                kernels.begin(), ParallelOptions().numThreads(8));
     \endcode
 
     \see vigra::Kernel1D, convolveLine()
@@ -282,6 +438,72 @@ separableConvolveMultiArray(triple<SrcIterator, SrcShape, SrcAccessor> const & s
                                  dest.first, dest.second, kernels.begin() );
 }
 
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class KernelIterator>
+void
+separableConvolveMultiArray( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                             DestIterator d, DestAccessor dest, KernelIterator kernels,
+                             ParallelOptions const & options )
+{
+    typedef typename NumericTraits<typename DestAccessor::value_type>::RealPromote TmpType;
+
+    ThreadPool pool(options);
+
+    if(!IsSameType<TmpType, typename DestAccessor::value_type>::boolResult)
+    {
+        // need a temporary array to avoid rounding errors
+        MultiArray<SrcShape::static_size, TmpType> tmpArray(shape);
+        detail::internalSeparableConvolveMultiArrayTmp( s, shape, src,
+             tmpArray.traverser_begin(), typename AccessorTraits<TmpType>::default_accessor(), kernels,
+             pool );
+        copyMultiArray(srcMultiArrayRange(tmpArray), destIter(d, dest));
+    }
+    else
+    {
+        // work directly on the destination array
+        detail::internalSeparableConvolveMultiArrayTmp( s, shape, src, d, dest, kernels, pool );
+    }
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class KernelIterator>
+inline
+void separableConvolveMultiArray(
+    triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+    pair<DestIterator, DestAccessor> const & dest, KernelIterator kit,
+    ParallelOptions const & options )
+{
+    separableConvolveMultiArray( source.first, source.second, source.third,
+                                 dest.first, dest.second, kit, options );
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class T>
+inline void
+separableConvolveMultiArray( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                             DestIterator d, DestAccessor dest,
+                             Kernel1D<T> const & kernel,
+                             ParallelOptions const & options )
+{
+    ArrayVector<Kernel1D<T> > kernels(shape.size(), kernel);
+
+    separableConvolveMultiArray( s, shape, src, d, dest, kernels.begin(), options );
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class T>
+inline void
+separableConvolveMultiArray(triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                            pair<DestIterator, DestAccessor> const & dest,
+                            Kernel1D<T> const & kernel,
+                            ParallelOptions const & options )
+{
+    ArrayVector<Kernel1D<T> > kernels(source.second.size(), kernel);
+
+    separableConvolveMultiArray( source.first, source.second, source.third,
+                                 dest.first, dest.second, kernels.begin(), options );
+}
+
 /********************************************************/
 /*                                                      */
 /*            convolveMultiArrayOneDimension            */
@@ -47,6 +47,8 @@
 #include "metaprogramming.hxx"
 #include "multi_pointoperators.hxx"
 #include "functorexpression.hxx"
+#include "threadpool.hxx"
+#include <algorithm>
 
 namespace vigra
 {
@@ -73,10 +75,13 @@ struct DistParabolaStackEntry
 /*                                                      */
 /********************************************************/
 
+    // The stack is passed in by the caller, so that its memory can be
+    // reused for all lines of an array.
 template <class SrcIterator, class SrcAccessor,
           class DestIterator, class DestAccessor >
 void distParabola(SrcIterator is, SrcIterator iend, SrcAccessor sa,
-                  DestIterator id, DestAccessor da, double sigma )
+                  DestIterator id, DestAccessor da, double sigma,
+                  std::vector<DistParabolaStackEntry<typename SrcAccessor::value_type> > & _stack)
 {
     // We assume that the data in the input is distance squared and treat it as such
     double w = iend - is;
@@ -85,7 +90,7 @@ void distParabola(SrcIterator is, SrcIterator iend, SrcAccessor sa,
     
     typedef typename SrcAccessor::value_type SrcType;
     typedef DistParabolaStackEntry<SrcType> Influence;
-    std::vector<Influence> _stack;
+    _stack.clear();
     _stack.push_back(Influence(sa(is), 0.0, 0.0, w));
     
     ++is;
@@ -129,6 +134,15 @@ void distParabola(SrcIterator is, SrcIterator iend, SrcAccessor sa,
     }
 }
 
+template <class SrcIterator, class SrcAccessor,
+          class DestIterator, class DestAccessor >
+inline void distParabola(SrcIterator is, SrcIterator iend, SrcAccessor sa,
+                         DestIterator id, DestAccessor da, double sigma )
+{
+    std::vector<DistParabolaStackEntry<typename SrcAccessor::value_type> > _stack;
+    distParabola(is, iend, sa, id, da, sigma, _stack);
+}
+
 template <class SrcIterator, class SrcAccessor,
           class DestIterator, class DestAccessor>
 inline void distParabola(triple<SrcIterator, SrcIterator, SrcAccessor> src,
@@ -138,6 +152,16 @@ inline void distParabola(triple<SrcIterator, SrcIterator, SrcAccessor> src,
                  dest.first, dest.second, sigma);
 }
 
+template <class SrcIterator, class SrcAccessor,
+          class DestIterator, class DestAccessor>
+inline void distParabola(triple<SrcIterator, SrcIterator, SrcAccessor> src,
+                         pair<DestIterator, DestAccessor> dest, double sigma,
+                         std::vector<DistParabolaStackEntry<typename SrcAccessor::value_type> > & stack)
+{
+    distParabola(src.first, src.second, src.third,
+                 dest.first, dest.second, sigma, stack);
+}
+
 /********************************************************/
 /*                                                      */
 /*        internalSeparableMultiArrayDistTmp            */
@@ -160,6 +184,7 @@ void internalSeparableMultiArrayDistTmp(
     
     // temporary array to hold the current line to enable in-place operation
     ArrayVector<TmpType> tmp( shape[0] );
+    std::vector<DistParabolaStackEntry<TmpType> > _stack;
 
     typedef MultiArrayNavigator<SrcIterator, N> SNavigator;
     typedef MultiArrayNavigator<DestIterator, N> DNavigator;
@@ -185,7 +210,7 @@ void internalSeparableMultiArrayDistTmp(
 
             detail::distParabola( srcIterRange(tmp.begin(), tmp.end(),
                           typename AccessorTraits<TmpType>::default_const_accessor()),
-                          destIter( dnav.begin(), dest ), sigmas[0] );
+                          destIter( dnav.begin(), dest ), sigmas[0], _stack );
     }
     
     // operate on further dimensions
@@ -204,7 +229,7 @@ void internalSeparableMultiArrayDistTmp(
 
              detail::distParabola( srcIterRange(tmp.begin(), tmp.end(),
                            typename AccessorTraits<TmpType>::default_const_accessor()),
-                           destIter( dnav.begin(), dest ), sigmas[d] );
+                           destIter( dnav.begin(), dest ), sigmas[d], _stack );
         }
     }
     if(invert) transformMultiArray( di, shape, dest, di, dest, -Arg1());
@@ -227,6 +252,141 @@ inline void internalSeparableMultiArrayDistTmp( SrcIterator si, SrcShape const &
     internalSeparableMultiArrayDistTmp( si, shape, src, di, dest, sigmas, false );
 }
 
+/********************************************************/
+/*                                                      */
+/*        parallel separable distance helpers           */
+/*                                                      */
+/********************************************************/
+
+    // Scratch memory of one thread, reused for all lines it processes.
+template <class TmpType>
+struct DistParabolaScratch
+{
+    ArrayVector<TmpType> line;
+    std::vector<DistParabolaStackEntry<TmpType> > stack;
+};
+
+    // Transform all lines along dimension 'dim' that lie in one slab of the array.
+    // The array is cut into slabs along 'splitDim' (which must differ from 'dim'),
+    // so that all slabs contain complete lines and can be processed independently.
+    // Each line is computed exactly as in the sequential version.
+template <class SrcIterator, class Shape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class TmpType>
+struct SeparableMultiDistSlabFunctor
+{
+    enum { N = 1 + SrcIterator::level };
+
+    SrcIterator si;
+    Shape shape;
+    SrcAccessor src;
+    DestIterator di;
+    DestAccessor dest;
+    double sigma;
+    bool invert;
+    int dim, splitDim;
+    MultiArrayIndex slabCount;
+    DistParabolaScratch<TmpType> * scratch; // one entry per thread
+
+    void operator()(int threadIndex, std::ptrdiff_t slab) const
+    {
+        MultiArrayIndex begin = slab * shape[splitDim] / slabCount,
+                        end   = (slab + 1) * shape[splitDim] / slabCount;
+        if(begin == end)
+            return;
+
+        Shape offset, slabShape(shape);
+        offset[splitDim] = begin;
+        slabShape[splitDim] = end - begin;
+
+        ArrayVector<TmpType> & tmp = scratch[threadIndex].line;
+        tmp.resize( shape[dim] );
+
+        MultiArrayNavigator<SrcIterator, N> snav( si + offset, slabShape, dim );
+        MultiArrayNavigator<DestIterator, N> dnav( di + offset, slabShape, dim );
+
+        using namespace vigra::functor;
+
+        for( ; snav.hasMore(); snav++, dnav++ )
+        {
+            // first copy source to temp for maximum cache efficiency
+            // Invert the values if necessary. Only needed for grayscale morphology
+            if(invert)
+                transformLine( snav.begin(), snav.end(), src, tmp.begin(),
+                               typename AccessorTraits<TmpType>::default_accessor(), 
+                               Param(NumericTraits<TmpType>::zero())-Arg1());
+            else
+                copyLine( snav.begin(), snav.end(), src, tmp.begin(),
+                          typename AccessorTraits<TmpType>::default_accessor() );
+
+            detail::distParabola( srcIterRange(tmp.begin(), tmp.end(),
+                          typename AccessorTraits<TmpType>::default_const_accessor()),
+                          destIter( dnav.begin(), dest ), sigma, scratch[threadIndex].stack );
+        }
+    }
+};
+
+template <class SrcIterator, class Shape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class TmpType>
+void
+parallelDistParabolaLines(ThreadPool & pool,
+                          SrcIterator si, Shape const & shape, SrcAccessor src,
+                          DestIterator di, DestAccessor dest,
+                          int dim, double sigma, bool invert,
+                          DistParabolaScratch<TmpType> * scratch)
+{
+    enum { N = 1 + SrcIterator::level };
+
+    // cut along the outermost other dimension (it has the largest stride)
+    int splitDim = (dim == N-1)
+                       ? N-2
+                       : N-1;
+
+    SeparableMultiDistSlabFunctor<SrcIterator, Shape, SrcAccessor,
+                                  DestIterator, DestAccessor, TmpType> f;
+    f.si = si;
+    f.shape = shape;
+    f.src = src;
+    f.di = di;
+    f.dest = dest;
+    f.sigma = sigma;
+    f.invert = invert;
+    f.dim = dim;
+    f.splitDim = splitDim;
+    // several slabs per thread for load balancing
+    f.slabCount = std::min<MultiArrayIndex>(shape[splitDim], 4*pool.numThreads());
+    f.scratch = scratch;
+
+    parallel_foreach(pool, f.slabCount, f);
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+void internalSeparableMultiArrayDistTmp(
+                      SrcIterator si, SrcShape const & shape, SrcAccessor src,
+                      DestIterator di, DestAccessor dest, Array const & sigmas, bool invert,
+                      ThreadPool & pool)
+{
+    enum { N =  SrcShape::static_size};
+
+    typedef typename NumericTraits<typename DestAccessor::value_type>::RealPromote TmpType;
+
+    if(N == 1 || pool.numThreads() == 1)
+    {
+        internalSeparableMultiArrayDistTmp(si, shape, src, di, dest, sigmas, invert);
+        return;
+    }
+
+    ArrayVector<DistParabolaScratch<TmpType> > scratch(pool.numThreads());
+
+    // the first pass reads from the source, the others work in-place on the destination
+    parallelDistParabolaLines(pool, si, shape, src, di, dest, 0, sigmas[0], invert, scratch.data());
+    for( int d = 1; d < N; ++d )
+        parallelDistParabolaLines(pool, di, shape, dest, di, dest, d, sigmas[d], false, scratch.data());
+
+    using namespace vigra::functor;
+    if(invert) transformMultiArray( di, shape, dest, di, dest, -Arg1());
+}
+
 } // namespace detail
 
 /** \addtogroup MultiArrayDistanceTransform Euclidean distance transform for multi-dimensional arrays.
@@ -271,6 +431,23 @@ inline void internalSeparableMultiArrayDistTmp( SrcIterator si, SrcShape const &
                                   DestIterator diter, DestAccessor dest, 
                                   bool background);
 
+        // multi-threaded variants of the above
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class Array>
+        void 
+        separableMultiDistSquared( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                                   DestIterator d, DestAccessor dest, 
+                                   bool background,
+                                   Array const & pixelPitch,
+                                   ParallelOptions const & options);
+
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor>
+        void
+        separableMultiDistSquared(SrcIterator siter, SrcShape const & shape, SrcAccessor src,
+                                  DestIterator diter, DestAccessor dest, 
+                                  bool background,
+                                  ParallelOptions const & options);
     }
     \endcode
 
@@ -294,6 +471,23 @@ inline void internalSeparableMultiArrayDistTmp( SrcIterator si, SrcShape const &
                                   pair<DestIterator, DestAccessor> const & dest,
                                   bool background);
 
+        // multi-threaded variants of the above
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class Array>
+        void 
+        separableMultiDistSquared( triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                   pair<DestIterator, DestAccessor> const & dest, 
+                                   bool background,
+                                   Array const & pixelPitch,
+                                   ParallelOptions const & options);
+
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor>
+        void
+        separableMultiDistSquared(triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                  pair<DestIterator, DestAccessor> const & dest,
+                                  bool background,
+                                  ParallelOptions const & options);
     }
     \endcode
 
@@ -312,6 +506,12 @@ inline void internalSeparableMultiArrayDistTmp( SrcIterator si, SrcShape const &
     This is necessary when the data have non-uniform resolution (as is common in confocal
     microscopy, for example). 
 
+    The variants with a \ref vigra::ParallelOptions argument distribute the work over
+    a pool of <tt>options.getNumThreads()</tt> threads. Each pass along one dimension
+    is split into slabs of complete 1D lines which are transformed independently,
+    and every thread reuses its own line and parabola stack buffers for all its lines.
+    The result is identical to the sequential result, regardless of the number of threads.
+
     This function may work in-place, which means that <tt>siter == diter</tt> is allowed.
     A full-sized internal array is only allocated if working on the destination
     array directly would cause overflow errors (i.e. if
@@ -330,6 +530,10 @@ inline void internalSeparableMultiArrayDistTmp( SrcIterator si, SrcShape const &
 
     // Calculate Euclidean distance squared for all background pixels 
     separableMultiDistSquared(srcMultiArrayRange(source), destMultiArray(dest), true);
+
+    // the same, using 8 threads
+    separableMultiDistSquared(srcMultiArrayRange(source), destMultiArray(dest), true,
+                              ParallelOptions().numThreads(8));
     \endcode
 
     \see vigra::distanceTransform(), vigra::separableMultiDistance()
@@ -340,7 +544,7 @@ template <class SrcIterator, class SrcShape, class SrcAccessor,
           class DestIterator, class DestAccessor, class Array>
 void separableMultiDistSquared( SrcIterator s, SrcShape const & shape, SrcAccessor src,
                                 DestIterator d, DestAccessor dest, bool background,
-                                Array const & pixelPitch)
+                                Array const & pixelPitch, ParallelOptions const & options)
 {
     int N = shape.size();
 
@@ -360,6 +564,8 @@ void separableMultiDistSquared( SrcIterator s, SrcShape const & shape, SrcAccess
     }
             
     using namespace vigra::functor;
+
+    ThreadPool pool(options);
    
     if(dmax > NumericTraits<DestType>::toRealPromote(NumericTraits<DestType>::max()) 
        || pixelPitchIsReal) // need a temporary array to avoid overflows
@@ -379,7 +585,7 @@ void separableMultiDistSquared( SrcIterator s, SrcShape const & shape, SrcAccess
         detail::internalSeparableMultiArrayDistTmp( tmpArray.traverser_begin(), 
                 shape, typename AccessorTraits<Real>::default_accessor(),
                 tmpArray.traverser_begin(), 
-                typename AccessorTraits<Real>::default_accessor(), pixelPitch);
+                typename AccessorTraits<Real>::default_accessor(), pixelPitch, false, pool);
         
         copyMultiArray(srcMultiArrayRange(tmpArray), destIter(d, dest));
     }
@@ -394,10 +600,50 @@ void separableMultiDistSquared( SrcIterator s, SrcShape const & shape, SrcAccess
             transformMultiArray( s, shape, src, d, dest, 
                                  ifThenElse( Arg1() != Param(zero), Param(maxDist), Param(rzero) ));
      
-        detail::internalSeparableMultiArrayDistTmp( d, shape, dest, d, dest, pixelPitch);
+        detail::internalSeparableMultiArrayDistTmp( d, shape, dest, d, dest, pixelPitch, false, pool);
     }
 }
 
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline void separableMultiDistSquared( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                                       DestIterator d, DestAccessor dest, bool background,
+                                       Array const & pixelPitch)
+{
+    separableMultiDistSquared( s, shape, src, d, dest, background, pixelPitch,
+                               ParallelOptions().numThreads(ParallelOptions::NoThreads) );
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline void separableMultiDistSquared( triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                       pair<DestIterator, DestAccessor> const & dest, bool background,
+                                       Array const & pixelPitch, ParallelOptions const & options)
+{
+    separableMultiDistSquared( source.first, source.second, source.third,
+                               dest.first, dest.second, background, pixelPitch, options );
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor>
+inline void separableMultiDistSquared( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                                       DestIterator d, DestAccessor dest, bool background,
+                                       ParallelOptions const & options)
+{
+    ArrayVector<double> pixelPitch(shape.size(), 1.0);
+    separableMultiDistSquared( s, shape, src, d, dest, background, pixelPitch, options );
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor>
+inline void separableMultiDistSquared( triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                       pair<DestIterator, DestAccessor> const & dest, bool background,
+                                       ParallelOptions const & options)
+{
+    separableMultiDistSquared( source.first, source.second, source.third,
+                               dest.first, dest.second, background, options );
+}
+
 template <class SrcIterator, class SrcShape, class SrcAccessor,
           class DestIterator, class DestAccessor, class Array>
 inline void separableMultiDistSquared( triple<SrcIterator, SrcShape, SrcAccessor> const & source,
@@ -486,7 +732,8 @@ inline void separableMultiDistSquared( triple<SrcIterator, SrcShape, SrcAccessor
     This function performs a Euclidean distance transform on the given
     multi-dimensional array. It simply calls \ref separableMultiDistSquared()
     and takes the pixel-wise square root of the result. See \ref separableMultiDistSquared()
-    for more documentation.
+    for more documentation. Like there, a \ref vigra::ParallelOptions object can be
+    passed as the last argument to use multiple threads.
     
     <b> Usage:</b>
 
@@ -533,6 +780,30 @@ void separableMultiDistance( SrcIterator s, SrcShape const & shape, SrcAccessor
     transformMultiArray( d, shape, dest, d, dest, sqrt(Arg1()) );
 }
 
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+void separableMultiDistance( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                             DestIterator d, DestAccessor dest, bool background,
+                             Array const & pixelPitch, ParallelOptions const & options)
+{
+    separableMultiDistSquared( s, shape, src, d, dest, background, pixelPitch, options);
+    
+    // Finally, calculate the square root of the distances
+    using namespace vigra::functor;
+   
+    transformMultiArray( d, shape, dest, d, dest, sqrt(Arg1()) );
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor>
+inline void separableMultiDistance( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                                    DestIterator d, DestAccessor dest, bool background,
+                                    ParallelOptions const & options)
+{
+    ArrayVector<double> pixelPitch(shape.size(), 1.0);
+    separableMultiDistance( s, shape, src, d, dest, background, pixelPitch, options );
+}
+
 template <class SrcIterator, class SrcShape, class SrcAccessor,
           class DestIterator, class DestAccessor, class Array>
 inline void separableMultiDistance( triple<SrcIterator, SrcShape, SrcAccessor> const & source,
@@ -552,6 +823,216 @@ inline void separableMultiDistance( triple<SrcIterator, SrcShape, SrcAccessor> c
                             dest.first, dest.second, background );
 }
 
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline void separableMultiDistance( triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                    pair<DestIterator, DestAccessor> const & dest, bool background,
+                                    Array const & pixelPitch, ParallelOptions const & options)
+{
+    separableMultiDistance( source.first, source.second, source.third,
+                            dest.first, dest.second, background, pixelPitch, options );
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor>
+inline void separableMultiDistance( triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                    pair<DestIterator, DestAccessor> const & dest, bool background,
+                                    ParallelOptions const & options)
+{
+    separableMultiDistance( source.first, source.second, source.third,
+                            dest.first, dest.second, background, options );
+}
+
+/********************************************************/
+/*                                                      */
+/*             separableVectorDistance                  */
+/*                                                      */
+/********************************************************/
+
+namespace detail
+{
+
+    // Lower envelope of the parabolas of one line, where each element 
+    // carries the offset to its nearest feature in the dimensions already 
+    // processed. Elements without a feature so far (squared length >= 'maxDist')
+    // do not contribute. Lines without any contribution are left unchanged.
+template <class DestIterator, class Vector>
+void vectorialDistParabola(DestIterator id, ArrayVector<Vector> const & line, 
+                           int dim, Vector const & pixelPitch, double maxDist,
+                           std::vector<DistParabolaStackEntry<double> > & _stack)
+{
+    typedef DistParabolaStackEntry<double> Influence;
+
+    double w = (double)line.size();
+    double sigma2 = sq(pixelPitch[dim]);
+    double sigma22 = 2.0 * sigma2;
+
+    _stack.clear();
+    for(double current = 0.0; current < w; ++current)
+    {
+        double value = squaredNorm(pixelPitch*line[(int)current]);
+        if(value >= maxDist)
+            continue;
+        while(true)
+        {
+            if(_stack.empty())
+            {
+                _stack.push_back(Influence(value, 0.0, current, w));
+                break;
+            }
+            Influence & s = _stack.back();
+            double diff = current - s.center;
+            double intersection = current + (value - s.prevVal - sigma2*sq(diff)) / (sigma22 * diff);
+            
+            if( intersection < s.left) // previous point has no influence
+            {
+                _stack.pop_back();
+                continue;
+            }
+            if(intersection < s.right)
+            {
+                s.right = intersection;
+                _stack.push_back(Influence(value, intersection, current, w));
+            }
+            break;
+        }
+    }
+    if(_stack.empty())
+        return;
+
+    typename std::vector<Influence>::iterator it = _stack.begin();
+    for(double current = 0.0; current < w; ++current, ++id)
+    {
+        while( current >= it->right) 
+            ++it; 
+        Vector v = line[(int)it->center];
+        v[dim] = it->center - current;
+        *id = v;
+    }
+}
+
+} // namespace detail
+
+/** \brief Vector distance transform: offsets to the nearest feature.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        // explicitly specify pixel pitch for each coordinate
+        template <unsigned int N, class T1, class S1, class T, class S2, class Array>
+        void 
+        separableVectorDistance(MultiArrayView<N, T1, S1> const & source,
+                                MultiArrayView<N, TinyVector<T, N>, S2> dest,
+                                bool background,
+                                Array const & pixelPitch);
+
+        // use default pixel pitch = 1.0 for each coordinate
+        template <unsigned int N, class T1, class S1, class T, class S2>
+        void 
+        separableVectorDistance(MultiArrayView<N, T1, S1> const & source,
+                                MultiArrayView<N, TinyVector<T, N>, S2> dest,
+                                bool background);
+    }
+    \endcode
+
+    This function computes the same transform as \ref separableMultiDistSquared(), 
+    but stores, instead of the distance, the offset from each element to its
+    nearest feature element, i.e. <tt>p + dest[p]</tt> is the coordinate of the 
+    feature closest to <tt>p</tt>, and <tt>squaredNorm(pixelPitch*dest[p])</tt> is 
+    the squared distance. Like in \ref separableMultiDistSquared(), the non-zero 
+    elements of <tt>source</tt> are the features if <i>background</i> is true, 
+    and the zero elements otherwise. The offsets are propagated in the same 
+    separable parabola passes that compute the distance, so the cost is linear 
+    in the number of elements. The type <tt>T</tt> must be a signed integer 
+    type, e.g. <tt>MultiArrayIndex</tt>. When there are several nearest features,
+    one of them is chosen. If <tt>source</tt> contains no feature, all offsets 
+    are set to <tt>max(source.shape())</tt>.
+
+    With the offsets, the nearest seed can be found for every element by a
+    simple lookup, which gives a discrete Voronoi tesselation without region growing.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/multi_distance.hxx\>
+
+    \code
+    MultiArray<3, UInt32> seeds(shape), voronoi(shape);
+    MultiArray<3, TinyVector<MultiArrayIndex, 3> > offsets(shape);
+    ... // label the seeds with 1, 2, ...
+
+    separableVectorDistance(seeds, offsets, true);
+
+    MultiArrayView<3, UInt32> v(voronoi);
+    for(MultiArrayView<3, UInt32>::iterator i = v.begin(); i != v.end(); ++i)
+        *i = seeds[i.point() + offsets[i.point()]];
+    \endcode
+
+    \see vigra::separableMultiDistSquared()
+*/
+doxygen_overloaded_function(template <...> void separableVectorDistance)
+
+template <unsigned int N, class T1, class S1, class T2, class S2, class Array>
+void separableVectorDistance(MultiArrayView<N, T1, S1> const & source,
+                             MultiArrayView<N, T2, S2> dest,
+                             bool background,
+                             Array const & pixelPitch)
+{
+    typedef typename T2::value_type OffsetType;
+    typedef TinyVector<double, N> Vector;
+    typedef typename MultiArrayView<N, T2, S2>::traverser DestTraverser;
+    typedef MultiArrayNavigator<DestTraverser, N> DNavigator;
+
+    vigra_precondition(source.shape() == dest.shape(),
+        "separableVectorDistance(): shape mismatch between input and output.");
+
+    Vector pitch;
+    double maxDist = 0.0;
+    for(unsigned int k=0; k<N; ++k)
+    {
+        pitch[k] = pixelPitch[k];
+        maxDist += sq(pitch[k]*source.shape(k));
+    }
+
+    // elements without a feature get an offset that is longer than 
+    // any real distance in the array
+    OffsetType maxOffset = (OffsetType)*std::max_element(source.shape().begin(), source.shape().end());
+    T2 zero(OffsetType(0)), infinity(maxOffset);
+    T1 srcZero = NumericTraits<T1>::zero();
+
+    typename MultiArrayView<N, T1, S1>::const_iterator s = source.begin(), send = source.end();
+    typename MultiArrayView<N, T2, S2>::iterator d = dest.begin();
+    for(; s != send; ++s, ++d)
+        *d = ((*s != srcZero) == background)
+                 ? zero
+                 : infinity;
+
+    ArrayVector<Vector> line;
+    std::vector<detail::DistParabolaStackEntry<double> > _stack;
+    for(unsigned int k=0; k<N; ++k)
+    {
+        line.resize(dest.shape(k));
+        DNavigator dnav(dest.traverser_begin(), dest.shape(), k);
+        for( ; dnav.hasMore(); dnav++ )
+        {
+            // first copy the line to temp for maximum cache efficiency
+            typename DNavigator::iterator i = dnav.begin();
+            for(MultiArrayIndex j=0; j<dest.shape(k); ++j, ++i)
+                line[j] = *i;
+            detail::vectorialDistParabola(dnav.begin(), line, k, pitch, maxDist, _stack);
+        }
+    }
+}
+
+template <unsigned int N, class T1, class S1, class T2, class S2>
+inline void separableVectorDistance(MultiArrayView<N, T1, S1> const & source,
+                                    MultiArrayView<N, T2, S2> dest,
+                                    bool background)
+{
+    separableVectorDistance(source, dest, background, TinyVector<double, N>(1.0));
+}
+
+
 //@}
 
 } //-- namespace vigra
@@ -49,6 +49,7 @@
 #include "impex.hxx"
 #include "multi_array.hxx"
 #include "multi_pointoperators.hxx"
+#include "threadpool.hxx"
 
 #ifdef _MSC_VER
 # include <direct.h>
@@ -161,9 +162,29 @@ class VolumeImportInfo
 
     VIGRA_EXPORT const std::string &description() const;
 
+        /** Get the path of the raw voxel file if the volume is described
+            by an info file (relative paths are resolved against the directory
+            of the info file). Returns an empty string for by-slice volumes.
+         **/
+    VIGRA_EXPORT const std::string &getRawFilename() const;
+
+        /** Get the byte order of the raw voxel file as given by the
+            <tt>byteorder</tt> key of the info file ("little-endian" or
+            "big-endian"). An empty string means the native byte order.
+         **/
+    VIGRA_EXPORT const char * getByteOrder() const;
+
     template <class T, class Stride>
     void importImpl(MultiArrayView <3, T, Stride> &volume) const;
 
+        /** Same as above, but decode the slice files of a by-slice volume
+            concurrently using <tt>options.getNumThreads()</tt> threads. Raw
+            volumes are always read sequentially.
+         **/
+    template <class T, class Stride>
+    void importImpl(MultiArrayView <3, T, Stride> &volume,
+                    ParallelOptions const & options) const;
+
   protected:
     void getVolumeInfoFromFirstSlice(const std::string &filename);
 
@@ -174,11 +195,163 @@ class VolumeImportInfo
 
     std::string path_, name_, description_, pixelType_;
 
-    std::string rawFilename_;
+    std::string rawFilename_, rawFilePath_, byteOrder_;
     std::string baseName_, extension_;
     std::vector<std::string> numbers_;
 };
 
+/********************************************************/
+/*                                                      */
+/*                  MemoryMappedVolume                  */
+/*                                                      */
+/********************************************************/
+
+/** \brief Read-only memory mapping of an entire file.
+
+    The file is mapped copy-on-write: the mapped memory may be modified,
+    but the changes are private to the process and never written back.
+    Used by \ref vigra::MemoryMappedVolume.
+
+    <b>\#include</b> \<vigra/multi_impex.hxx\><br>
+    Namespace: vigra
+**/
+class MemoryMappedFile
+{
+  public:
+        /** Map the given file. Fails with <tt>PreconditionViolation</tt>
+            if the file cannot be opened or is empty.
+         **/
+    VIGRA_EXPORT explicit MemoryMappedFile(const std::string &filename);
+    VIGRA_EXPORT ~MemoryMappedFile();
+
+        /** Start of the mapped memory.
+         **/
+    void * data() const
+    {
+        return data_;
+    }
+
+        /** Size of the file in bytes.
+         **/
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+  private:
+    MemoryMappedFile(MemoryMappedFile const &);
+    MemoryMappedFile & operator=(MemoryMappedFile const &);
+
+    void * data_;
+    std::size_t size_;
+#if defined(_WIN32)
+    void * file_, * mapping_;
+#endif
+};
+
+/** \brief Raw volume accessed through a memory mapping of its voxel file.
+
+    Instead of reading the voxel file of a raw volume (see \ref importVolume())
+    into memory, this class maps it into the address space and provides a
+    <tt>MultiArrayView</tt> onto the mapping. Construction therefore takes
+    constant time, regardless of the size of the volume, and the operating system
+    only loads the pages that are actually accessed. In particular, a subvolume
+    obtained by \ref subarray() only touches the pages holding its voxels.
+    The view may be modified, but the changes are never written back to the file.
+
+    The voxel file must store the data in the layout of a <tt>MultiArray<3, T></tt>,
+    i.e. without header and with x varying fastest. The data type of the volume
+    (given by the <tt>datatype</tt> key of the info file) must match <tt>T</tt>,
+    and the byte order of the file (given by the <tt>byteorder</tt> key)
+    must match the byte order of the machine. Otherwise,
+    <tt>PreconditionViolation</tt> is thrown, and the volume must be read by
+    \ref importVolume().
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/multi_impex.hxx\><br>
+    Namespace: vigra
+
+    \code
+    vigra::VolumeImportInfo info("huge.info");
+    vigra::MemoryMappedVolume<vigra::UInt16> volume(info);
+
+    // only the pages overlapping this block are read from disk
+    vigra::MultiArrayView<3, vigra::UInt16> block =
+        volume.subarray(vigra::Shape3(1000, 1000, 200), vigra::Shape3(1256, 1256, 264));
+    \endcode
+**/
+template <class T>
+class MemoryMappedVolume
+{
+  public:
+        /** the view type of the volume
+         **/
+    typedef MultiArrayView<3, T> view_type;
+
+        /** the shape type of the volume
+         **/
+    typedef typename view_type::difference_type difference_type;
+
+        /** Map the raw voxel file described by <tt>info</tt>.
+         **/
+    explicit MemoryMappedVolume(VolumeImportInfo const & info)
+    : file_(checkedRawFilename(info)),
+      view_(info.shape(), static_cast<T *>(file_.data()))
+    {
+        vigra_precondition(file_.size() >= (std::size_t)prod(info.shape()) * sizeof(T),
+            "MemoryMappedVolume(): raw file is smaller than the volume.");
+    }
+
+        /** Get the view onto the entire volume.
+         **/
+    view_type const & view() const
+    {
+        return view_;
+    }
+
+        /** Get the shape of the volume.
+         **/
+    difference_type const & shape() const
+    {
+        return view_.shape();
+    }
+
+        /** Get a view onto the subvolume from <tt>p</tt> (inclusive)
+            to <tt>q</tt> (exclusive).
+         **/
+    view_type
+    subarray(difference_type const & p, difference_type const & q) const
+    {
+        return view_.subarray(p, q);
+    }
+
+  private:
+    static std::string checkedRawFilename(VolumeImportInfo const & info)
+    {
+        vigra_precondition(info.getRawFilename().size() > 0,
+            "MemoryMappedVolume(): volume is not stored in a raw file.");
+        vigra_precondition(info.numBands() == 1 &&
+                           TypeAsString<T>::result() == info.getPixelType(),
+            "MemoryMappedVolume(): voxel type of the file does not match T.");
+
+        std::string byteorder = info.getByteOrder();
+        if(sizeof(T) > 1 && byteorder.size() > 0)
+        {
+            const UInt16 one = 1;
+            std::string native = *reinterpret_cast<const UInt8 *>(&one) == 1
+                                     ? "little-endian"
+                                     : "big-endian";
+            vigra_precondition(byteorder == native,
+                "MemoryMappedVolume(): byte order of the file does not match the machine.");
+        }
+        return info.getRawFilename();
+    }
+
+    MemoryMappedFile file_;
+    view_type view_;
+};
+
 /********************************************************/
 /*                                                      */
 /*                   VolumeExportInfo                    */
@@ -407,8 +580,54 @@ readVolumeImpl(DestIterator d, Shape const & shape, std::ifstream & s, ArrayVect
     }
 }
 
+template <class T, class Stride>
+void
+importVolumeSlice(std::string const & name, MultiArrayView <2, T, Stride> view)
+{
+    ImageImportInfo info (name.c_str ());
+    vigra_precondition(view.shape() == info.shape(),
+        "importVolume(): the images have inconsistent sizes.");
+
+    importImage (info, destImage(view));
+}
+
+// Decodes one slice file per call, each with its own codec instance.
+template <class T, class Stride>
+struct ImportVolumeSlices
+{
+    std::vector<std::string> const * names;
+    MultiArrayView <3, T, Stride> * volume;
+
+    void operator()(int /* threadIndex */, std::ptrdiff_t i) const
+    {
+        importVolumeSlice((*names)[i], volume->bindOuter(i));
+    }
+};
+
 } // namespace detail
 
+template <class T, class Stride>
+void VolumeImportInfo::importImpl(MultiArrayView <3, T, Stride> &volume,
+                                  ParallelOptions const & options) const
+{
+    if(rawFilename_.size() || numbers_.size() < 2)
+    {
+        importImpl(volume);
+        return;
+    }
+
+    vigra_precondition(this->shape() == volume.shape(), "importVolume(): Volume must be shaped according to VolumeImportInfo.");
+
+    std::vector<std::string> names(numbers_.size());
+    for (unsigned int i = 0; i < numbers_.size(); ++i)
+        names[i] = baseName_ + numbers_[i] + extension_;
+
+    detail::ImportVolumeSlices<T, Stride> f;
+    f.names = &names;
+    f.volume = &volume;
+    parallel_foreach(options, names.size(), f);
+}
+
 template <class T, class Stride>
 void VolumeImportInfo::importImpl(MultiArrayView <3, T, Stride> &volume) const
 {
@@ -470,15 +689,8 @@ void VolumeImportInfo::importImpl(MultiArrayView <3, T, Stride> &volume) const
             // build the filename
             std::string name = baseName_ + numbers_[i] + extension_;
 
-            // import the image
-            ImageImportInfo info (name.c_str ());
-
-            // generate a basic image view to the current layer
-            MultiArrayView <2, T, Stride> view (volume.bindOuter (i));
-            vigra_precondition(view.shape() == info.shape(),
-                "importVolume(): the images have inconsistent sizes.");
-
-            importImage (info, destImage(view));
+            // import the image into the current layer
+            detail::importVolumeSlice(name, volume.bindOuter (i));
         }
     }
 }
@@ -545,10 +757,13 @@ void importVolume (MultiArray <3, T, Allocator> & volume,
          <li> width = [positive integer] (required)
          <li> height = [positive integer] (required)
          <li> depth = [positive integer] (required)
-         <li> datatype = [UNSIGNED_CHAR | UNSIGNED_BYTE] (default: UNSIGNED_CHAR)
+         <li> datatype = [UNSIGNED_CHAR | UNSIGNED_BYTE | SHORT | UNSIGNED_SHORT |
+                          INT | UNSIGNED_INT | FLOAT | DOUBLE] (default: UNSIGNED_CHAR)
+         <li> byteorder = [little-endian | big-endian] (default: native byte order)
          </UL>
          The voxel type is currently assumed to be binary compatible to the <tt>value_type T</TT>
-         of the <tt>MuliArray</tt>. Lines starting with "#" are ignored.
+         of the <tt>MuliArray</tt>. Lines starting with "#" are ignored. To access a large raw
+         volume without reading it into memory, use \ref vigra::MemoryMappedVolume.
     </UL>
 
     In either case, the <tt>volume</tt> will be reshaped to match the count and
@@ -588,6 +803,63 @@ void importVolume(VolumeImportInfo const & info, MultiArrayView <3, T, Stride> &
     info.importImpl(volume);
 }
 
+/** \brief Function for importing a 3D volume using multiple threads.
+
+    Same as the other variants of <tt>importVolume()</tt>, but the slice files of a
+    by-slice volume are decoded concurrently by a pool of <tt>options.getNumThreads()</tt>
+    threads. Each thread uses its own codec instance and writes directly into the
+    corresponding z-slice of <tt>volume</tt>. This pays off for long stacks of
+    compressed slices (PNG, TIFF), where decompression dominates the run time.
+    Raw volumes described by an info file are read sequentially.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <class T, class Stride>
+        void importVolume(VolumeImportInfo const & info, MultiArrayView <3, T, Stride> &volume,
+                          ParallelOptions const & options);
+
+        template <class T, class Allocator>
+        void importVolume(MultiArray <3, T, Allocator> & volume,
+                          const std::string &name_base, const std::string &name_ext,
+                          ParallelOptions const & options);
+    }
+    \endcode
+
+    <b> Usage:</b>
+
+    <b>\#include</b>
+    \<vigra/multi_impex.hxx\>
+
+    Namespace: vigra
+
+    \code
+    vigra::MultiArray<3, UInt8> volume;
+    importVolume(volume, "slices/slice_", ".png", ParallelOptions().numThreads(8));
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void importVolume)
+
+template <class T, class Stride>
+void importVolume(VolumeImportInfo const & info, MultiArrayView <3, T, Stride> &volume,
+                  ParallelOptions const & options)
+{
+    info.importImpl(volume, options);
+}
+
+template <class T, class Allocator>
+void importVolume (MultiArray <3, T, Allocator> & volume,
+                   const std::string &name_base,
+                   const std::string &name_ext,
+                   ParallelOptions const & options)
+{
+    VolumeImportInfo info(name_base, name_ext);
+    volume.reshape(info.shape());
+
+    info.importImpl(volume, options);
+}
+
 namespace detail {
 
 template <class T>
@@ -658,6 +930,35 @@ void setRangeMapping(MultiArrayView <3, T, Tag> const & volume,
     }
 }
 
+inline std::string
+volumeSliceName(VolumeExportInfo const & volinfo, unsigned int i, unsigned int depth)
+{
+    int numlen = static_cast <int> (std::ceil (std::log10 ((double)depth)));
+    std::stringstream stream;
+    stream << std::setfill ('0') << std::setw (numlen) << i;
+    std::string name_num;
+    stream >> name_num;
+    return std::string(volinfo.getFileNameBase()) + name_num + std::string(volinfo.getFileNameExt());
+}
+
+// Encodes one slice file per call, each with its own codec instance.
+template <class T, class Tag>
+struct ExportVolumeSlices
+{
+    MultiArrayView <3, T, Tag> const * volume;
+    VolumeExportInfo const * volinfo;
+    ImageExportInfo const * info;
+
+    void operator()(int /* threadIndex */, std::ptrdiff_t i) const
+    {
+        ImageExportInfo sliceinfo(*info);
+        sliceinfo.setFileName(volumeSliceName(*volinfo, i, volume->shape(2)).c_str());
+
+        MultiArrayView <2, T, Tag> view (volume->bindOuter (i));
+        exportImage(srcImageRange(view), sliceinfo);
+    }
+};
+
 } // namespace detail
 
 /********************************************************/
@@ -691,25 +992,47 @@ void exportVolume (MultiArrayView <3, T, Tag> const & volume,
     detail::setRangeMapping(volume, info, typename NumericTraits<T>::isScalar());
 
     const unsigned int depth = volume.shape (2);
-    int numlen = static_cast <int> (std::ceil (std::log10 ((double)depth)));
     for (unsigned int i = 0; i < depth; ++i)
     {
-
-        // build the filename
-        std::stringstream stream;
-        stream << std::setfill ('0') << std::setw (numlen) << i;
-        std::string name_num;
-        stream >> name_num;
-        std::string name = std::string(volinfo.getFileNameBase()) + name_num + std::string(volinfo.getFileNameExt());
-
         MultiArrayView <2, T, Tag> view (volume.bindOuter (i));
 
         // export the image
-        info.setFileName(name.c_str ());
+        info.setFileName(detail::volumeSliceName(volinfo, i, depth).c_str ());
         exportImage(srcImageRange(view), info); 
     }
 }
 
+/** \brief Function for exporting a 3D volume using multiple threads.
+
+    Same as the sequential <tt>exportVolume()</tt>, but the slices are encoded
+    concurrently by a pool of <tt>options.getNumThreads()</tt> threads, each
+    with its own codec instance. The range mapping (if required) is still
+    determined once for the whole volume, so the files are identical
+    to those written by the sequential version.
+
+    <b>\#include</b>
+    \<vigra/multi_impex.hxx\>
+
+    Namespace: vigra
+*/
+template <class T, class Tag>
+void exportVolume (MultiArrayView <3, T, Tag> const & volume,
+                   const VolumeExportInfo & volinfo,
+                   ParallelOptions const & options)
+{
+    std::string name = std::string(volinfo.getFileNameBase()) + std::string(volinfo.getFileNameExt());
+    ImageExportInfo info(name.c_str());
+    info.setCompression(volinfo.getCompression());
+    info.setPixelType(volinfo.getPixelType());
+    detail::setRangeMapping(volume, info, typename NumericTraits<T>::isScalar());
+
+    detail::ExportVolumeSlices<T, Tag> f;
+    f.volume = &volume;
+    f.volinfo = &volinfo;
+    f.info = &info;
+    parallel_foreach(options, volume.shape (2), f);
+}
+
 // for backward compatibility
 template <class T, class Tag>
 inline 
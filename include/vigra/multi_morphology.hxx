@@ -39,6 +39,7 @@
 
 #include <vector>
 #include <cmath>
+#include <algorithm>
 #include "multi_distance.hxx"
 #include "array_vector.hxx"
 #include "multi_array.hxx"
@@ -61,11 +62,11 @@ template <class DestType, class TmpType>
 struct MultiBinaryMorphologyImpl
 {
     template <class SrcIterator, class SrcShape, class SrcAccessor,
-              class DestIterator, class DestAccessor>
+              class DestIterator, class DestAccessor, class Array>
     static void
     exec( SrcIterator s, SrcShape const & shape, SrcAccessor src,
           DestIterator d, DestAccessor dest, 
-          double radius, bool dilation)
+          double radius, bool dilation, Array const & pixelPitch)
     {
         using namespace vigra::functor;
         
@@ -73,7 +74,8 @@ struct MultiBinaryMorphologyImpl
         MultiArray<SrcShape::static_size, TmpType> tmpArray(shape);
             
         separableMultiDistSquared(s, shape, src, 
-                                  tmpArray.traverser_begin(), typename AccessorTraits<TmpType>::default_accessor(), dilation );
+                                  tmpArray.traverser_begin(), typename AccessorTraits<TmpType>::default_accessor(), 
+                                  dilation, pixelPitch );
             
         // threshold everything less than radius away from the edge
         double radius2 = radius * radius;
@@ -94,15 +96,15 @@ template <class DestType>
 struct MultiBinaryMorphologyImpl<DestType, DestType>
 {
     template <class SrcIterator, class SrcShape, class SrcAccessor,
-              class DestIterator, class DestAccessor>
+              class DestIterator, class DestAccessor, class Array>
     static void
     exec( SrcIterator s, SrcShape const & shape, SrcAccessor src,
           DestIterator d, DestAccessor dest, 
-          double radius, bool dilation)
+          double radius, bool dilation, Array const & pixelPitch)
     {
         using namespace vigra::functor;
 
-        separableMultiDistSquared( s, shape, src, d, dest, dilation );
+        separableMultiDistSquared( s, shape, src, d, dest, dilation, pixelPitch );
         
         // threshold everything less than radius away from the edge
         DestType radius2 = detail::RequiresExplicitCast<DestType>::cast(radius * radius);
@@ -122,15 +124,50 @@ template <>
 struct MultiBinaryMorphologyImpl<bool, bool>
 {
     template <class SrcIterator, class SrcShape, class SrcAccessor,
-              class DestIterator, class DestAccessor>
+              class DestIterator, class DestAccessor, class Array>
     static void
     exec( SrcIterator s, SrcShape const & shape, SrcAccessor src,
-          DestIterator d, DestAccessor dest, double radius, bool dilation)
+          DestIterator d, DestAccessor dest, double radius, bool dilation, 
+          Array const &)
     {
         vigra_fail("multiBinaryMorphology(): Internal error (this function should never be called).");
     }
 };
 
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+void
+multiBinaryMorphology( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                       DestIterator d, DestAccessor dest, double radius, bool dilation,
+                       Array const & pixelPitch)
+{
+    typedef typename DestAccessor::value_type DestType;
+    typedef Int32 TmpType;
+    
+    double dmax = 0.0;
+    bool pixelPitchIsReal = false;
+    for(int k=0; k<(int)shape.size(); ++k)
+    {
+        if(int(pixelPitch[k]) != pixelPitch[k])
+            pixelPitchIsReal = true;
+        dmax += sq(pixelPitch[k]*shape[k]);
+    }
+
+    // Get the distance squared transform of the image
+    if(pixelPitchIsReal) // distances are not integral
+    {
+        MultiBinaryMorphologyImpl<DestType, double>::exec(s, shape, src, d, dest, radius, dilation, pixelPitch);
+    }
+    else if(dmax > NumericTraits<DestType>::toRealPromote(NumericTraits<DestType>::max()))
+    {
+        MultiBinaryMorphologyImpl<DestType, TmpType>::exec(s, shape, src, d, dest, radius, dilation, pixelPitch);
+    }
+    else    // work directly on the destination array
+    {
+        MultiBinaryMorphologyImpl<DestType, DestType>::exec(s, shape, src, d, dest, radius, dilation, pixelPitch);
+    }
+}
+
 } // namespace detail
 
 /** \addtogroup MultiArrayMorphology Morphological operators for multi-dimensional arrays.
@@ -160,6 +197,12 @@ struct MultiBinaryMorphologyImpl<bool, bool>
     array directly would cause overflow errors (that is if
     <tt> NumericTraits<typename DestAccessor::value_type>::max() < squaredNorm(shape)</tt>, 
     i.e. the squared length of the image diagonal doesn't fit into the destination type).
+    
+    Optionally, one can pass an array that specifies the pixel pitch in each direction,
+    so that anisotropic data (e.g. confocal stacks with a coarser z resolution) can be
+    processed without resampling. The radius is then measured in the same units as 
+    the pixel pitch, and the structuring element becomes an ellipsoid in pixel coordinates.
+    A temporary array is always allocated when the pitch is not integral.
            
     <b> Declarations:</b>
 
@@ -172,6 +215,13 @@ struct MultiBinaryMorphologyImpl<bool, bool>
         multiBinaryErosion(SrcIterator siter, SrcShape const & shape, SrcAccessor src,
                                     DestIterator diter, DestAccessor dest, int radius);
 
+        // explicitly specify pixel pitch for each coordinate
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class Array>
+        void
+        multiBinaryErosion(SrcIterator siter, SrcShape const & shape, SrcAccessor src,
+                                    DestIterator diter, DestAccessor dest, double radius,
+                                    Array const & pixelPitch);
     }
     \endcode
 
@@ -185,6 +235,13 @@ struct MultiBinaryMorphologyImpl<bool, bool>
                                     pair<DestIterator, DestAccessor> const & dest, 
                                     int radius);
 
+        // explicitly specify pixel pitch for each coordinate
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class Array>
+        void
+        multiBinaryErosion(triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                    pair<DestIterator, DestAccessor> const & dest, 
+                                    double radius, Array const & pixelPitch);
     }
     \endcode
 
@@ -200,32 +257,46 @@ struct MultiBinaryMorphologyImpl<bool, bool>
 
     // perform isotropic binary erosion
     multiBinaryErosion(srcMultiArrayRange(source), destMultiArray(dest), 3);
+
+    // the same for data whose z resolution is 5 times coarser than x and y
+    multiBinaryErosion(srcMultiArrayRange(source), destMultiArray(dest), 3.0,
+                       TinyVector<double, 3>(1.0, 1.0, 5.0));
     \endcode
 
     \see vigra::discErosion()
 */
 doxygen_overloaded_function(template <...> void multiBinaryErosion)
 
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline void
+multiBinaryErosion( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                    DestIterator d, DestAccessor dest, double radius,
+                    Array const & pixelPitch)
+{
+    detail::multiBinaryMorphology(s, shape, src, d, dest, radius, false, pixelPitch);
+}
+
 template <class SrcIterator, class SrcShape, class SrcAccessor,
           class DestIterator, class DestAccessor>
-void
+inline void
 multiBinaryErosion( SrcIterator s, SrcShape const & shape, SrcAccessor src,
-                             DestIterator d, DestAccessor dest, double radius)
+                    DestIterator d, DestAccessor dest, double radius)
 {
-    typedef typename DestAccessor::value_type DestType;
-    typedef Int32 TmpType;
-    
-    double dmax = squaredNorm(shape);
+    ArrayVector<double> pixelPitch(shape.size(), 1.0);
+    detail::multiBinaryMorphology(s, shape, src, d, dest, radius, false, pixelPitch);
+}
 
-    // Get the distance squared transform of the image
-    if(dmax > NumericTraits<DestType>::toRealPromote(NumericTraits<DestType>::max()))
-    {
-        detail::MultiBinaryMorphologyImpl<DestType, TmpType>::exec(s, shape, src, d, dest, radius, false);
-    }
-    else    // work directly on the destination array
-    {
-        detail::MultiBinaryMorphologyImpl<DestType, DestType>::exec(s, shape, src, d, dest, radius, false);
-    }
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline
+void multiBinaryErosion(
+    triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+    pair<DestIterator, DestAccessor> const & dest, double radius,
+    Array const & pixelPitch)
+{
+    multiBinaryErosion( source.first, source.second, source.third,
+                        dest.first, dest.second, radius, pixelPitch );
 }
 
 template <class SrcIterator, class SrcShape, class SrcAccessor,
@@ -259,6 +330,12 @@ void multiBinaryErosion(
     array directly would cause overflow errors (that is if
     <tt> NumericTraits<typename DestAccessor::value_type>::max() < squaredNorm(shape)</tt>, 
     i.e. the squared length of the image diagonal doesn't fit into the destination type).
+    
+    Optionally, one can pass an array that specifies the pixel pitch in each direction,
+    so that anisotropic data (e.g. confocal stacks with a coarser z resolution) can be
+    processed without resampling. The radius is then measured in the same units as 
+    the pixel pitch, and the structuring element becomes an ellipsoid in pixel coordinates.
+    A temporary array is always allocated when the pitch is not integral.
            
     <b> Declarations:</b>
 
@@ -271,6 +348,13 @@ void multiBinaryErosion(
         multiBinaryDilation(SrcIterator siter, SrcShape const & shape, SrcAccessor src,
                                     DestIterator diter, DestAccessor dest, int radius);
 
+        // explicitly specify pixel pitch for each coordinate
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class Array>
+        void
+        multiBinaryDilation(SrcIterator siter, SrcShape const & shape, SrcAccessor src,
+                                    DestIterator diter, DestAccessor dest, double radius,
+                                    Array const & pixelPitch);
     }
     \endcode
 
@@ -284,6 +368,13 @@ void multiBinaryErosion(
                                     pair<DestIterator, DestAccessor> const & dest, 
                                     int radius);
 
+        // explicitly specify pixel pitch for each coordinate
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class Array>
+        void
+        multiBinaryDilation(triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                    pair<DestIterator, DestAccessor> const & dest, 
+                                    double radius, Array const & pixelPitch);
     }
     \endcode
 
@@ -299,32 +390,46 @@ void multiBinaryErosion(
 
     // perform isotropic binary erosion
     multiBinaryDilation(srcMultiArrayRange(source), destMultiArray(dest), 3);
+
+    // the same for data whose z resolution is 5 times coarser than x and y
+    multiBinaryDilation(srcMultiArrayRange(source), destMultiArray(dest), 3.0,
+                       TinyVector<double, 3>(1.0, 1.0, 5.0));
     \endcode
 
     \see vigra::discDilation()
 */
 doxygen_overloaded_function(template <...> void multiBinaryDilation)
 
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline void
+multiBinaryDilation( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                    DestIterator d, DestAccessor dest, double radius,
+                    Array const & pixelPitch)
+{
+    detail::multiBinaryMorphology(s, shape, src, d, dest, radius, true, pixelPitch);
+}
+
 template <class SrcIterator, class SrcShape, class SrcAccessor,
           class DestIterator, class DestAccessor>
-void
+inline void
 multiBinaryDilation( SrcIterator s, SrcShape const & shape, SrcAccessor src,
-                             DestIterator d, DestAccessor dest, double radius)
+                    DestIterator d, DestAccessor dest, double radius)
 {
-    typedef typename DestAccessor::value_type DestType;
-    typedef Int32 TmpType;
-    
-    double dmax = squaredNorm(shape);
+    ArrayVector<double> pixelPitch(shape.size(), 1.0);
+    detail::multiBinaryMorphology(s, shape, src, d, dest, radius, true, pixelPitch);
+}
 
-    // Get the distance squared transform of the image
-    if(dmax > NumericTraits<DestType>::toRealPromote(NumericTraits<DestType>::max()))
-    {
-        detail::MultiBinaryMorphologyImpl<DestType, TmpType>::exec(s, shape, src, d, dest, radius, true);
-    }
-    else    // work directly on the destination array
-    {
-        detail::MultiBinaryMorphologyImpl<DestType, DestType>::exec(s, shape, src, d, dest, radius, true);
-    }
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline
+void multiBinaryDilation(
+    triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+    pair<DestIterator, DestAccessor> const & dest, double radius,
+    Array const & pixelPitch)
+{
+    multiBinaryDilation( source.first, source.second, source.third,
+                        dest.first, dest.second, radius, pixelPitch );
 }
 
 template <class SrcIterator, class SrcShape, class SrcAccessor,
@@ -576,6 +681,322 @@ void multiGrayscaleDilation(
             dest.first, dest.second, sigma);
 }
 
+/********************************************************/
+/*                                                      */
+/*         multiGrayscaleBoxErosion/Dilation            */
+/*                                                      */
+/********************************************************/
+
+namespace detail {
+
+template <class T>
+struct VanHerkMin
+{
+    static T identity() { return NumericTraits<T>::max(); }
+    T operator()(T a, T b) const { return b < a ? b : a; }
+};
+
+template <class T>
+struct VanHerkMax
+{
+    static T identity() { return NumericTraits<T>::min(); }
+    T operator()(T a, T b) const { return a < b ? b : a; }
+};
+
+    // Running minimum/maximum over windows of size 2*radius+1 by the algorithm
+    // of van Herk and Gil/Werman, which needs 3 comparisons per element
+    // regardless of the radius. 'buf' holds 'width' independent lines in 
+    // interleaved order, i.e. element j of line x is at buf[j*width + x], 
+    // with 'radius' rows of padding before and after the 'length' data rows. 
+    // All loops run over x, so they can be vectorized by the compiler. 
+    // The result is written to the first 'length' rows of 'h'.
+template <class T, class Functor>
+void vanHerkGilWerman(T * buf, T * h, int length, int width, int radius, Functor op)
+{
+    int size = 2*radius + 1, padded = length + 2*radius;
+
+    for(int j=0; j<radius; ++j)
+    {
+        std::fill(buf + j*width, buf + (j+1)*width, Functor::identity());
+        std::fill(buf + (length+radius+j)*width, buf + (length+radius+j+1)*width, 
+                  Functor::identity());
+    }
+
+    for(int b=0; b<padded; b+=size)
+    {
+        int e = std::min(b+size, padded);
+
+        // suffix extrema of the block
+        std::copy(buf + (e-1)*width, buf + e*width, h + (e-1)*width);
+        for(int j=e-2; j>=b; --j)
+        {
+            T const * s = buf + j*width, * hn = h + (j+1)*width;
+            T * hj = h + j*width;
+            for(int x=0; x<width; ++x)
+                hj[x] = op(s[x], hn[x]);
+        }
+
+        // prefix extrema of the block (in-place)
+        for(int j=b+1; j<e; ++j)
+        {
+            T const * gp = buf + (j-1)*width;
+            T * g = buf + j*width;
+            for(int x=0; x<width; ++x)
+                g[x] = op(gp[x], g[x]);
+        }
+    }
+
+    // the window [j, j+2*radius] covers the end of one block and the 
+    // beginning of the next (or lies exactly in one block)
+    for(int j=0; j<length; ++j)
+    {
+        T const * g = buf + (j+2*radius)*width;
+        T * hj = h + j*width;
+        for(int x=0; x<width; ++x)
+            hj[x] = op(hj[x], g[x]);
+    }
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array, class Functor>
+void
+multiVanHerkGilWerman( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                       DestIterator d, DestAccessor dest, Array const & radii, Functor op)
+{
+    typedef typename NumericTraits<typename DestAccessor::value_type>::ValueType TmpType;
+    enum { N = 1 + SrcIterator::level };
+
+    typedef MultiArrayNavigator<SrcIterator, N> SNavigator;
+    typedef MultiArrayNavigator<DestIterator, N> DNavigator;
+
+    for(int k=0; k<N; ++k)
+        vigra_precondition(radii[k] >= 0,
+            "multiGrayscaleBoxErosion/Dilation(): radius must be non-negative.");
+
+    ArrayVector<TmpType> buf, h;
+    ArrayVector<typename DNavigator::iterator> lines;
+    bool first = true;
+    for(int k=0; k<N; ++k)
+    {
+        int radius = (int)std::min<MultiArrayIndex>(radii[k], shape[k]);
+        if(radius == 0)
+            continue;
+
+        // lines along dimension k > 0 are processed in batches of shape[0]
+        // neighbors, so that the inner loops run along dimension 0
+        int length = (int)shape[k], 
+            width = (k == 0) 
+                        ? 1 
+                        : (int)shape[0];
+        buf.resize((length + 2*radius) * width);
+        h.resize((length + 2*radius) * width);
+
+        // the first pass reads from the source, the others work in-place on the destination
+        SNavigator snav( s, shape, k );
+        DNavigator dnav( d, shape, k );
+        for(; dnav.hasMore(); )
+        {
+            lines.clear();
+            for(int x=0; x<width; ++x, ++dnav)
+            {
+                TmpType * b = buf.begin() + radius*width + x;
+                if(first)
+                {
+                    typename SNavigator::iterator i = snav.begin(), end = snav.end();
+                    for(; i != end; ++i, b += width)
+                        *b = detail::RequiresExplicitCast<TmpType>::cast(src(i));
+                    ++snav;
+                }
+                else
+                {
+                    typename DNavigator::iterator i = dnav.begin(), end = dnav.end();
+                    for(; i != end; ++i, b += width)
+                        *b = dest(i);
+                }
+                lines.push_back(dnav.begin());
+            }
+
+            vanHerkGilWerman(buf.begin(), h.begin(), length, width, radius, op);
+
+            for(int x=0; x<width; ++x)
+            {
+                TmpType const * r = h.begin() + x;
+                typename DNavigator::iterator i = lines[x];
+                for(int j=0; j<length; ++j, ++i, r += width)
+                    dest.set(*r, i);
+            }
+        }
+        first = false;
+    }
+    if(first)
+        copyMultiArray(s, shape, src, d, dest);
+}
+
+} // namespace detail
+
+/** \brief Grayscale erosion with a box-shaped structuring element on multi-dimensional arrays.
+
+    This function computes the minimum of the source array over an axis-aligned
+    box around each element, i.e. a grayscale erosion with a flat rectangular
+    structuring element. The box extends by <tt>radii[k]</tt> elements to either
+    side along dimension <tt>k</tt>, so its size is <tt>2*radii[k]+1</tt>. A radius
+    of zero leaves the corresponding dimension alone, so that line-shaped structuring
+    elements are obtained by setting all but one radius to zero. Outside the array,
+    the source is considered to be <tt>NumericTraits<DestType>::max()</tt>,
+    so that the result is the minimum over the part of the box inside the array.
+
+    The filter is applied separably, and each 1D pass uses the algorithm of
+    van Herk and Gil/Werman, which needs only three comparisons per element
+    independent of the radius. Along dimensions other than the first, consecutive 
+    lines are processed together in order to access memory sequentially.
+    
+    This function may work in-place, which means that <tt>siter == diter</tt> is allowed.
+    The <tt>radii</tt> can be any array type supporting <tt>operator[]</tt> 
+    (e.g. a <tt>TinyVector</tt>) with one entry per dimension.
+
+    <b> Declarations:</b>
+
+    pass arguments explicitly:
+    \code
+    namespace vigra {
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class Array>
+        void
+        multiGrayscaleBoxErosion(SrcIterator siter, SrcShape const & shape, SrcAccessor src,
+                                 DestIterator diter, DestAccessor dest, Array const & radii);
+
+    }
+    \endcode
+
+    use argument objects in conjunction with \ref ArgumentObjectFactories :
+    \code
+    namespace vigra {
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class Array>
+        void
+        multiGrayscaleBoxErosion(triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                 pair<DestIterator, DestAccessor> const & dest, 
+                                 Array const & radii);
+
+    }
+    \endcode
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/multi_morphology.hxx\>
+
+    \code
+    MultiArray<3, unsigned char>::size_type shape(width, height, depth);
+    MultiArray<3, unsigned char> source(shape);
+    MultiArray<3, unsigned char> dest(shape);
+    ...
+
+    // erosion with a 7x7x3 box
+    multiGrayscaleBoxErosion(srcMultiArrayRange(source), destMultiArray(dest), 
+                             TinyVector<int, 3>(3, 3, 1));
+    \endcode
+
+    \see vigra::multiGrayscaleErosion(), vigra::multiGrayscaleBoxDilation()
+*/
+doxygen_overloaded_function(template <...> void multiGrayscaleBoxErosion)
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline
+void multiGrayscaleBoxErosion( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                               DestIterator d, DestAccessor dest, Array const & radii)
+{
+    typedef typename NumericTraits<typename DestAccessor::value_type>::ValueType DestType;
+    detail::multiVanHerkGilWerman(s, shape, src, d, dest, radii, detail::VanHerkMin<DestType>());
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline 
+void multiGrayscaleBoxErosion(
+    triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+    pair<DestIterator, DestAccessor> const & dest, Array const & radii)
+{
+    multiGrayscaleBoxErosion( source.first, source.second, source.third, 
+                              dest.first, dest.second, radii);
+}
+
+/** \brief Grayscale dilation with a box-shaped structuring element on multi-dimensional arrays.
+
+    This function computes the maximum of the source array over an axis-aligned
+    box around each element. Outside the array, the source is considered to be
+    <tt>NumericTraits<DestType>::min()</tt>. Otherwise, the semantics and the
+    algorithm are the same as in \ref multiGrayscaleBoxErosion().
+    
+    This function may work in-place, which means that <tt>siter == diter</tt> is allowed.
+
+    <b> Declarations:</b>
+
+    pass arguments explicitly:
+    \code
+    namespace vigra {
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class Array>
+        void
+        multiGrayscaleBoxDilation(SrcIterator siter, SrcShape const & shape, SrcAccessor src,
+                                  DestIterator diter, DestAccessor dest, Array const & radii);
+
+    }
+    \endcode
+
+    use argument objects in conjunction with \ref ArgumentObjectFactories :
+    \code
+    namespace vigra {
+        template <class SrcIterator, class SrcShape, class SrcAccessor,
+                  class DestIterator, class DestAccessor, class Array>
+        void
+        multiGrayscaleBoxDilation(triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+                                  pair<DestIterator, DestAccessor> const & dest, 
+                                  Array const & radii);
+
+    }
+    \endcode
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/multi_morphology.hxx\>
+
+    \code
+    MultiArray<3, float>::size_type shape(width, height, depth);
+    MultiArray<3, float> source(shape);
+    MultiArray<3, float> dest(shape);
+    ...
+
+    // dilation with a line of length 11 along the y-axis
+    multiGrayscaleBoxDilation(srcMultiArrayRange(source), destMultiArray(dest), 
+                              TinyVector<int, 3>(0, 5, 0));
+    \endcode
+
+    \see vigra::multiGrayscaleDilation(), vigra::multiGrayscaleBoxErosion()
+*/
+doxygen_overloaded_function(template <...> void multiGrayscaleBoxDilation)
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline
+void multiGrayscaleBoxDilation( SrcIterator s, SrcShape const & shape, SrcAccessor src,
+                                DestIterator d, DestAccessor dest, Array const & radii)
+{
+    typedef typename NumericTraits<typename DestAccessor::value_type>::ValueType DestType;
+    detail::multiVanHerkGilWerman(s, shape, src, d, dest, radii, detail::VanHerkMax<DestType>());
+}
+
+template <class SrcIterator, class SrcShape, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Array>
+inline 
+void multiGrayscaleBoxDilation(
+    triple<SrcIterator, SrcShape, SrcAccessor> const & source,
+    pair<DestIterator, DestAccessor> const & dest, Array const & radii)
+{
+    multiGrayscaleBoxDilation( source.first, source.second, source.third, 
+                               dest.first, dest.second, radii);
+}
+
 
 //@}
 
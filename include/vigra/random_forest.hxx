@@ -60,6 +60,7 @@
 #include "random_forest/rf_online_prediction_set.hxx"
 #include "random_forest/rf_earlystopping.hxx"
 #include "random_forest/rf_ridge_split.hxx"
+#include "threadpool.hxx"
 namespace vigra
 {
 
@@ -86,6 +87,25 @@ inline SamplerOptions make_sampler_opt ( RandomForestOptions     & RF_opt)
     return_opt.stratified(RF_opt.stratification_method_ == RF_EQUAL);
     return return_opt;
 }
+
+/* \brief does the stopping criterion never stop prediction early?
+ *
+ * Blocked prediction (see RandomForest::predictProbabilities()) visits
+ * the trees in a different order than row-wise prediction and is 
+ * therefore only used when the stopping criterion has no effect.
+ */
+template <class Stop>
+struct RFPredictionStopIsTrivial
+{
+    static const bool value = false;
+};
+
+template <>
+struct RFPredictionStopIsTrivial<EarlyStoppStd>
+{
+    static const bool value = true;
+};
+
 }//namespace detail
 
 /** Random Forest class
@@ -156,10 +176,6 @@ class RandomForest
     typedef LabelType                       LabelT; 
   protected:
 
-    /** optimisation for predictLabels
-     * */
-    mutable MultiArray<2, double> garbage_prediction_;
-
   public:
 
     //problem independent data.
@@ -168,6 +184,8 @@ class RandomForest
     //a copy constructor, some sort of import
     //function or the learn function is called
     ArrayVector<DecisionTree_t>                 trees_;
+    //packed copies of the trees for prediction - see compile()
+    ArrayVector<detail::CompiledDecisionTree>   compiled_trees_;
     ProblemSpec_t                               ext_param_;
     /*mutable ArrayVector<int>                    tree_indices_;*/
     rf::visitors::OnlineLearnVisitor            online_visitor_;
@@ -177,6 +195,7 @@ class RandomForest
     {
         ext_param_.clear();
         trees_.clear();
+        compiled_trees_.clear();
     }
 
   public:
@@ -244,6 +263,7 @@ class RandomForest
             trees_[k].topology_ = *topology_begin;
             trees_[k].parameters_ = *parameter_begin;
         }
+        compile();
     }
 
     /*\}*/
@@ -312,12 +332,63 @@ class RandomForest
     }
 
     /**\brief access trees
+     *
+     * Since the tree may be modified through the returned reference,
+     * this discards the compiled trees, and prediction uses the original
+     * trees until compile() is called again.
      */
     DecisionTree_t & tree(int index)
     {
+        compiled_trees_.clear();
         return trees_[index];
     }
 
+    /**\brief convert the trees into the packed layout used for prediction
+     *
+     * Each node of a compiled tree is stored as a single struct, and the
+     * nodes are arranged in breadth-first order (see 
+     * detail::CompiledDecisionTree). This reduces the number of cache
+     * misses during prediction considerably, and the predictions are 
+     * identical to those of the original trees. 
+     *
+     * Forests can be trained on <tt>float</tt> features directly (the
+     * features are never converted to double). For prediction on 
+     * <tt>MultiArrayView<2, float></tt>, the compiled trees use single 
+     * precision thresholds, which are rounded such that all decisions 
+     * are the same as with the original double thresholds. Together with 
+     * the float feature tiles of predictProbabilities(), this halves the
+     * memory traffic of the prediction. 
+     *
+     * learn(), onlineLearn(), reLearnTree() and rf_import_HDF5() compile
+     * the forest automatically. Call this function again after 
+     * modifying the trees by other means.
+     *
+     * \return true if all trees could be converted. Otherwise (i.e. if
+     *  the forest contains node types other than threshold nodes and
+     *  constant probability leaves), prediction continues to use the
+     *  original trees.
+     */
+    bool compile()
+    {
+        compiled_trees_.resize(trees_.size());
+        for(unsigned int k=0; k<trees_.size(); ++k)
+        {
+            if(!compiled_trees_[k].compile(trees_[k]))
+            {
+                compiled_trees_.clear();
+                return false;
+            }
+        }
+        return trees_.size() > 0;
+    }
+
+    /**\brief is the packed layout used for prediction?
+     */
+    bool is_compiled() const
+    {
+        return compiled_trees_.size() > 0 && compiled_trees_.size() == trees_.size();
+    }
+
     /*\}*/
 
     /**\brief return number of features used while 
@@ -463,6 +534,64 @@ class RandomForest
                 Stop_t                              stop,
                 Random_t                 const  &   random);
 
+    /**\brief learn the trees of the forest in parallel
+     *
+     * Arguments are as in the serial version. Each tree is learned
+     * by a separate task with its own random number generator of type
+     * Random_t (which must be constructible from a UInt32 seed).
+     * The seeds are drawn in tree order from \a random before
+     * learning starts, so that a given seed of \a random
+     * produces the same forest regardless of the number of threads.
+     * Note that this forest differs from the one the serial learn()
+     * produces with the same seed, because the serial version draws all
+     * trees from a single random stream.
+     *
+     * Visitors need not be thread-safe: visit_after_split() calls are
+     * serialized by a mutex (their order across different trees is
+     * unspecified when more than one thread is used),
+     * whereas visit_after_tree() is called in tree order after all
+     * trees have been learned, with the sampler and first stack entry
+     * of the respective tree. If online learning is enabled
+     * (RandomForestOptions::prepare_online_learning_), the
+     * trees are learned sequentially.
+     *
+     * \param options   number of threads, see \ref ParallelOptions
+     */
+    template <class U, class C1,
+             class U2,class C2,
+             class Split_t,
+             class Stop_t,
+             class Visitor_t,
+             class Random_t>
+    void learn( MultiArrayView<2, U, C1> const  &   features,
+                MultiArrayView<2, U2,C2> const  &   response,
+                Visitor_t                           visitor,
+                Split_t                             split,
+                Stop_t                              stop,
+                Random_t                 const  &   random,
+                ParallelOptions          const  &   options);
+
+    /**\brief learn the trees of the forest in parallel with default
+     *        configuration
+     *
+     * Like the serial learn() with default configuration, the master
+     * random number generator is randomly seeded.
+     */
+    template <class U, class C1, class U2,class C2>
+    void learn( MultiArrayView<2, U, C1> const  &   features,
+                MultiArrayView<2, U2,C2> const  &   labels,
+                ParallelOptions          const  &   options)
+    {
+        RandomNumberGenerator<> rnd = RandomNumberGenerator<>(RandomSeed);
+        learn(  features,
+                labels,
+                rf_default(),
+                rf_default(),
+                rf_default(),
+                rnd,
+                options);
+    }
+
     template <class U, class C1,
              class U2,class C2,
              class Split_t,
@@ -543,6 +672,14 @@ class RandomForest
 
 
     /**\name prediction
+     *
+     * All const prediction functions leave the forest untouched (the
+     * compiled trees are built completely by learn() and the import 
+     * functions) and keep their scratch space in local variables, on 
+     * the stack unless there are very many classes or feature columns.
+     * A learned forest can therefore be used by any number of threads 
+     * at the same time (as long as no thread modifies it, and each 
+     * thread passes its own early stopping object).
      */
     /*\{*/
     /** \brief predict a label given a feature.
@@ -560,7 +697,7 @@ class RandomForest
     LabelType predictLabel(MultiArrayView<2, U, C>const & features, Stop & stop) const;
 
     template <class U, class C>
-    LabelType predictLabel(MultiArrayView<2, U, C>const & features)
+    LabelType predictLabel(MultiArrayView<2, U, C>const & features) const
     {
         return predictLabel(features, rf_default()); 
     } 
@@ -586,22 +723,56 @@ class RandomForest
     void predictLabels(MultiArrayView<2, U, C1>const & features,
                        MultiArrayView<2, T, C2> & labels) const
     {
-        vigra_precondition(features.shape(0) == labels.shape(0),
-            "RandomForest::predictLabels(): Label array has wrong size.");
-        for(int k=0; k<features.shape(0); ++k)
-            labels(k,0) = detail::RequiresExplicitCast<T>::cast(predictLabel(rowVector(features, k), rf_default()));
+        predictLabels(features, labels, rf_default());
     }
 
     template <class U, class C1, class T, class C2, class Stop>
     void predictLabels(MultiArrayView<2, U, C1>const & features,
                        MultiArrayView<2, T, C2> & labels,
-                       Stop                     & stop) const
+                       Stop                     & stop) const;
+
+    /** \brief predict multiple labels in parallel
+     *
+     * The rows of the feature matrix are split into contiguous chunks 
+     * which are classified concurrently by the threads of a \ref ThreadPool.
+     * The result is identical to the serial version.
+     *
+     * \param features: a n by featureCount matrix containing
+     *        data point to be predicted (this only works in
+     *        classification setting)
+     * \param labels: a n by 1 matrix passed by reference to store
+     *        output.
+     * \param stop: early stopping criterion. Each chunk of rows is 
+     *        processed with its own copy of \a stop, whose statistics
+     *        are cleared by <tt>copy.reset_statistics()</tt>. Afterwards, 
+     *        the copies are merged into \a stop in row order by calling
+     *        <tt>stop.merge(copy)</tt> (all criteria derived from 
+     *        StopBase provide these functions).
+     * \param options: number of threads, see \ref ParallelOptions
+     */
+    template <class U, class C1, class T, class C2, class Stop>
+    void predictLabels(MultiArrayView<2, U, C1>const & features,
+                       MultiArrayView<2, T, C2> & labels,
+                       Stop                     & stop,
+                       ParallelOptions const    & options) const;
+
+    template <class U, class C1, class T, class C2>
+    void predictLabels(MultiArrayView<2, U, C1>const & features,
+                       MultiArrayView<2, T, C2> & labels,
+                       ParallelOptions const    & options) const
     {
-        vigra_precondition(features.shape(0) == labels.shape(0),
-            "RandomForest::predictLabels(): Label array has wrong size.");
-        for(int k=0; k<features.shape(0); ++k)
-            labels(k,0) = detail::RequiresExplicitCast<T>::cast(predictLabel(rowVector(features, k), stop));
+        predictLabels(features, labels, rf_default(), options);
     }
+
+    // (needed because the Stop template above would be a better match)
+    template <class U, class C1, class T, class C2>
+    void predictLabels(MultiArrayView<2, U, C1>const & features,
+                       MultiArrayView<2, T, C2> & labels,
+                       ParallelOptions          & options) const
+    {
+        predictLabels(features, labels, rf_default(), options);
+    }
+
     /** \brief predict the class probabilities for multiple labels
      *
      *  \param features same as above
@@ -619,6 +790,13 @@ class RandomForest
                                MultiArrayView<2, T2, C> &       prob);
 
     /** \brief predict the class probabilities for multiple labels
+     *
+     *  When the forest is compiled (see compile()) and no early stopping
+     *  criterion is given, the rows are processed in tiles of 64: the 
+     *  features of a tile are copied into a column-major buffer, and the
+     *  whole tile is pushed through one tree before the next tree is 
+     *  loaded. This keeps each tree in cache while it is being used. 
+     *  The result is identical to row-wise prediction.
      *
      *  \param features same as above
      *  \param prob a n x class_count_ matrix. passed by reference to
@@ -631,10 +809,68 @@ class RandomForest
         predictProbabilities(features, prob, rf_default()); 
     }   
 
+    /** \brief predict the class probabilities for multiple labels in parallel
+     *
+     *  The rows of the feature matrix are split into contiguous chunks 
+     *  which are processed concurrently. The result is identical to 
+     *  the serial version, also when an early stopping criterion is
+     *  given (see predictLabels() for how \a stop is handled).
+     *
+     *  \param features same as above
+     *  \param prob a n x class_count_ matrix. passed by reference to
+     *  save class probabilities
+     *  \param stop earlystopping criterion 
+     *  \param options number of threads, see \ref ParallelOptions
+     */
+    template <class U, class C1, class T, class C2, class Stop>
+    void predictProbabilities(MultiArrayView<2, U, C1>const &   features,
+                              MultiArrayView<2, T, C2> &        prob,
+                              Stop                     &        stop,
+                              ParallelOptions const    &        options) const;
+
+    template <class U, class C1, class T, class C2>
+    void predictProbabilities(MultiArrayView<2, U, C1>const &   features,
+                              MultiArrayView<2, T, C2> &        prob,
+                              ParallelOptions const    &        options) const
+    {
+        predictProbabilities(features, prob, rf_default(), options); 
+    }
+
+    // (needed because the Stop template above would be a better match)
+    template <class U, class C1, class T, class C2>
+    void predictProbabilities(MultiArrayView<2, U, C1>const &   features,
+                              MultiArrayView<2, T, C2> &        prob,
+                              ParallelOptions          &        options) const
+    {
+        predictProbabilities(features, prob, rf_default(), options); 
+    }
+
     template <class U, class C1, class T, class C2>
     void predictRaw(MultiArrayView<2, U, C1>const &   features,
                     MultiArrayView<2, T, C2> &        prob)  const;
 
+    // internal: classify the rows [begin, end) with a prepared stopping criterion
+    // predict a single row with the compiled tree if available
+    template <class U, class C>
+    ArrayVector<double>::const_iterator
+    predictTree(int k, MultiArrayView<2, U, C> const & features) const
+    {
+        return is_compiled()
+                   ? compiled_trees_[k].predict(features)
+                   : ArrayVector<double>::const_iterator(trees_[k].predict(features));
+    }
+
+    template <class U, class C1, class T, class C2>
+    void predictProbabilitiesBlocked(MultiArrayView<2, U, C1>const &   features,
+                                     MultiArrayView<2, T, C2> &        prob,
+                                     int begin, int end) const;
+
+    template <class U, class C1, class T, class C2, class Stop>
+    void predictProbabilitiesImpl(MultiArrayView<2, U, C1>const &   features,
+                                  MultiArrayView<2, T, C2> &        prob,
+                                  Stop                     &        stop,
+                                  int begin, int end) const;
+
 
     /*\}*/
 
@@ -699,6 +935,7 @@ void RandomForest<LabelType, PreprocessorTag>::onlineLearn(MultiArrayView<2,U,C1
 
     // Give the Split functor information about the data.
     split.set_external_parameters(ext_param_);
+    detail::prepareSplitFunctor(split, preprocessor.features());
     stop.set_external_parameters(ext_param_);
 
 
@@ -778,6 +1015,7 @@ void RandomForest<LabelType, PreprocessorTag>::onlineLearn(MultiArrayView<2,U,C1
 
     //visitor.visit_at_end(*this, preprocessor);
     online_visitor_.deactivate();
+    compile();
 }
 
 template<class LabelType, class PreprocessorTag>
@@ -839,6 +1077,7 @@ void RandomForest<LabelType, PreprocessorTag>::reLearnTree(MultiArrayView<2,U,C1
 
     // Give the Split functor information about the data.
     split.set_external_parameters(ext_param_);
+    detail::prepareSplitFunctor(split, preprocessor.features());
     stop.set_external_parameters(ext_param_);
 
     /**\todo    replace this crappy class out. It uses function pointers.
@@ -880,6 +1119,7 @@ void RandomForest<LabelType, PreprocessorTag>::reLearnTree(MultiArrayView<2,U,C1
                             treeId);
 
     online_visitor_.deactivate();
+    compile();
 }
 
 template <class LabelType, class PreprocessorTag>
@@ -944,6 +1184,7 @@ void RandomForest<LabelType, PreprocessorTag>::
 
     // Give the Split functor information about the data.
     split.set_external_parameters(ext_param_);
+    detail::prepareSplitFunctor(split, preprocessor.features());
     stop.set_external_parameters(ext_param_);
 
 
@@ -990,6 +1231,218 @@ void RandomForest<LabelType, PreprocessorTag>::
     visitor.visit_at_end(*this, preprocessor);
     // Only for online learning?
     online_visitor_.deactivate();
+    compile();
+}
+
+namespace detail
+{
+
+    // random number generator, sampler and first stack entry of a single
+    // tree in parallel learning - the sample only depends on the seed
+template <class Random_t, class StackEntry_t>
+struct RFTreeSample
+{
+    Random_t                random;
+    Sampler<Random_t>       sampler;
+    StackEntry_t            first_stack_entry;
+
+    template <class Iterator>
+    RFTreeSample(UInt32 seed, Iterator strataBegin, Iterator strataEnd,
+                 SamplerOptions const & opt, int classCount)
+    : random(seed),
+      sampler(strataBegin, strataEnd, opt, random),
+      first_stack_entry(drawSample(sampler, classCount))
+    {}
+
+    static StackEntry_t drawSample(Sampler<Random_t> & sampler, int classCount)
+    {
+        sampler.sample();
+        StackEntry_t entry(sampler.sampledIndices().begin(),
+                           sampler.sampledIndices().end(),
+                           classCount);
+        entry.set_oob_range(sampler.oobIndices().begin(),
+                            sampler.oobIndices().end());
+        return entry;
+    }
+};
+
+    // forwards visit_after_split() to a visitor shared by several threads
+template <class Visitor>
+class RFLockedSplitVisitor
+{
+  public:
+    Visitor * visitor_;
+    Mutex   * mutex_;
+
+    RFLockedSplitVisitor(Visitor & visitor, Mutex & mutex)
+    : visitor_(&visitor),
+      mutex_(&mutex)
+    {}
+
+    template<class Tree, class Split, class Region, class Feature_t, class Label_t>
+    void visit_after_split( Tree          & tree,
+                            Split         & split,
+                            Region        & parent,
+                            Region        & leftChild,
+                            Region        & rightChild,
+                            Feature_t     & features,
+                            Label_t       & labels)
+    {
+        LockGuard guard(*mutex_);
+        visitor_->visit_after_split(tree, split, parent, leftChild, rightChild,
+                                    features, labels);
+    }
+};
+
+template <class RF, class Preprocessor, class Split, class Stop, class Visitor, class Random_t>
+struct RFLearnTreeFunctor
+{
+    typedef RFTreeSample<Random_t, typename RF::StackEntry_t> Sample;
+
+    RF * rf;
+    Preprocessor * preprocessor;
+    Split const * split;
+    Stop const * stop;
+    Visitor * visitor;
+    ArrayVector<UInt32> const * seeds;
+    SamplerOptions sampler_options;
+
+    void learnTree(int tree, Sample & sample) const
+    {
+        UniformIntRandomFunctor<Random_t> randint(sample.random);
+        rf->trees_[tree].learn(preprocessor->features(),
+                               preprocessor->response(),
+                               sample.first_stack_entry,
+                               *split,
+                               *stop,
+                               *visitor,
+                               randint);
+    }
+
+    void operator()(int /* threadIndex */, std::ptrdiff_t tree) const
+    {
+        Sample sample((*seeds)[tree],
+                      preprocessor->strata().begin(), preprocessor->strata().end(),
+                      sampler_options, rf->ext_param_.class_count_);
+        learnTree(tree, sample);
+    }
+};
+
+} // namespace detail
+
+template <class LabelType, class PreprocessorTag>
+template <class U, class C1,
+         class U2,class C2,
+         class Split_t,
+         class Stop_t,
+         class Visitor_t,
+         class Random_t>
+void RandomForest<LabelType, PreprocessorTag>::
+                     learn( MultiArrayView<2, U, C1> const  &   features,
+                            MultiArrayView<2, U2,C2> const  &   response,
+                            Visitor_t                           visitor_,
+                            Split_t                             split_,
+                            Stop_t                              stop_,
+                            Random_t                 const  &   random,
+                            ParallelOptions          const  &   options)
+{
+    using namespace rf;
+    typedef Processor<PreprocessorTag,LabelType, U, C1, U2, C2> Preprocessor_t;
+
+    #define RF_CHOOSER(type_) detail::Value_Chooser<type_, Default_##type_>
+    Default_Stop_t default_stop(options_);
+    typedef typename RF_CHOOSER(Stop_t)::type Stop;
+    Stop stop = RF_CHOOSER(Stop_t)::choose(stop_, default_stop);
+    Default_Split_t default_split;
+    typedef typename RF_CHOOSER(Split_t)::type Split;
+    Split split = RF_CHOOSER(Split_t)::choose(split_, default_split);
+    rf::visitors::StopVisiting stopvisiting;
+    typedef  rf::visitors::detail::VisitorNode<
+                rf::visitors::OnlineLearnVisitor,
+                typename RF_CHOOSER(Visitor_t)::type> IntermedVis;
+    IntermedVis
+        visitor(online_visitor_, RF_CHOOSER(Visitor_t)::choose(visitor_, stopvisiting));
+    #undef RF_CHOOSER
+    if(options_.prepare_online_learning_)
+        online_visitor_.activate();
+    else
+        online_visitor_.deactivate();
+
+    Preprocessor_t preprocessor(    features, response,
+                                    options_, ext_param_);
+    split.set_external_parameters(ext_param_);
+    detail::prepareSplitFunctor(split, preprocessor.features());
+    stop.set_external_parameters(ext_param_);
+
+    trees_.resize(options_.tree_count_  , DecisionTree_t(ext_param_));
+
+    // draw the seeds of the per-tree random streams up front, so that
+    // the forest doesn't depend on the order in which trees are learned
+    ArrayVector<UInt32> seeds(trees_.size());
+    for(unsigned int k = 0; k < seeds.size(); ++k)
+        seeds[k] = random();
+    SamplerOptions sampler_options = detail::make_sampler_opt(options_)
+                                        .sampleSize(ext_param().actual_msample_);
+
+    typedef detail::RFTreeSample<Random_t, StackEntry_t> Sample;
+    visitor.visit_at_beginning(*this, preprocessor);
+
+    int treeCount = (int)trees_.size();
+    if(options.getActualNumThreads() <= 1 || treeCount <= 1 ||
+       options_.prepare_online_learning_)
+    {
+        // the online visitor relies on the trees being visited in order
+        detail::RFLearnTreeFunctor<RandomForest, Preprocessor_t, Split, Stop,
+                                   IntermedVis, Random_t> f;
+        f.rf = this;
+        f.preprocessor = &preprocessor;
+        f.split = &split;
+        f.stop = &stop;
+        f.visitor = &visitor;
+        f.seeds = &seeds;
+        f.sampler_options = sampler_options;
+        for(int ii = 0; ii < treeCount; ++ii)
+        {
+            Sample sample(seeds[ii],
+                          preprocessor.strata().begin(), preprocessor.strata().end(),
+                          sampler_options, ext_param_.class_count_);
+            f.learnTree(ii, sample);
+            visitor.visit_after_tree(*this, preprocessor, sample.sampler,
+                                     sample.first_stack_entry, ii);
+        }
+    }
+    else
+    {
+        typedef detail::RFLockedSplitVisitor<IntermedVis> LockedVis;
+        Mutex mutex;
+        LockedVis locked_visitor(visitor, mutex);
+        detail::RFLearnTreeFunctor<RandomForest, Preprocessor_t, Split, Stop,
+                                   LockedVis, Random_t> f;
+        f.rf = this;
+        f.preprocessor = &preprocessor;
+        f.split = &split;
+        f.stop = &stop;
+        f.visitor = &locked_visitor;
+        f.seeds = &seeds;
+        f.sampler_options = sampler_options;
+        parallel_foreach(options, treeCount, f);
+
+        // The samples are reproduced from the seeds rather than kept
+        // alive during learning, which would require memory proportional
+        // to the number of trees.
+        for(int ii = 0; ii < treeCount; ++ii)
+        {
+            Sample sample(seeds[ii],
+                          preprocessor.strata().begin(), preprocessor.strata().end(),
+                          sampler_options, ext_param_.class_count_);
+            visitor.visit_after_tree(*this, preprocessor, sample.sampler,
+                                     sample.first_stack_entry, ii);
+        }
+    }
+
+    visitor.visit_at_end(*this, preprocessor);
+    online_visitor_.deactivate();
+    compile();
 }
 
 
@@ -1007,14 +1460,59 @@ LabelType RandomForest<LabelType, Tag>
         "RandomForestn::predictLabel():"
             " Feature matrix must have a singlerow.");
     typedef MultiArrayShape<2>::type Shp;
-    garbage_prediction_.reshape(Shp(1, ext_param_.class_count_), 0.0);
+    // the scratch space lives on the stack (unless there are very many
+    // classes), so that concurrent calls do not interfere
+    enum { StackClassCount = 32 };
+    double              stackBuffer[StackClassCount];
+    ArrayVector<double> heapBuffer;
+    double * buffer = stackBuffer;
+    if(ext_param_.class_count_ > StackClassCount)
+    {
+        heapBuffer.resize(ext_param_.class_count_);
+        buffer = heapBuffer.data();
+    }
+    MultiArrayView<2, double> prob(Shp(1, ext_param_.class_count_), buffer);
     LabelType          d;
-    predictProbabilities(features, garbage_prediction_, stop);
-    ext_param_.to_classlabel(argMax(garbage_prediction_), d);
+    predictProbabilities(features, prob, stop);
+    ext_param_.to_classlabel(argMax(prob), d);
     return d;
 }
 
 
+template <class LabelType, class Tag>
+template <class U, class C1, class T, class C2, class Stop>
+void RandomForest<LabelType, Tag>
+    ::predictLabels(MultiArrayView<2, U, C1>const & features,
+                    MultiArrayView<2, T, C2> &      labels,
+                    Stop                     &      stop) const
+{
+    vigra_precondition(features.shape(0) == labels.shape(0),
+        "RandomForest::predictLabels(): Label array has wrong size.");
+    typedef MultiArrayShape<2>::type Shp;
+    // classify blocks of rows at once, so that compiled forests can
+    // use the tiled traversal of predictProbabilitiesBlocked()
+    static const int blockSize = 64;
+    int rows    = rowCount(features),
+        columns = columnCount(features),
+        classes = ext_param_.class_count_;
+    MultiArray<2, double> prob(Shp(std::min(rows, blockSize), classes));
+    for(int begin = 0; begin < rows; begin += blockSize)
+    {
+        int end = std::min(begin + blockSize, rows);
+        MultiArrayView<2, double> blockProb = 
+            prob.subarray(Shp(0, 0), Shp(end - begin, classes));
+        predictProbabilities(features.subarray(Shp(begin, 0), Shp(end, columns)),
+                             blockProb, stop);
+        for(int k=begin; k<end; ++k)
+        {
+            LabelType d;
+            ext_param_.to_classlabel(argMax(rowVector(blockProb, k - begin)), d);
+            labels(k, 0) = detail::RequiresExplicitCast<T>::cast(d);
+        }
+    }
+}
+
+
 //Same thing as above with priors for each label !!!
 template <class LabelType, class PreprocessorTag>
 template <class U, class C>
@@ -1218,8 +1716,27 @@ void RandomForest<LabelType, PreprocessorTag>
                            tree_indices_.end()); 
     }
     */
+    predictProbabilitiesImpl(features, prob, stop, 0, rowCount(features));
+}
+
+template <class LabelType, class PreprocessorTag>
+template <class U, class C1, class T, class C2, class Stop_t>
+void RandomForest<LabelType, PreprocessorTag>
+    ::predictProbabilitiesImpl(MultiArrayView<2, U, C1>const &  features,
+                               MultiArrayView<2, T, C2> &       prob,
+                               Stop_t                   &       stop,
+                               int begin, int end) const
+{
+    // the tiled traversal only pays off for several rows
+    if(is_compiled() && detail::RFPredictionStopIsTrivial<Stop_t>::value &&
+       end - begin >= 8)
+    {
+        predictProbabilitiesBlocked(features, prob, begin, end);
+        return;
+    }
+
     //Classify for each row.
-    for(int row=0; row < rowCount(features); ++row)
+    for(int row=begin; row < end; ++row)
     {
         ArrayVector<double>::const_iterator weights;
 
@@ -1230,7 +1747,7 @@ void RandomForest<LabelType, PreprocessorTag>
         for(int k=0; k<options_.tree_count_; ++k)
         {
             //get weights predicted by single tree
-            weights = trees_[k /*tree_indices_[k]*/].predict(rowVector(features, row));
+            weights = predictTree(k /*tree_indices_[k]*/, rowVector(features, row));
 
             //update votecount.
             int weighted = options_.predict_weighted_;
@@ -1260,6 +1777,252 @@ void RandomForest<LabelType, PreprocessorTag>
 
 }
 
+template <class LabelType, class PreprocessorTag>
+template <class U, class C1, class T, class C2>
+void RandomForest<LabelType, PreprocessorTag>
+    ::predictProbabilitiesBlocked(MultiArrayView<2, U, C1>const &  features,
+                                  MultiArrayView<2, T, C2> &       prob,
+                                  int begin, int end) const
+{
+    // float features are processed in single precision throughout
+    typedef typename detail::CompiledThresholdType<U>::type Real;
+    typedef detail::CompiledDecisionTree::PackedNodeT<Real> PackedNode;
+    enum { MaxTileSize = 64, StackTileBufferSize = 2048 };
+
+    int columns = ext_param_.column_count_,
+        classes = ext_param_.class_count_,
+        weighted = options_.predict_weighted_,
+        tileSize = std::min((int)MaxTileSize, end - begin);
+
+    // the scratch space lives on the stack unless there are very many
+    // feature columns (see predictLabel())
+    double              totalWeight[MaxTileSize];
+    Int32               leaf[MaxTileSize];
+    Real                stackTile[StackTileBufferSize];
+    ArrayVector<Real>   heapTile;
+    Real * tile = stackTile;
+    if(columns*tileSize > StackTileBufferSize)
+    {
+        heapTile.resize(columns*tileSize);
+        tile = heapTile.data();
+    }
+
+    for(int tileBegin = begin; tileBegin < end; tileBegin += tileSize)
+    {
+        int rows = std::min(tileSize, end - tileBegin);
+
+        // column-major copy, so that the threshold tests of 
+        // neighboring rows read neighboring memory
+        for(int c=0; c<columns; ++c)
+            for(int j=0; j<rows; ++j)
+                tile[c*tileSize + j] = features(tileBegin+j, c);
+        std::fill(totalWeight, totalWeight + rows, 0.0);
+
+        for(int k=0; k<options_.tree_count_; ++k)
+        {
+            PackedNode const * nodes = compiled_trees_[k].nodes(Real());
+
+            // advance all rows by one tree level per sweep - the rows 
+            // are independent, so that their memory accesses overlap
+            std::fill(leaf, leaf + rows, 0);
+            for(bool active = true; active; )
+            {
+                active = false;
+                for(int j=0; j<rows; ++j)
+                {
+                    PackedNode const & node = nodes[leaf[j]];
+                    if(node.column >= 0)
+                    {
+                        leaf[j] = node.child + 
+                                  ((tile[node.column*tileSize + j] < node.threshold) ? 0 : 1);
+                        active = true;
+                    }
+                }
+            }
+
+            // update votecount in the same order as predictProbabilitiesImpl()
+            for(int j=0; j<rows; ++j)
+            {
+                ArrayVector<double>::const_iterator weights = 
+                    compiled_trees_[k].weights_.begin() + nodes[leaf[j]].child;
+                for(int l=0; l<classes; ++l)
+                {
+                    double cur_w = weights[l] * (weighted * (*(weights-1))
+                                               + (1-weighted));
+                    prob(tileBegin+j, l) += (T)cur_w;
+                    totalWeight[j] += cur_w;
+                }
+            }
+        }
+
+        for(int j=0; j<rows; ++j)
+            for(int l=0; l<classes; ++l)
+                prob(tileBegin+j, l) /= detail::RequiresExplicitCast<T>::cast(totalWeight[j]);
+    }
+}
+
+namespace detail
+{
+
+template <class RF, class Features, class Prob, class Stop>
+struct RFPredictProbabilitiesFunctor
+{
+    RF const * rf;
+    Features const * features;
+    Prob * prob;
+    ArrayVector<Stop> * stops;
+    int chunkSize, rowCount;
+
+    void operator()(int /* threadIndex */, std::ptrdiff_t chunk) const
+    {
+        int begin = chunk*chunkSize,
+            end   = std::min(begin + chunkSize, rowCount);
+        rf->predictProbabilitiesImpl(*features, *prob, (*stops)[chunk], begin, end);
+    }
+};
+
+template <class RF, class Features, class Labels, class Stop>
+struct RFPredictLabelsFunctor
+{
+    typedef MultiArrayShape<2>::type Shp;
+    typedef typename Labels::value_type T;
+
+    RF const * rf;
+    Features const * features;
+    Labels * labels;
+    ArrayVector<Stop> * stops;
+    int chunkSize, rowCount;
+
+    void operator()(int /* threadIndex */, std::ptrdiff_t chunk) const
+    {
+        int begin = chunk*chunkSize,
+            end   = std::min(begin + chunkSize, rowCount);
+        // each thread uses its own probability buffer
+        MultiArray<2, double> prob(Shp(end - begin, rf->ext_param_.class_count_), 0.0);
+        rf->predictProbabilitiesImpl(features->subarray(Shp(begin, 0), Shp(end, columnCount(*features))),
+                                     prob, (*stops)[chunk], 0, end - begin);
+        for(int k=begin; k<end; ++k)
+        {
+            typename RF::LabelT d;
+            rf->ext_param_.to_classlabel(argMax(rowVector(prob, k - begin)), d);
+            (*labels)(k, 0) = detail::RequiresExplicitCast<T>::cast(d);
+        }
+    }
+};
+
+    // split the rows into about four chunks per thread for load balancing
+inline int rfPredictionChunkSize(int rowCount, int threadCount)
+{
+    int chunkCount = std::max(1, std::min(rowCount, 4*threadCount));
+    return (rowCount + chunkCount - 1) / chunkCount;
+}
+
+} // namespace detail
+
+template <class LabelType, class PreprocessorTag>
+template <class U, class C1, class T, class C2, class Stop_t>
+void RandomForest<LabelType, PreprocessorTag>
+    ::predictProbabilities(MultiArrayView<2, U, C1>const &  features,
+                           MultiArrayView<2, T, C2> &       prob,
+                           Stop_t                   &       stop_,
+                           ParallelOptions const    &       options) const
+{
+    vigra_precondition(rowCount(features) == rowCount(prob),
+      "RandomForestn::predictProbabilities():"
+        " Feature matrix and probability matrix size mismatch.");
+    vigra_precondition( columnCount(features) >= ext_param_.column_count_,
+      "RandomForestn::predictProbabilities():"
+        " Too few columns in feature matrix.");
+    vigra_precondition( columnCount(prob)
+                        == (MultiArrayIndex)ext_param_.class_count_,
+      "RandomForestn::predictProbabilities():"
+      " Probability matrix must have as many columns as there are classes.");
+
+    int rows = rowCount(features);
+    if(options.getActualNumThreads() <= 1 || rows <= 1)
+    {
+        predictProbabilities(features, prob, stop_);
+        return;
+    }
+
+    #define RF_CHOOSER(type_) detail::Value_Chooser<type_, Default_##type_> 
+    Default_Stop_t default_stop(options_);
+    typename RF_CHOOSER(Stop_t)::type & stop
+            = RF_CHOOSER(Stop_t)::choose(stop_, default_stop); 
+    typedef typename RF_CHOOSER(Stop_t)::type Stop;
+    #undef RF_CHOOSER 
+    stop.set_external_parameters(ext_param_, tree_count());
+    prob.init(NumericTraits<T>::zero());
+
+    int chunkSize  = detail::rfPredictionChunkSize(rows, options.getActualNumThreads()),
+        chunkCount = (rows + chunkSize - 1) / chunkSize;
+    ArrayVector<Stop> stops(chunkCount, stop);
+    for(int k=0; k<chunkCount; ++k)
+        stops[k].reset_statistics();
+
+    detail::RFPredictProbabilitiesFunctor<RandomForest, MultiArrayView<2, U, C1>,
+                                          MultiArrayView<2, T, C2>, Stop> f;
+    f.rf = this;
+    f.features = &features;
+    f.prob = &prob;
+    f.stops = &stops;
+    f.chunkSize = chunkSize;
+    f.rowCount = rows;
+    parallel_foreach(options, chunkCount, f);
+
+    for(int k=0; k<chunkCount; ++k)
+        stop.merge(stops[k]);
+}
+
+template <class LabelType, class PreprocessorTag>
+template <class U, class C1, class T, class C2, class Stop_t>
+void RandomForest<LabelType, PreprocessorTag>
+    ::predictLabels(MultiArrayView<2, U, C1>const & features,
+                    MultiArrayView<2, T, C2> &      labels,
+                    Stop_t                   &      stop_,
+                    ParallelOptions const    &      options) const
+{
+    vigra_precondition(features.shape(0) == labels.shape(0),
+        "RandomForest::predictLabels(): Label array has wrong size.");
+    vigra_precondition(columnCount(features) >= ext_param_.column_count_,
+        "RandomForestn::predictLabels():"
+            " Too few columns in feature matrix.");
+
+    int rows = rowCount(features);
+    if(options.getActualNumThreads() <= 1 || rows <= 1)
+    {
+        predictLabels(features, labels, stop_);
+        return;
+    }
+
+    #define RF_CHOOSER(type_) detail::Value_Chooser<type_, Default_##type_> 
+    Default_Stop_t default_stop(options_);
+    typename RF_CHOOSER(Stop_t)::type & stop
+            = RF_CHOOSER(Stop_t)::choose(stop_, default_stop); 
+    typedef typename RF_CHOOSER(Stop_t)::type Stop;
+    #undef RF_CHOOSER 
+    stop.set_external_parameters(ext_param_, tree_count());
+
+    int chunkSize  = detail::rfPredictionChunkSize(rows, options.getActualNumThreads()),
+        chunkCount = (rows + chunkSize - 1) / chunkSize;
+    ArrayVector<Stop> stops(chunkCount, stop);
+    for(int k=0; k<chunkCount; ++k)
+        stops[k].reset_statistics();
+
+    detail::RFPredictLabelsFunctor<RandomForest, MultiArrayView<2, U, C1>,
+                                   MultiArrayView<2, T, C2>, Stop> f;
+    f.rf = this;
+    f.features = &features;
+    f.labels = &labels;
+    f.stops = &stops;
+    f.chunkSize = chunkSize;
+    f.rowCount = rows;
+    parallel_foreach(options, chunkCount, f);
+
+    for(int k=0; k<chunkCount; ++k)
+        stop.merge(stops[k]);
+}
+
 template <class LabelType, class PreprocessorTag>
 template <class U, class C1, class T, class C2>
 void RandomForest<LabelType, PreprocessorTag>
@@ -1305,7 +2068,7 @@ void RandomForest<LabelType, PreprocessorTag>
         for(int k=0; k<options_.tree_count_; ++k)
         {
             //get weights predicted by single tree
-            weights = trees_[k /*tree_indices_[k]*/].predict(rowVector(features, row));
+            weights = predictTree(k /*tree_indices_[k]*/, rowVector(features, row));
 
             //update votecount.
             int weighted = options_.predict_weighted_;
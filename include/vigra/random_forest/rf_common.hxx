@@ -904,6 +904,12 @@ class EarlyStoppStd
     {
         return false; 
     }
+
+    void reset_statistics()
+    {}
+
+    void merge(EarlyStoppStd const &)
+    {}
 };
 
 
@@ -39,6 +39,8 @@
 #include <algorithm>
 #include <map>
 #include <numeric>
+#include <limits>
+#include <cmath>
 #include "vigra/multi_array.hxx"
 #include "vigra/mathutil.hxx"
 #include "vigra/array_vector.hxx"
@@ -471,6 +473,195 @@ void DecisionTree::continueLearn(   MultiArrayView<2, U, C> const       & featur
     }
 }
 
+/** threshold type of the packed nodes that are used for a given
+ * feature type: float features are compared against float thresholds
+ * (see CompiledDecisionTree), all other types against double.
+ */
+template <class U>
+struct CompiledThresholdType
+{
+    typedef double type;
+};
+
+template <>
+struct CompiledThresholdType<float>
+{
+    typedef float type;
+};
+
+/** smallest float that is not less than the double threshold t.
+ * For all finite float features x, (x < t) == (x < roundThresholdUp(t)), 
+ * so that a tree with rounded thresholds makes exactly the same decisions 
+ * for float features as the original tree.
+ */
+inline float roundThresholdUp(double t)
+{
+    if(t > NumericTraits<float>::max())
+        return std::numeric_limits<float>::infinity();
+    if(t <= -NumericTraits<float>::max())
+        return -NumericTraits<float>::max();
+    float f = static_cast<float>(t);
+    if(f < t)
+        f = nextafterf(f, std::numeric_limits<float>::infinity());
+    return f;
+}
+
+/** inference-only representation of a DecisionTree.
+ *
+ * The nodes of the original tree are stored in two separate arrays
+ * (topology_ and parameters_) and decoded via the node proxies, which 
+ * costs several dependent loads per split. This class packs each node 
+ * of a tree consisting of threshold nodes and constant probability 
+ * leaves into a single struct. The nodes are stored in breadth-first 
+ * order, so that the two children of a node are adjacent in memory 
+ * and the top levels of the tree share a few cache lines. 
+ *
+ * A second copy of the nodes with single precision thresholds 
+ * (float_nodes_) is used when the features are float. It is smaller 
+ * and gives bit-identical predictions (see roundThresholdUp()).
+ *
+ * The leaf probabilities are stored like in the original tree, i.e.
+ * predict() returns an iterator to the class probabilities, preceded
+ * by the weight of the leaf.
+ *
+ * \sa RandomForest::compile()
+ */
+class CompiledDecisionTree
+{
+  public:
+    typedef Int32 TreeInt;
+
+    /** packed node. Leaf nodes have column == -1, and child is the offset
+     * of their class probabilities in weights_. For interior nodes, the
+     * left child is at index child and the right child at child+1.
+     */
+    template <class Real>
+    struct PackedNodeT
+    {
+        Real    threshold;
+        TreeInt column;
+        TreeInt child;
+    };
+
+    typedef PackedNodeT<double> PackedNode;
+    typedef PackedNodeT<float>  FloatPackedNode;
+
+    ArrayVector<PackedNode>      nodes_;
+    ArrayVector<FloatPackedNode> float_nodes_;
+    ArrayVector<double>          weights_;
+    unsigned int                 classCount_;
+
+    CompiledDecisionTree()
+    : classCount_(0)
+    {}
+
+    /** convert a learned tree. Returns false (and leaves the object
+     * empty) if the tree contains node types other than threshold nodes
+     * and constant probability leaves.
+     */
+    bool compile(DecisionTree const & tree)
+    {
+        nodes_.clear();
+        float_nodes_.clear();
+        weights_.clear();
+        classCount_ = tree.classCount_;
+        if(tree.topology_.size() <= 2)
+            return false;
+
+        // original node indices in breadth-first order
+        ArrayVector<TreeInt> order(1, 2);
+        nodes_.reserve(tree.topology_.size() / 5);
+        for(unsigned int k = 0; k < order.size(); ++k)
+        {
+            TreeInt index = order[k];
+            PackedNode node;
+            switch(tree.topology_[index])
+            {
+                case i_ThresholdNode:
+                {
+                    Node<i_ThresholdNode> n(tree.topology_, tree.parameters_, index);
+                    node.threshold = n.threshold();
+                    node.column    = n.column();
+                    node.child     = order.size();
+                    order.push_back(n.child(0));
+                    order.push_back(n.child(1));
+                    break;
+                }
+                case e_ConstProbNode:
+                {
+                    Node<e_ConstProbNode> n(tree.topology_, tree.parameters_, index);
+                    node.threshold = 0.0;
+                    node.column    = -1;
+                    node.child     = weights_.size() + 1;
+                    weights_.push_back(n.weights());
+                    weights_.insert(weights_.end(), n.prob_begin(), n.prob_end());
+                    break;
+                }
+                default:
+                    nodes_.clear();
+                    weights_.clear();
+                    return false;
+            }
+            nodes_.push_back(node);
+        }
+
+        float_nodes_.resize(nodes_.size());
+        for(unsigned int k = 0; k < nodes_.size(); ++k)
+        {
+            float_nodes_[k].threshold = roundThresholdUp(nodes_[k].threshold);
+            float_nodes_[k].column    = nodes_[k].column;
+            float_nodes_[k].child     = nodes_[k].child;
+        }
+        return true;
+    }
+
+    /** is a tree available? */
+    bool empty() const
+    {
+        return nodes_.size() == 0;
+    }
+
+    /** the packed nodes to be used with features of type U (the 
+     * argument only selects the overload).
+     */
+    PackedNode const * nodes(double) const
+    {
+        return nodes_.data();
+    }
+
+    FloatPackedNode const * nodes(float) const
+    {
+        return float_nodes_.data();
+    }
+
+    /** traverse the tree with a single row of features. Returns an
+     * iterator to the class probabilities of the leaf, which is 
+     * preceded by the leaf weight (see DecisionTree::predict()).
+     */
+    template <class U, class C>
+    ArrayVector<double>::const_iterator
+    predict(MultiArrayView<2, U, C> const & features) const
+    {
+        typedef typename CompiledThresholdType<U>::type Real;
+        PackedNodeT<Real> const * nodes = this->nodes(Real());
+        TreeInt index = 0;
+        while(nodes[index].column >= 0)
+        {
+            PackedNodeT<Real> const & node = nodes[index];
+            // same comparison as Node<i_ThresholdNode>::next()
+            index = node.child + ((features(0, node.column) < node.threshold) ? 0 : 1);
+        }
+        return weights_.begin() + nodes[index].child;
+    }
+
+    template <class U, class C>
+    Int32 predictLabel(MultiArrayView<2, U, C> const & features) const
+    {
+        ArrayVector<double>::const_iterator weights = predict(features);
+        return argMax(weights, weights+classCount_) - weights;
+    }
+};
+
 } //namespace detail
 
 } //namespace vigra
@@ -30,6 +30,11 @@ protected:
     bool is_weighted_;
 
 public:
+    /** relative number of trees used for each prediction that stopped 
+     *  early or used all trees (filled by the derived criteria)
+     */
+    ArrayVector<double> depths;
+
     template<class T>
     void set_external_parameters(ProblemSpec<T> const  &prob, int tree_count = 0, bool is_weighted = false)
     {
@@ -37,6 +42,24 @@ public:
         is_weighted_ = is_weighted;
         tree_count_ = tree_count;
     }
+
+	/** clear the statistics gathered during prediction. Called by the parallel 
+	 * prediction functions on the copies of the criterion that process
+	 * chunks of rows. 
+	 */
+    void reset_statistics()
+    {
+        depths.clear();
+    }
+
+	/** append the statistics gathered by \a other. The parallel prediction
+	 * functions merge the copies in row order, so that the result is 
+	 * the same as after serial prediction.
+	 */
+    void merge(StopBase const & other)
+    {
+        depths.insert(depths.end(), other.depths.begin(), other.depths.end());
+    }
     
 	/** called after the prediction of a tree was added to the total prediction
 	 * \param WeightIter Iterator to the weights delivered by current tree.
@@ -59,7 +82,6 @@ public:
     int max_tree_;
     typedef StopBase SB;
     
-    ArrayVector<double> depths;
     
 	/** Constructor
 	 * \param max_tree number of trees to be used for prediction
@@ -101,7 +123,6 @@ class StopAfterVoteCount : public StopBase
 public:
     double proportion_;
     typedef StopBase SB;
-    ArrayVector<double> depths;
 
 	/** Constructor
 	 * \param proportion specify proportion to be used.
@@ -152,7 +173,6 @@ public:
     int num_;
     MultiArray<2, double> last_;
     MultiArray<2, double> cur_;
-    ArrayVector<double> depths;
     typedef StopBase SB;
 
 	/** Constructor
@@ -217,7 +237,6 @@ class StopIfMargin : public StopBase
 public:
     double proportion_;
     typedef StopBase SB;
-    ArrayVector<double> depths;
 
 	/** Constructor
 	 * \param proportion specify proportion to be used.
@@ -289,7 +308,6 @@ public:
 	
 	/**ArrayVector that will contain the fraction of trees that was visited before terminating
 	 */
-    ArrayVector<double> depths;
 
     double binomial(int N, int k, double p)
     {
@@ -369,7 +387,6 @@ public:
     typedef StopBase SB;
 	/**ArrayVector that will contain the fraction of trees that was visited before terminating
 	 */
-    ArrayVector<double> depths;
 
     double binomial(int N, int k, double p)
     {
@@ -171,9 +171,11 @@ class DT_StackEntry
         rightParent(rp),
         classCounts_(classCount, 0u),
         classCountsIsValid(false),
+        weightedClassCountsIsValid(false),
         begin_(i),
         end_(e),
-        size_(e-i)
+        size_(e-i),
+        oob_size_(0)
     {}
 
     
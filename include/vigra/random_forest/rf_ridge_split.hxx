@@ -157,7 +157,7 @@ class RidgeSplit: public SplitBase<Tag>
         region_gini_ = GiniCriterion::impurity(region.classCounts(),
                 region.size());
         if(region_gini_ == 0 || region.size() < SB::ext_param_.actual_mtry_ || region.oob_size() < 2)
-            return  makeTerminalNode(features, multiClassLabels, region, randint);
+            return  this->makeTerminalNode(features, multiClassLabels, region, randint);
 
         // select columns  to be tried.
     for(int ii = 0; ii < SB::ext_param_.actual_mtry_; ++ii)
@@ -226,7 +226,6 @@ class RidgeSplit: public SplitBase<Tag>
     
     
 //select submatrix of features for regression calculation
-    MultiArrayView<2, T, C> cVector;
     MultiArray<2, T> xtrain(fShape(region.size(),SB::ext_param_.actual_mtry_));
     //we only want -1 and 1 for this
     MultiArray<2, double> regrLabels(dShape(region.size(),1));
@@ -236,7 +235,8 @@ class RidgeSplit: public SplitBase<Tag>
     MultiArray<2, double> stdMatrix(dShape(SB::ext_param_.actual_mtry_,1));
     for(int m=0; m<SB::ext_param_.actual_mtry_; m++)
     {
-        cVector=columnVector(features, splitColumns[m]);
+        // construct a new view (assignment to a bound view would copy the data)
+        MultiArrayView<2, T, C> cVector(columnVector(features, splitColumns[m]));
         
         //centre and scale the data
         double dCurrFeatureColumnMean=0.0;
@@ -394,7 +394,7 @@ class RidgeSplit: public SplitBase<Tag>
     
         // did not find any suitable split
     if(closeAtTolerance(bgfunc.min_gini_, NumericTraits<double>::max()))
-        return  makeTerminalNode(features, multiClassLabels, region, randint);
+        return  this->makeTerminalNode(features, multiClassLabels, region, randint);
     
     //take gini threshold here due to scaling, normalisation, etc. of the coefficients
     node.intercept()	= bgfunc.min_threshold_;
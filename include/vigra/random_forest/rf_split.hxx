@@ -44,6 +44,9 @@
 #include "../sized_int.hxx"
 #include "../matrix.hxx"
 #include "../random.hxx"
+#ifdef VIGRA_HAS_STD_THREADS
+# include <memory>
+#endif
 #include "../functorexpression.hxx"
 #include "rf_nodeproxy.hxx"
 //#include "rf_sampling.hxx"
@@ -1057,7 +1060,7 @@ class ThresholdSplit: public SplitBase<Tag>
                                              region.end(),
                                              region.classCounts());
         if(region_gini_ <= SB::ext_param_.precision_)
-            return  makeTerminalNode(features, labels, region, randint);
+            return  this->makeTerminalNode(features, labels, region, randint);
 
         // select columns  to be tried.
         for(int ii = 0; ii < SB::ext_param_.actual_mtry_; ++ii)
@@ -1098,7 +1101,7 @@ class ThresholdSplit: public SplitBase<Tag>
         //std::cerr << current_min_gini << "curr " << region_gini_ << std::endl;
         // did not find any suitable split
         if(closeAtTolerance(current_min_gini, region_gini_))
-            return  makeTerminalNode(features, labels, region, randint);
+            return  this->makeTerminalNode(features, labels, region, randint);
         
         //create a Node for output
         Node<i_ThresholdNode>   node(SB::t_data, SB::p_data);
@@ -1370,9 +1373,354 @@ public:
 };
 
 typedef  ThresholdSplit<RandomSplitOfColumn> RandomSplit;
+
+    // the binning of the features, shared by the copies of a HistogramSplit
+struct HistogramBins
+{
+    // bin index of each sample (row) in each feature (column)
+    MultiArray<2, UInt8>        bins_;
+    // cuts_(k, c) is the upper boundary of bin k in column c, i.e.
+    // a feature value x is in bin k iff cuts_(k-1, c) <= x < cuts_(k, c)
+    MultiArray<2, double>       cuts_;
+    ArrayVector<Int32>          cut_counts_;
+};
+
+#ifdef VIGRA_HAS_STD_THREADS
+
+typedef std::shared_ptr<HistogramBins const> HistogramBinsPointer;
+
+#else
+
+    // without threads, the copies are never released concurrently, 
+    // so that a plain reference count suffices
+class HistogramBinsPointer
+{
+    HistogramBins const * bins_;
+    int * count_;
+
+  public:
+    HistogramBinsPointer()
+    : bins_(0), count_(0)
+    {}
+
+    explicit HistogramBinsPointer(HistogramBins const * bins)
+    : bins_(bins), count_(new int(1))
+    {}
+
+    HistogramBinsPointer(HistogramBinsPointer const & other)
+    : bins_(other.bins_), count_(other.count_)
+    {
+        if(count_)
+            ++*count_;
+    }
+
+    ~HistogramBinsPointer()
+    {
+        if(count_ && --*count_ == 0)
+        {
+            delete bins_;
+            delete count_;
+        }
+    }
+
+    HistogramBinsPointer & operator=(HistogramBinsPointer const & other)
+    {
+        HistogramBinsPointer tmp(other);
+        std::swap(bins_, tmp.bins_);
+        std::swap(count_, tmp.count_);
+        return *this;
+    }
+
+    HistogramBins const * get() const
+    {
+        return bins_;
+    }
+
+    HistogramBins const * operator->() const
+    {
+        return bins_;
+    }
+
+    HistogramBins const & operator*() const
+    {
+        return *bins_;
+    }
+};
+
+#endif
+
+/** Split functor that searches splits on quantile-binned features.
+ *
+ * ThresholdSplit<BestGiniOfColumn<...> > sorts the samples of the 
+ * current region along every candidate column, i.e. training costs 
+ * O(n log n) per node and tried column. This functor instead assigns 
+ * each feature value to one of at most binCount quantile bins once 
+ * before training (see bin()). At each node, a class histogram per bin is
+ * accumulated in a single pass over the region, and the best split is 
+ * found by sweeping over the bins. Training thus becomes linear in 
+ * the number of samples, at the price of restricting the thresholds 
+ * to the bin boundaries. If a column has at most binCount distinct 
+ * values, all candidate thresholds of the exact search are retained.
+ *
+ * The binning is computed by RandomForest::learn() before any tree 
+ * is learned. Copies of the functor, e.g. the one made for each tree, 
+ * share the binning of the functor they were copied from instead of 
+ * duplicating it. The binning is reference counted, so that each copy
+ * remains valid on its own, and bin() replaces it only in the functor
+ * it is called on. Only classification is supported. The Impurity 
+ * template parameter can be GiniCriterion (default) or EntropyCriterion.
+ *
+ * \code
+ * rf::split::HistogramGiniSplit split(256);
+ * rf.learn(features, labels, rf_default(), split);
+ * \endcode
+ */
+template <class Impurity = GiniCriterion>
+class HistogramSplit: public SplitBase<ClassificationTag>
+{
+  public:
+    typedef SplitBase<ClassificationTag> SB;
+
+    int                         bin_count_;
+    // the binning, shared with the copies (null if not yet binned)
+    HistogramBinsPointer binned_;
+
+    ArrayVector<Int32>          splitColumns;
+    ArrayVector<double>         histogram_;
+    ArrayVector<double>         left_, right_;
+    ArrayVector<double>         bestCounts_[2];
+
+    double                      region_gini_;
+    double                      min_gini_;
+    int                         best_column_;
+    double                      best_threshold_;
+
+    /** \param binCount maximal number of bins per feature 
+     *                  (between 2 and 256)
+     */
+    HistogramSplit(int binCount = 256)
+    : bin_count_(binCount),
+      region_gini_(0.0),
+      min_gini_(0.0),
+      best_column_(0),
+      best_threshold_(0.0)
+    {
+        vigra_precondition(binCount >= 2 && binCount <= 256,
+            "HistogramSplit(): binCount must be between 2 and 256.");
+    }
+
+    double minGini() const
+    {
+        return min_gini_;
+    }
+    int bestSplitColumn() const
+    {
+        return best_column_;
+    }
+    double bestSplitThreshold() const
+    {
+        return best_threshold_;
+    }
+
+    template<class T>
+    void set_external_parameters(ProblemSpec<T> const & in)
+    {
+        SB::set_external_parameters(in);
+        int featureCount = SB::ext_param_.column_count_,
+            classCount   = SB::ext_param_.class_count_;
+        splitColumns.resize(featureCount);
+        for(int k=0; k<featureCount; ++k)
+            splitColumns[k] = k;
+        left_.resize(classCount);
+        right_.resize(classCount);
+        bestCounts_[0].resize(classCount);
+        bestCounts_[1].resize(classCount);
+        histogram_.resize(bin_count_*classCount);
+    }
+
+    /** determine the bins of each feature and the bin index of each 
+     *  sample. 
+     */
+    template<class T, class C>
+    void bin(MultiArrayView<2, T, C> const & features)
+    {
+        typedef MultiArrayShape<2>::type Shp;
+        int rows = features.shape(0),
+            columns = features.shape(1);
+        // copies keep the previous binning
+        HistogramBins * binned = new HistogramBins;
+        HistogramBinsPointer pointer(binned);
+        binned->bins_.reshape(Shp(rows, columns));
+        binned->cuts_.reshape(Shp(bin_count_ - 1, columns));
+        binned->cut_counts_.resize(columns);
+
+        ArrayVector<double> values(rows);
+        for(int c=0; c<columns; ++c)
+        {
+            for(int k=0; k<rows; ++k)
+                values[k] = features(k, c);
+            std::sort(values.begin(), values.end());
+
+            // place the cuts between distinct values at the quantiles
+            int cutCount = 0;
+            for(int q=1; q<bin_count_ && rows > 0; ++q)
+            {
+                ArrayVector<double>::iterator v = 
+                    std::lower_bound(values.begin(), values.end(), 
+                                     values[(std::ptrdiff_t)q*rows/bin_count_]);
+                if(v == values.begin())
+                    continue;
+                double cut = (v[-1] + v[0]) / 2.0;
+                if(cutCount == 0 || binned->cuts_(cutCount-1, c) < cut)
+                    binned->cuts_(cutCount++, c) = cut;
+            }
+            // if there are few distinct values, use all of them
+            int distinct = std::unique(values.begin(), values.end()) - values.begin();
+            if(distinct <= bin_count_)
+            {
+                cutCount = distinct - 1;
+                for(int k=0; k<cutCount; ++k)
+                    binned->cuts_(k, c) = (values[k] + values[k+1]) / 2.0;
+            }
+            binned->cut_counts_[c] = cutCount;
+
+            double const * cuts = &binned->cuts_(0, c);
+            for(int k=0; k<rows; ++k)
+                binned->bins_(k, c) = (UInt8)(std::upper_bound(cuts, cuts + cutCount, 
+                                                               (double)features(k, c)) - cuts);
+        }
+        binned_ = pointer;
+    }
+
+    template<class T, class C, class T2, class C2, class Region, class Random>
+    int findBestSplit(MultiArrayView<2, T, C> features,
+                      MultiArrayView<2, T2, C2>  labels,
+                      Region & region,
+                      ArrayVector<Region>& childRegions,
+                      Random & randint)
+    {
+        typedef typename Region::IndexIterator IndexIterator;
+        if(binned_.get() == 0 || binned_->bins_.shape(0) != features.shape(0) || 
+                                 binned_->bins_.shape(1) != features.shape(1))
+            bin(features);
+        MultiArray<2, UInt8> const & bins = binned_->bins_;
+        ArrayVector<Int32> const & cutCounts = binned_->cut_counts_;
+
+        detail::Correction<ClassificationTag>::exec(region, labels);
+
+        int classCount = SB::ext_param_.class_count_;
+        ArrayVector<double> const & weights = SB::ext_param_.class_weights_;
+        double total = std::accumulate(region.classCounts().begin(),
+                                       region.classCounts().end(), 0.0);
+        region_gini_ = Impurity::impurity(region.classCounts(), weights, total);
+        if(region_gini_ <= SB::ext_param_.precision_)
+            return  this->makeTerminalNode(features, labels, region, randint);
+
+        // select columns  to be tried.
+        for(int ii = 0; ii < SB::ext_param_.actual_mtry_; ++ii)
+            std::swap(splitColumns[ii], 
+                      splitColumns[ii+ randint(features.shape(1) - ii)]);
+
+        double current_min_gini = region_gini_;
+        int    num2try          = features.shape(1);
+        for(int k=0; k<num2try; ++k)
+        {
+            int column   = splitColumns[k],
+                binCount = cutCounts[column] + 1;
+
+            // class histogram of each bin in the region
+            std::fill(histogram_.begin(), histogram_.begin() + binCount*classCount, 0.0);
+            for(IndexIterator i = region.begin(); i != region.end(); ++i)
+                histogram_[bins(*i, column)*classCount + (int)labels(*i, 0)] += 1.0;
+
+            // sweep the split position over the bins
+            std::fill(left_.begin(), left_.end(), 0.0);
+            std::copy(region.classCounts().begin(), region.classCounts().end(), 
+                      right_.begin());
+            double leftTotal = 0.0;
+            bool improved = false;
+            for(int b=0; b<binCount-1; ++b)
+            {
+                double binTotal = 0.0;
+                for(int l=0; l<classCount; ++l)
+                {
+                    double h = histogram_[b*classCount + l];
+                    left_[l]  += h;
+                    right_[l] -= h;
+                    binTotal  += h;
+                }
+                leftTotal += binTotal;
+                if(binTotal == 0.0 || leftTotal == 0.0 || leftTotal == total)
+                    continue;
+                double loss = Impurity::impurity(left_, weights, leftTotal) +
+                              Impurity::impurity(right_, weights, total - leftTotal);
+                if(loss < current_min_gini)
+                {
+                    current_min_gini = loss;
+                    best_column_     = column;
+                    best_threshold_  = binned_->cuts_(b, column);
+                    bestCounts_[0]   = left_;
+                    bestCounts_[1]   = right_;
+                    improved         = true;
+                }
+            }
+            if(improved)
+                num2try = SB::ext_param_.actual_mtry_;
+        }
+        // did not find any suitable split
+        if(closeAtTolerance(current_min_gini, region_gini_))
+            return  this->makeTerminalNode(features, labels, region, randint);
+        min_gini_ = current_min_gini;
+
+        //create a Node for output
+        Node<i_ThresholdNode>   node(SB::t_data, SB::p_data);
+        SB::node_ = node;
+        node.threshold()    = best_threshold_;
+        node.column()       = best_column_;
+
+        // partition the range according to the best dimension 
+        SortSamplesByDimensions<MultiArrayView<2, T, C> > 
+            sorter(features, node.column(), node.threshold());
+        IndexIterator bestSplit =
+            std::partition(region.begin(), region.end(), sorter);
+        childRegions[0].setRange(   region.begin()  , bestSplit       );
+        childRegions[0].classCounts() = bestCounts_[0];
+        childRegions[0].classCountsIsValid = true;
+        childRegions[0].rule = region.rule;
+        childRegions[0].rule.push_back(std::make_pair(1, 1.0));
+        childRegions[1].setRange(   bestSplit       , region.end()    );
+        childRegions[1].classCounts() = bestCounts_[1];
+        childRegions[1].classCountsIsValid = true;
+        childRegions[1].rule = region.rule;
+        childRegions[1].rule.push_back(std::make_pair(1, 1.0));
+
+        return i_ThresholdNode;
+    }
+};
+
+typedef HistogramSplit<GiniCriterion>      HistogramGiniSplit;
+typedef HistogramSplit<EntropyCriterion>   HistogramEntropySplit;
 }
 }
 
+namespace detail
+{
+
+    // give split functors the chance to preprocess the features 
+    // once before the trees are learned
+template <class Split, class T, class C>
+inline void prepareSplitFunctor(Split &, MultiArrayView<2, T, C> const &)
+{}
+
+template <class Impurity, class T, class C>
+inline void prepareSplitFunctor(rf::split::HistogramSplit<Impurity> & split, 
+                                MultiArrayView<2, T, C> const & features)
+{
+    split.bin(features);
+}
+
+} // namespace detail
+
 
 } //namespace vigra
 #endif // VIGRA_RANDOM_FOREST_SPLIT_HXX
@@ -273,6 +273,7 @@ bool rf_import_HDF5(RandomForest<T, Tag> & rf,
             detail::dt_import_HDF5(h5context, rf.trees_.back(), *j);
         }
     }
+    rf.compile();
     if (pathname.size())
         h5context.cd(cwd);
     return true;
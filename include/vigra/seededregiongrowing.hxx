@@ -44,6 +44,7 @@
 #include "stdimagefunctions.hxx"
 #include "pixelneighborhood.hxx"
 #include "bucket_queue.hxx"
+#include "memory.hxx"
 
 namespace vigra {
 
@@ -116,38 +117,23 @@ public:
         }
     };
 
+        // Candidate records are carved out of large blocks, so that the
+        // heap is only called once per Allocator::blockSize() records.
     struct Allocator
+    : public BlockAllocator<SeedRgPixel>
     {
-        ~Allocator()
-        {
-            while(!freelist_.empty())
-            {
-                delete freelist_.top();
-                freelist_.pop();
-            }
-        }
-
         SeedRgPixel *
         create(Point2D const & location, Point2D const & nearest,
                COST const & cost, int const & count, int const & label)
         {
-            if(!freelist_.empty())
-            {
-                SeedRgPixel * res = freelist_.top();
-                freelist_.pop();
-                res->set(location, nearest, cost, count, label);
-                return res;
-            }
-
-            return new SeedRgPixel(location, nearest, cost, count, label);
+            return new(this->allocate()) SeedRgPixel(location, nearest, cost, count, label);
         }
 
         void dismiss(SeedRgPixel * p)
         {
-            freelist_.push(p);
+            detail::destroy(p);
+            this->deallocate(p);
         }
-
-        std::stack<SeedRgPixel<COST> *> freelist_;
     };
 };
 
@@ -269,6 +255,9 @@ enum SRGType {
     \ref SeedRgDirectValueFunctor. With <tt>SRGType == KeepContours</tt>,
     this is equivalent to the watershed algorithm.
 
+    If <tt>allocatorStats</tt> is given, it receives the counters of the arena
+    that holds the candidate pixels (see \ref BlockAllocatorStatistics).
+
     <b> Declarations:</b>
 
     pass arguments explicitly:
@@ -285,7 +274,8 @@ enum SRGType {
                             RegionStatisticsArray & stats,
                             SRGType srgType = CompleteGrow,
                             Neighborhood neighborhood = FourNeighborCode(),
-                            double max_cost = NumericTraits<double>::max());
+                            double max_cost = NumericTraits<double>::max(),
+                            BlockAllocatorStatistics * allocatorStats = 0);
     }
     \endcode
 
@@ -303,7 +293,8 @@ enum SRGType {
                             RegionStatisticsArray & stats,
                             SRGType srgType = CompleteGrow,
                             Neighborhood neighborhood = FourNeighborCode(),
-                            double max_cost = NumericTraits<double>::max());
+                            double max_cost = NumericTraits<double>::max(),
+                            BlockAllocatorStatistics * allocatorStats = 0);
     }
     \endcode
 
@@ -383,7 +374,8 @@ seededRegionGrowing(SrcIterator srcul,
                     RegionStatisticsArray & stats,
                     SRGType srgType,
                     Neighborhood,
-                    double max_cost)
+                    double max_cost,
+                    BlockAllocatorStatistics * allocatorStats = 0)
 {
     int w = srclr.x - srcul.x;
     int h = srclr.y - srcul.y;
@@ -515,6 +507,8 @@ seededRegionGrowing(SrcIterator srcul,
         allocator.dismiss(pheap.top());
         pheap.pop();
     }
+    if(allocatorStats)
+        *allocatorStats = allocator.statistics();
 
     // write result
     transformImage(ir, ir+Point2D(w,h), regions.accessor(), destul, ad,
@@ -590,12 +584,13 @@ seededRegionGrowing(triple<SrcIterator, SrcIterator, SrcAccessor> img1,
                     RegionStatisticsArray & stats,
                     SRGType srgType, 
                     Neighborhood n,
-                    double max_cost)
+                    double max_cost,
+                    BlockAllocatorStatistics * allocatorStats = 0)
 {
     return seededRegionGrowing(img1.first, img1.second, img1.third,
                                 img3.first, img3.second,
                                 img4.first, img4.second,
-                                stats, srgType, n, max_cost);
+                                stats, srgType, n, max_cost, allocatorStats);
 }
 
 template <class SrcIterator, class SrcAccessor,
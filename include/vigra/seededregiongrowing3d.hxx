@@ -46,6 +46,8 @@
 #include "seededregiongrowing.hxx"
 #include "multi_pointoperators.hxx"
 #include "voxelneighborhood.hxx"
+#include "bucket_queue.hxx"
+#include "memory.hxx"
 
 namespace vigra {
 
@@ -126,40 +128,56 @@ public:
         }
     };
 
+        // Candidate records are carved out of large blocks, so that the
+        // heap is only called once per Allocator::blockSize() records.
     struct Allocator
+    : public BlockAllocator<SeedRgVoxel>
     {
-        ~Allocator()
-        {
-            while(!freelist_.empty())
-            {
-                delete freelist_.top();
-                freelist_.pop();
-            }
-        }
-
         SeedRgVoxel * create(Diff_type const & location, Diff_type const & nearest,
                              COST const & cost, int const & count, int const & label)
         {
-            if(!freelist_.empty())
-            {
-                SeedRgVoxel * res = freelist_.top();
-                freelist_.pop();
-                res->set(location, nearest, cost, count, label);
-                return res;
-            }
-
-            return new SeedRgVoxel(location, nearest, cost, count, label);
+            return new(this->allocate()) SeedRgVoxel(location, nearest, cost, count, label);
         }
 
         void dismiss(SeedRgVoxel * p)
         {
-            freelist_.push(p);
+            detail::destroy(p);
+            this->deallocate(p);
         }
-
-        std::stack<SeedRgVoxel<COST,Diff_type> *> freelist_;
     };
 };
 
+template <class Shape, class Label>
+struct SeedRgTurboCandidate
+{
+    Shape point_;
+    Label label_;
+
+    SeedRgTurboCandidate(Shape const & point, Label label)
+    : point_(point), label_(label)
+    {}
+};
+
+template <class Shape>
+inline bool 
+seedRgTurboAtBorder(Shape const & point, Shape const & shape)
+{
+    for(int k=0; k<Shape::static_size; ++k)
+        if(point[k] == 0 || point[k] == shape[k]-1)
+            return true;
+    return false;
+}
+
+template <class Cost>
+inline std::ptrdiff_t 
+seedRgTurboPriority(Cost const & cost, std::ptrdiff_t bucket_count)
+{
+    std::ptrdiff_t priority = (std::ptrdiff_t)cost;
+    vigra_precondition(0 <= priority && priority < bucket_count,
+        "fastSeededRegionGrowing(): cost outside of the range [0, bucket_count).");
+    return priority;
+}
+
 } // namespace detail
 
 /** \addtogroup SeededRegionGrowing
@@ -248,6 +266,9 @@ public:
     function returns its argument. This behavior is implemented by the
     \ref SeedRgDirectValueFunctor.
 
+    If <tt>allocatorStats</tt> is given, it receives the counters of the arena
+    that holds the candidate voxels (see \ref BlockAllocatorStatistics).
+
     <b> Declarations:</b>
 
     pass arguments explicitly:
@@ -264,7 +285,8 @@ public:
                               RegionStatisticsArray & stats, 
                               SRGType srgType = CompleteGrow,
                               Neighborhood neighborhood = NeighborCode3DSix(),
-                              double max_cost = NumericTraits<double>::max());
+                              double max_cost = NumericTraits<double>::max(),
+                              BlockAllocatorStatistics * allocatorStats = 0);
     }
     \endcode
 
@@ -282,7 +304,8 @@ public:
                               RegionStatisticsArray & stats, 
                               SRGType srgType = CompleteGrow,
                               Neighborhood neighborhood = NeighborCode3DSix(), 
-                              double max_cost = NumericTraits<double>::max());
+                              double max_cost = NumericTraits<double>::max(),
+                              BlockAllocatorStatistics * allocatorStats = 0);
     }
     \endcode
 
@@ -300,7 +323,8 @@ seededRegionGrowing3D(SrcImageIterator srcul, Diff_type shape, SrcAccessor as,
                       RegionStatisticsArray & stats, 
                       SRGType srgType,
                       Neighborhood,
-                      double max_cost)
+                      double max_cost,
+                      BlockAllocatorStatistics * allocatorStats = 0)
 {
     SrcImageIterator srclr = srcul + shape;
     //int w = srclr.x - srcul.x;
@@ -453,6 +477,8 @@ seededRegionGrowing3D(SrcImageIterator srcul, Diff_type shape, SrcAccessor as,
         allocator.dismiss(pheap.top());
         pheap.pop();
     }
+    if(allocatorStats)
+        *allocatorStats = allocator.statistics();
 
     // write result
     transformMultiArray(ir, Diff_type(w,h,d), AccessorTraits<int>::default_accessor(), 
@@ -510,12 +536,13 @@ seededRegionGrowing3D(triple<SrcImageIterator, Shape, SrcAccessor> img1,
                       pair<SeedImageIterator, SeedAccessor> img3,
                       pair<DestImageIterator, DestAccessor> img4,
                       RegionStatisticsArray & stats, 
-                      SRGType srgType, Neighborhood n, double max_cost)
+                      SRGType srgType, Neighborhood n, double max_cost,
+                      BlockAllocatorStatistics * allocatorStats = 0)
 {
     seededRegionGrowing3D(img1.first, img1.second, img1.third,
                           img3.first, img3.second,
                           img4.first, img4.second,
-                          stats, srgType, n, max_cost);
+                          stats, srgType, n, max_cost, allocatorStats);
 }
 
 template <class SrcImageIterator, class Shape, class SrcAccessor,
@@ -567,6 +594,188 @@ seededRegionGrowing3D(triple<SrcImageIterator, Shape, SrcAccessor> img1,
                           stats);
 }
 
+/********************************************************/
+/*                                                      */
+/*                fastSeededRegionGrowing               */
+/*                                                      */
+/********************************************************/
+
+/** \brief Multi-dimensional Seeded Region Growing for integer costs.
+
+    This is a faster variant of \ref seededRegionGrowing3D() for the common case
+    where the costs returned by the <TT>RegionStatisticsArray</TT> are integers in the 
+    range <tt>[0, bucket_count)</tt>, e.g. when a <tt>UInt8</tt> or <tt>UInt16</tt> 
+    boundary indicator is flooded with \ref SeedRgDirectValueFunctor to compute 
+    watersheds. It works on arrays of arbitrary dimension and replaces the 
+    heap of individually allocated candidates by a \ref vigra::BucketQueue.
+    The queue is ordered on two levels: candidates are sorted into buckets according
+    to their cost, and each bucket is processed in first-in first-out order.
+    A candidate is only assigned to a region when it leaves the queue, so that 
+    ties are resolved in favour of the nearest region (in the sense of a
+    breadth-first search), and <tt>KeepContours</tt> can be supported: 
+    when a candidate is adjacent to a different region at that time, it becomes 
+    part of the 1-voxel wide contour and remains unlabeled.
+    
+    The <tt>labels</tt> array contains the seeds on input (label 0 marks 
+    the candidates) and receives the segmentation on output. 
+    <tt>neighborhood</tt> can be <tt>DirectNeighborhood</tt> (the default) or 
+    <tt>IndirectNeighborhood</tt>. Costs are converted to <tt>std::ptrdiff_t</tt>
+    before they are put into the queue (i.e. fractional costs are truncated), and it is
+    an error when a cost falls outside of the range of buckets. The meaning of 
+    <tt>srgType</tt> and <tt>max_cost</tt> is the same as in \ref seededRegionGrowing3D().
+    The function returns the largest seed label.
+    
+    <b> Declaration:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class S1, class T2, class S2,
+                  class RegionStatisticsArray>
+        T2
+        fastSeededRegionGrowing(MultiArrayView<N, T1, S1> const & src,
+                                MultiArrayView<N, T2, S2> labels,
+                                RegionStatisticsArray & stats,
+                                SRGType srgType = CompleteGrow,
+                                NeighborhoodType neighborhood = DirectNeighborhood,
+                                double max_cost = NumericTraits<double>::max(),
+                                std::ptrdiff_t bucket_count = 256);
+    }
+    \endcode
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/seededregiongrowing3d.hxx\><br>
+    Namespace: vigra
+
+    \code
+    MultiArray<3, UInt16> boundaries(shape);
+    MultiArray<3, UInt32> labels(shape);
+    ... // compute boundary indicator and mark seeds with labels 1...max_region_label
+    
+    ArrayOfRegionStatistics<SeedRgDirectValueFunctor<UInt16> > stats(max_region_label);
+    
+    // watersheds with 1-voxel wide contours between the regions
+    fastSeededRegionGrowing(boundaries, labels, stats, KeepContours, 
+                            DirectNeighborhood, NumericTraits<double>::max(), 1 << 16);
+    \endcode
+*/
+template <unsigned int N, class T1, class S1, class T2, class S2,
+          class RegionStatisticsArray>
+T2
+fastSeededRegionGrowing(MultiArrayView<N, T1, S1> const & src,
+                        MultiArrayView<N, T2, S2> labels,
+                        RegionStatisticsArray & stats,
+                        SRGType srgType = CompleteGrow,
+                        NeighborhoodType neighborhood = DirectNeighborhood,
+                        double max_cost = NumericTraits<double>::max(),
+                        std::ptrdiff_t bucket_count = 256)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef typename MultiArrayView<N, T2, S2>::iterator LabelIterator;
+    typedef detail::SeedRgTurboCandidate<Shape, T2> Candidate;
+
+    vigra_precondition(src.shape() == labels.shape(),
+        "fastSeededRegionGrowing(): Shape mismatch between input and output.");
+
+    Shape shape = labels.shape();
+
+    ArrayVector<Shape> neighbors;
+    detail::makeNeighborhoodOffsets(neighborhood, neighbors);
+    int neighborCount = (int)neighbors.size();
+    
+    ArrayVector<MultiArrayIndex> srcOffsets(neighborCount), labelOffsets(neighborCount);
+    for(int k=0; k<neighborCount; ++k)
+    {
+        srcOffsets[k] = dot(neighbors[k], src.stride());
+        labelOffsets[k] = dot(neighbors[k], labels.stride());
+    }
+
+    T2 maxRegionLabel = 0;
+    LabelIterator i = labels.begin(), end = labels.end();
+    for(; i != end; ++i)
+        if(maxRegionLabel < *i)
+            maxRegionLabel = *i;
+    vigra_precondition(maxRegionLabel <= stats.maxRegionLabel(),
+        "fastSeededRegionGrowing(): Largest label exceeds size of RegionStatisticsArray.");
+
+    BucketQueue<Candidate, true> pqueue(bucket_count);
+
+    // find candidate voxels for growing and fill the queue
+    for(i = labels.begin(); i != end; ++i)
+    {
+        if(*i != 0)
+            continue;
+        
+        Shape const & point = i.point();
+        bool atBorder = detail::seedRgTurboAtBorder(point, shape);
+        T2 const * l = &*i;
+        
+        for(int k=0; k<neighborCount; ++k)
+        {
+            if(atBorder && !labels.isInside(point + neighbors[k]))
+                continue;
+            T2 label = l[labelOffsets[k]];
+            if(label != 0)
+                pqueue.push(Candidate(point, label), 
+                            detail::seedRgTurboPriority(stats[label].cost(src[point]), bucket_count));
+        }
+    }
+
+    // perform region growing
+    while(!pqueue.empty())
+    {
+        Candidate candidate = pqueue.top();
+        std::ptrdiff_t cost = pqueue.topPriority();
+        pqueue.pop();
+
+        if((srgType & StopAtThreshold) != 0 && cost > max_cost)
+            break;
+
+        Shape const & point = candidate.point_;
+        T2 * l = &labels[point];
+        if(*l != 0) // already labelled
+            continue;
+
+        T2 label = candidate.label_;
+        bool atBorder = detail::seedRgTurboAtBorder(point, shape);
+
+        if((srgType & KeepContours) != 0)
+        {
+            bool isContour = false;
+            for(int k=0; k<neighborCount; ++k)
+            {
+                if(atBorder && !labels.isInside(point + neighbors[k]))
+                    continue;
+                T2 nlabel = l[labelOffsets[k]];
+                if(nlabel != 0 && nlabel != label)
+                {
+                    isContour = true;
+                    break;
+                }
+            }
+            // contour voxels remain unlabeled and don't grow any further
+            if(isContour)
+                continue;
+        }
+
+        *l = label;
+
+        T1 const * s = &src[point];
+        stats[label](*s);
+
+        for(int k=0; k<neighborCount; ++k)
+        {
+            if(atBorder && !labels.isInside(point + neighbors[k]))
+                continue;
+            if(l[labelOffsets[k]] == 0)
+                pqueue.push(Candidate(point + neighbors[k], label), 
+                            detail::seedRgTurboPriority(stats[label].cost(s[srcOffsets[k]]), bucket_count));
+        }
+    }
+    
+    return maxRegionLabel;
+}
+
 } // namespace vigra
 
 #endif // VIGRA_SEEDEDREGIONGROWING_HXX
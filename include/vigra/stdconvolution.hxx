@@ -829,7 +829,7 @@ public:
               norm_(norm)
         {}
 
-        ~InitProxy()
+        ~InitProxy() VIGRA_DESTRUCTOR_MAY_THROW
         {
             vigra_precondition(count_ == 1 || count_ == sum_,
                                "Kernel2D::initExplicitly(): "
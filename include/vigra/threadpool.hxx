@@ -0,0 +1,439 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2011 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_THREADPOOL_HXX
+#define VIGRA_THREADPOOL_HXX
+
+#include "config.hxx"
+#include "error.hxx"
+#include <cstddef>
+#include <vector>
+
+#ifdef VIGRA_HAS_STD_THREADS
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <atomic>
+# include <functional>
+# include <exception>
+#endif
+
+namespace vigra {
+
+/** \addtogroup ParallelProcessing Parallel Processing
+
+    Infrastructure for the multi-threaded variants of VIGRA's algorithms.
+
+    Multi-threading requires a compiler that supports the C++11 thread library
+    (<tt>std::thread</tt>). Otherwise, or when the macro <tt>VIGRA_SINGLE_THREADED</tt>
+    is defined, all parallel functions silently fall back to sequential execution
+    in the calling thread. The results of VIGRA's parallel algorithms never depend
+    on the number of threads.
+*/
+//@{
+
+/********************************************************/
+/*                                                      */
+/*                   ParallelOptions                    */
+/*                                                      */
+/********************************************************/
+
+/** \brief Option object for parallel algorithms.
+
+    <b>\#include</b> \<vigra/threadpool.hxx\><br>
+    Namespace: vigra
+
+    \code
+    // use 8 threads
+    separableConvolveMultiArray(srcMultiArrayRange(src), destMultiArray(dest), kernel,
+                                ParallelOptions().numThreads(8));
+    \endcode
+*/
+class ParallelOptions
+{
+  public:
+
+    enum {
+        Auto      = -1,  ///< use one thread per hardware core
+        NoThreads =  0   ///< run sequentially in the calling thread
+    };
+
+        /** Default: use one thread per hardware core (<tt>ParallelOptions::Auto</tt>).
+        */
+    ParallelOptions()
+    : numThreads_(Auto)
+    {}
+
+        /** Set the number of worker threads.
+
+            <tt>ParallelOptions::Auto</tt> (default) chooses the number of hardware cores,
+            <tt>0</tt> or <tt>1</tt> execute the algorithm in the calling thread.
+        */
+    ParallelOptions & numThreads(int n)
+    {
+        numThreads_ = n;
+        return *this;
+    }
+
+        /** Get the number of threads as set by the user.
+        */
+    int getNumThreads() const
+    {
+        return numThreads_;
+    }
+
+        /** Get the number of worker threads that will actually be started,
+            i.e. resolve <tt>ParallelOptions::Auto</tt> and return 0 when
+            threads are unavailable.
+        */
+    int getActualNumThreads() const
+    {
+#ifdef VIGRA_HAS_STD_THREADS
+        if(numThreads_ >= 0)
+            return numThreads_;
+        int n = (int)std::thread::hardware_concurrency();
+        return n > 0
+                  ? n
+                  : 1;
+#else
+        return 0;
+#endif
+    }
+
+    int numThreads_;
+};
+
+/********************************************************/
+/*                                                      */
+/*                    Mutex, LockGuard                  */
+/*                                                      */
+/********************************************************/
+
+#ifdef VIGRA_HAS_STD_THREADS
+
+    /** \brief Mutex for the protection of resources that must not be accessed
+        concurrently (e.g. non-thread-safe libraries).
+        
+        This is <tt>std::mutex</tt> when threads are available, and a no-op otherwise.
+    */
+typedef std::mutex Mutex;
+
+    /** \brief Scoped lock of a \ref vigra::Mutex (<tt>std::lock_guard</tt> when 
+        threads are available, a no-op otherwise).
+    */
+typedef std::lock_guard<std::mutex> LockGuard;
+
+#else
+
+class Mutex
+{
+  public:
+    void lock()
+    {}
+
+    void unlock()
+    {}
+};
+
+class LockGuard
+{
+  public:
+    explicit LockGuard(Mutex &)
+    {}
+};
+
+#endif
+
+/********************************************************/
+/*                                                      */
+/*                      ThreadPool                      */
+/*                                                      */
+/********************************************************/
+
+/** \brief A pool of worker threads.
+
+    The threads are started in the constructor and wait for work until the
+    pool is destroyed. Work is submitted by \ref parallel_foreach(), which blocks
+    until all items have been processed. If fewer than two threads are requested
+    (or threads are unavailable), no workers are started and all work is done in
+    the calling thread.
+
+    A pool can be reused for any number of subsequent calls to \ref parallel_foreach(),
+    but it is not re-entrant: the functor must not submit work to the same pool.
+
+    <b>\#include</b> \<vigra/threadpool.hxx\><br>
+    Namespace: vigra
+*/
+class ThreadPool
+{
+  public:
+        /** Start as many workers as given by <tt>options.getActualNumThreads()</tt>.
+        */
+    explicit ThreadPool(ParallelOptions const & options = ParallelOptions())
+#ifdef VIGRA_HAS_STD_THREADS
+    : job_(0),
+      generation_(0),
+      busy_(0),
+      stop_(false)
+#endif
+    {
+        init(options.getActualNumThreads());
+    }
+
+        /** Start <tt>n</tt> workers.
+        */
+    explicit ThreadPool(int n)
+#ifdef VIGRA_HAS_STD_THREADS
+    : job_(0),
+      generation_(0),
+      busy_(0),
+      stop_(false)
+#endif
+    {
+        init(n);
+    }
+
+    ~ThreadPool()
+    {
+#ifdef VIGRA_HAS_STD_THREADS
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for(std::size_t k=0; k<workers_.size(); ++k)
+            workers_[k].join();
+#endif
+    }
+
+        /** Number of distinct thread indices that are passed to the
+            functors of \ref parallel_foreach() (at least 1). This is
+            the number of per-thread scratch buffers an algorithm must provide.
+        */
+    int numThreads() const
+    {
+#ifdef VIGRA_HAS_STD_THREADS
+        return workers_.size() > 0
+                  ? (int)workers_.size()
+                  : 1;
+#else
+        return 1;
+#endif
+    }
+
+        /** Call <tt>f(threadIndex, i)</tt> for all <tt>0 <= i < count</tt> and
+            return when all calls have finished. <tt>threadIndex</tt> is in the range
+            <tt>[0, numThreads())</tt> and identifies the calling thread, so that
+            <tt>f</tt> can maintain per-thread scratch data. The items are handed
+            out in increasing order, but their completion order is unspecified.
+            If <tt>f</tt> throws, the remaining items are skipped and the
+            first exception is re-thrown in the calling thread.
+        */
+    template <class FUNCTOR>
+    void parallel_foreach(std::ptrdiff_t count, FUNCTOR f)
+    {
+#ifdef VIGRA_HAS_STD_THREADS
+        if(workers_.size() > 0 && count > 1)
+        {
+            std::lock_guard<std::mutex> submitLock(submit_);
+            std::atomic<std::ptrdiff_t> next(0);
+            std::function<void(int)> job = [&](int threadIndex)
+            {
+                try
+                {
+                    for(std::ptrdiff_t i = next++; i < count; i = next++)
+                        f(threadIndex, i);
+                }
+                catch(...)
+                {
+                    next = count;
+                    throw;
+                }
+            };
+            run(job);
+            return;
+        }
+#endif
+        for(std::ptrdiff_t i = 0; i < count; ++i)
+            f(0, i);
+    }
+
+  private:
+    ThreadPool(ThreadPool const &);
+    ThreadPool & operator=(ThreadPool const &);
+
+#ifdef VIGRA_HAS_STD_THREADS
+    void init(int n)
+    {
+        if(n < 2)
+            return;
+        for(int k=0; k<n; ++k)
+            workers_.push_back(std::thread(&ThreadPool::work, this, k));
+    }
+
+    void run(std::function<void(int)> & job)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        job_ = &job;
+        error_ = std::exception_ptr();
+        busy_ = (int)workers_.size();
+        ++generation_;
+        wake_.notify_all();
+        while(busy_ > 0)
+            done_.wait(lock);
+        job_ = 0;
+        if(error_)
+        {
+            std::exception_ptr e = error_;
+            error_ = std::exception_ptr();
+            std::rethrow_exception(e);
+        }
+    }
+
+    void work(int threadIndex)
+    {
+        unsigned int seen = 0;
+        for(;;)
+        {
+            std::function<void(int)> * job = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while(!stop_ && generation_ == seen)
+                    wake_.wait(lock);
+                if(stop_)
+                    return;
+                seen = generation_;
+                job = job_;
+            }
+            try
+            {
+                (*job)(threadIndex);
+            }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(!error_)
+                    error_ = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if(--busy_ == 0)
+                    done_.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_, submit_;
+    std::condition_variable wake_, done_;
+    std::function<void(int)> * job_;
+    std::exception_ptr error_;
+    unsigned int generation_;
+    int busy_;
+    bool stop_;
+#else
+    void init(int)
+    {}
+#endif
+};
+
+/********************************************************/
+/*                                                      */
+/*                   parallel_foreach                   */
+/*                                                      */
+/********************************************************/
+
+/** \brief Apply a functor to the indices <tt>0...count-1</tt> in parallel.
+
+    The functor is called as <tt>f(threadIndex, i)</tt>, see \ref ThreadPool::parallel_foreach().
+    The first variant uses an existing \ref ThreadPool, the second creates a temporary
+    pool according to the given options.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <class FUNCTOR>
+        void parallel_foreach(ThreadPool & pool, std::ptrdiff_t count, FUNCTOR f);
+
+        template <class FUNCTOR>
+        void parallel_foreach(ParallelOptions const & options, std::ptrdiff_t count, FUNCTOR f);
+    }
+    \endcode
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/threadpool.hxx\><br>
+    Namespace: vigra
+
+    \code
+    struct SquareRoot
+    {
+        double * data;
+
+        void operator()(int threadIndex, std::ptrdiff_t i) const
+        {
+            data[i] = std::sqrt(data[i]);
+        }
+    };
+
+    ArrayVector<double> data(100000);
+    ...
+    SquareRoot f = { data.begin() };
+    parallel_foreach(ParallelOptions().numThreads(4), data.size(), f);
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void parallel_foreach)
+
+template <class FUNCTOR>
+inline void
+parallel_foreach(ThreadPool & pool, std::ptrdiff_t count, FUNCTOR f)
+{
+    pool.parallel_foreach(count, f);
+}
+
+template <class FUNCTOR>
+inline void
+parallel_foreach(ParallelOptions const & options, std::ptrdiff_t count, FUNCTOR f)
+{
+    ThreadPool pool(options);
+    pool.parallel_foreach(count, f);
+}
+
+//@}
+
+} // namespace vigra
+
+#endif // VIGRA_THREADPOOL_HXX
@@ -40,6 +40,12 @@
 #include "config.hxx"
 #include "error.hxx"
 #include "array_vector.hxx"
+#include <vector>
+#include <algorithm>
+
+#ifdef VIGRA_HAS_STD_THREADS
+# include <atomic>
+#endif
 
 namespace vigra {
 
@@ -145,6 +151,130 @@ class UnionFindArray
     }
 };
 
+/** Union-find array that can be used from many threads at the same time.
+
+    In contrast to UnionFindArray, the number of labels is fixed in the 
+    constructor, and each label is initially in its own set. find() and 
+    makeUnion() may be called concurrently. Two sets are merged by linking 
+    the larger root to the smaller one with an atomic compare-and-swap, 
+    which fails (and is retried) if another thread has modified the larger 
+    root in the meantime. find() uses path halving, i.e. each node on the 
+    search path is linked to its grandparent by another compare-and-swap. 
+    Since the parent of a node is always smaller than the node itself, the 
+    trees stay valid no matter in which order the threads run. After all 
+    unions have been made, makeContiguous() (which must not run concurrently 
+    with other functions) renumbers the sets in the same way as UnionFindArray: 
+    label 0 is reserved for the background, the remaining roots get the 
+    labels 1, 2, ... in increasing order.
+
+    Without thread support (see \ref ParallelProcessing), this is an ordinary
+    single-threaded union-find array.
+*/
+template <class T>
+class ConcurrentUnionFindArray
+{
+#ifdef VIGRA_HAS_STD_THREADS
+    typedef std::atomic<T> Entry;
+
+    static T load(Entry const & e)
+    {
+        return e.load(std::memory_order_relaxed);
+    }
+
+    static bool exchangeIfEqual(Entry & e, T expected, T desired)
+    {
+        return e.compare_exchange_strong(expected, desired);
+    }
+#else
+    typedef T Entry;
+
+    static T load(Entry const & e)
+    {
+        return e;
+    }
+
+    static bool exchangeIfEqual(Entry & e, T expected, T desired)
+    {
+        if(e != expected)
+            return false;
+        e = desired;
+        return true;
+    }
+#endif
+
+    typedef typename std::vector<Entry>::size_type IndexType;
+    mutable std::vector<Entry> labels_;
+
+    ConcurrentUnionFindArray(ConcurrentUnionFindArray const &);
+    ConcurrentUnionFindArray & operator=(ConcurrentUnionFindArray const &);
+    
+  public:
+    ConcurrentUnionFindArray(std::size_t size)
+    : labels_(size)
+    {
+        vigra_precondition(size == 0 || (std::size_t)(T)(size - 1) == size - 1,
+            "ConcurrentUnionFindArray(): Need more labels than can be represented in the label type.");
+        for(IndexType k=0; k < size; ++k)
+            labels_[k] = (T)k;
+    }
+
+    std::size_t size() const
+    {
+        return labels_.size();
+    }
+    
+    T find(T label) const
+    {
+        T parent = load(labels_[(IndexType)label]);
+        while(parent != label)
+        {
+            // path halving
+            T grandparent = load(labels_[(IndexType)parent]);
+            if(grandparent != parent)
+                exchangeIfEqual(labels_[(IndexType)label], parent, grandparent);
+            label  = grandparent;
+            parent = load(labels_[(IndexType)label]);
+        }
+        return label;
+    }
+    
+    T makeUnion(T l1, T l2)
+    {
+        for(;;)
+        {
+            l1 = find(l1);
+            l2 = find(l2);
+            if(l1 == l2)
+                return l1;
+            if(l2 < l1)
+                std::swap(l1, l2);
+            // fails if l2 is no longer a root
+            if(exchangeIfEqual(labels_[(IndexType)l2], l2, l1))
+                return l1;
+        }
+    }
+    
+    unsigned int makeContiguous()
+    {
+        // compress trees
+        unsigned int count = 0; 
+        for(IndexType i=0; i<labels_.size(); ++i)
+        {
+            T parent = load(labels_[i]);
+            if(parent == (T)i)
+                labels_[i] = (T)count++;
+            else
+                labels_[i] = load(labels_[(IndexType)parent]); 
+        }
+        return count-1;   
+    }
+    
+    T operator[](T label) const
+    {
+        return load(labels_[(IndexType)label]);
+    }
+};
+
 } // namespace detail
 
 } // namespace vigra
@@ -37,6 +37,7 @@
 #define VIGRA_VOXELNEIGHBORHOOD_HXX
 
 #include "tinyvector.hxx"
+#include "array_vector.hxx"
 #include "pixelneighborhood.hxx"
 
 namespace vigra {
@@ -1601,6 +1602,63 @@ static const Direction DirectionCount     = NeighborCode3D::DirectionCount;
  */
 typedef Neighborhood3DTwentySix::NeighborCode3D NeighborCode3DTwentySix;
 
+/********************************************************/
+/*                                                      */
+/*                   NeighborhoodType                   */
+/*                                                      */
+/********************************************************/
+
+/** \brief Choose the neighborhood system of an N-dimensional algorithm.
+
+    <tt>DirectNeighborhood</tt> contains the 2*N neighbors which share a face with 
+    the center point (4-neighborhood in 2D, 6-neighborhood in 3D), 
+    <tt>IndirectNeighborhood</tt> contains all 3^N - 1 neighbors
+    (8-neighborhood in 2D, 26-neighborhood in 3D).
+*/
+enum NeighborhoodType { 
+    DirectNeighborhood = 0, 
+    IndirectNeighborhood = 1 
+};
+
+namespace detail {
+
+    // Collect the offsets of the direct or indirect neighbors of an
+    // N-dimensional grid point. The offsets are sorted in scan order,
+    // so that offsets[k] and offsets[size()-1-k] point in opposite directions.
+template <class Shape>
+void
+makeNeighborhoodOffsets(NeighborhoodType neighborhood, ArrayVector<Shape> & offsets)
+{
+    static const int N = Shape::static_size;
+
+    offsets.clear();
+    Shape offset(-1);
+    while(true)
+    {
+        int nonzero = 0;
+        for(int k=0; k<N; ++k)
+            if(offset[k] != 0)
+                ++nonzero;
+        if(nonzero == 1 || (nonzero > 1 && neighborhood == IndirectNeighborhood))
+            offsets.push_back(offset);
+
+        int k = 0;
+        for(; k<N; ++k)
+        {
+            if(offset[k] < 1)
+            {
+                ++offset[k];
+                break;
+            }
+            offset[k] = -1;
+        }
+        if(k == N)
+            break;
+    }
+}
+
+} // namespace detail
+
 //@}
 
 } // namespace vigra
@@ -42,6 +42,7 @@
 #include "labelvolume.hxx"
 #include "seededregiongrowing3d.hxx"
 #include "watersheds.hxx"
+#include "threadpool.hxx"
 
 namespace vigra
 {
@@ -556,6 +557,586 @@ inline unsigned int watersheds3DTwentySix( vigra::triple<SrcIterator, SrcShape,
     return watersheds3D(src.first, src.second, src.third, dest.first, dest.second, NeighborCode3DTwentySix());
 }
 
+namespace detail {
+
+    // Order in which the neighbors are searched for the lowest one. Among
+    // equally low neighbors, the first one wins. In 2D and 3D, the order of
+    // the 3D neighborhood codes (restricted to the plane in 2D) is used, so 
+    // that plateaus are resolved like in watersheds3D().
+template <class Neighborhood, class Shape>
+void
+neighborCodeSearchOrder(ArrayVector<Shape> const & neighbors, ArrayVector<int> & order)
+{
+    order.clear();
+    for(int k=0; k<Neighborhood::DirectionCount; ++k)
+    {
+        Diff3D diff = Neighborhood::diff((typename Neighborhood::Direction)k);
+        Shape offset;
+        bool inside = true;
+        for(int d=0; d<3; ++d)
+        {
+            if(d < Shape::static_size)
+                offset[d] = diff[d];
+            else if(diff[d] != 0)
+                inside = false;
+        }
+        if(inside)
+            order.push_back(std::find(neighbors.begin(), neighbors.end(), offset) - neighbors.begin());
+    }
+}
+
+template <unsigned int N>
+struct WatershedSearchOrder
+{
+    template <class Shape>
+    static void exec(ArrayVector<Shape> const & neighbors, ArrayVector<int> & order)
+    {
+        if(N > 3)
+        {
+            order.resize(neighbors.size());
+            for(unsigned int n=0; n<neighbors.size(); ++n)
+                order[n] = n;
+        }
+        else if(neighbors.size() == 2*N)
+            neighborCodeSearchOrder<NeighborCode3DSix>(neighbors, order);
+        else
+            neighborCodeSearchOrder<NeighborCode3DTwentySix>(neighbors, order);
+    }
+};
+
+    // Determine, for every element, the directions of its lowest neighbor
+    // (or of all equal neighbors on a plateau) as a bitmask, where bit n 
+    // refers to neighbors[n]. Returns the number of local minima.
+template <unsigned int N, class T1, class S1, class Bitmask, class S2, class Shape>
+unsigned int
+prepareWatershedsMultiArray(MultiArrayView<N, T1, S1> const & src,
+                            MultiArrayView<N, Bitmask, S2> directions,
+                            ArrayVector<Shape> const & neighbors)
+{
+    int neighborCount = (int)neighbors.size();
+    ArrayVector<MultiArrayIndex> srcOffsets(neighborCount);
+    for(int n=0; n<neighborCount; ++n)
+        srcOffsets[n] = dot(neighbors[n], src.stride());
+    ArrayVector<int> order;
+    WatershedSearchOrder<N>::exec(neighbors, order);
+
+    unsigned int local_min_count = 0;
+    typename MultiArrayView<N, T1, S1>::const_iterator s = src.begin(), send = src.end();
+    typename MultiArrayView<N, Bitmask, S2>::iterator d = directions.begin();
+    for(; s != send; ++s, ++d)
+    {
+        Shape const & p = s.point();
+        bool atBorder = false;
+        for(unsigned int k=0; k<N; ++k)
+            if(p[k] == 0 || p[k] == src.shape(k)-1)
+                atBorder = true;
+
+        T1 v = *s, my_v = v;
+        Bitmask o = 0; // means center is minimum
+        for(int k=0; k<neighborCount; ++k)
+        {
+            int n = order[k];
+            if(atBorder && !src.isInside(p + neighbors[n]))
+                continue;
+            T1 w = s.ptr()[srcOffsets[n]];
+            if(w < v)
+            {
+                v = w;
+                o = (Bitmask)(1u << n);
+            }
+            else if(w == my_v && my_v == v)
+            {
+                o |= (Bitmask)(1u << n);
+            }
+        }
+        if(o == 0)
+            ++local_min_count;
+        *d = o;
+    }
+    return local_min_count;
+}
+
+    // Merge all elements connected by a direction bit, using the causal
+    // half of the neighborhood (which precedes the center in scan order).
+template <unsigned int N, class Bitmask, class S1, class T2, class S2, class Shape>
+unsigned int
+watershedLabelingMultiArray(MultiArrayView<N, Bitmask, S1> const & directions,
+                            MultiArrayView<N, T2, S2> labels,
+                            ArrayVector<Shape> const & neighbors)
+{
+    int neighborCount = (int)neighbors.size(), causalCount = neighborCount / 2;
+    ArrayVector<MultiArrayIndex> directionOffsets(causalCount), labelOffsets(causalCount);
+    for(int n=0; n<causalCount; ++n)
+    {
+        directionOffsets[n] = dot(neighbors[n], directions.stride());
+        labelOffsets[n] = dot(neighbors[n], labels.stride());
+    }
+
+    UnionFindArray<T2> regions;
+
+    // pass 1: find the regions as trees of provisional labels (see watershedLabeling())
+    typename MultiArrayView<N, Bitmask, S1>::const_iterator d = directions.begin(), 
+                                                            dend = directions.end();
+    typename MultiArrayView<N, T2, S2>::iterator l = labels.begin();
+    for(; d != dend; ++d, ++l)
+    {
+        Shape const & p = d.point();
+        bool atBorder = false;
+        for(unsigned int k=0; k<N; ++k)
+            if(p[k] == 0 || p[k] == directions.shape(k)-1)
+                atBorder = true;
+
+        T2 currentLabel = regions.nextFreeLabel();
+        for(int n=0; n<causalCount; ++n)
+        {
+            if(atBorder && !directions.isInside(p + neighbors[n]))
+                continue;
+            // the offsets are symmetric, so the opposite direction is 
+            // found at the mirrored index
+            if((*d & (Bitmask)(1u << n)) || 
+               (d.ptr()[directionOffsets[n]] & (Bitmask)(1u << (neighborCount-1-n))))
+            {
+                currentLabel = regions.makeUnion(l.ptr()[labelOffsets[n]], currentLabel);
+            }
+        }
+        *l = regions.finalizeLabel(currentLabel);
+    }
+
+    unsigned int count = regions.makeContiguous();
+
+    // pass 2: assign consecutive labels 1, 2, ... to the regions
+    typename MultiArrayView<N, T2, S2>::iterator lend = labels.end();
+    for(l = labels.begin(); l != lend; ++l)
+        *l = regions[*l];
+    return count;
+}
+
+template <class Bitmask, unsigned int N, class T1, class S1, class T2, class S2, class Shape>
+unsigned int
+watershedsUnionFindImpl(MultiArrayView<N, T1, S1> const & src,
+                        MultiArrayView<N, T2, S2> labels,
+                        ArrayVector<Shape> const & neighbors)
+{
+    MultiArray<N, Bitmask> directions(src.shape());
+    prepareWatershedsMultiArray(src, directions, neighbors);
+    return watershedLabelingMultiArray(directions, labels, neighbors);
+}
+
+} // namespace detail
+
+/** \brief Dimension-independent watershed segmentation by means of union-find.
+
+    This function implements the same algorithm as \ref watersheds3D() for arrays 
+    of arbitrary dimension: local minima of the boundary indicator <tt>src</tt> are 
+    used as region seeds, and all other elements are recursively assigned to the 
+    same region as their lowest neighbor. Plateaus are merged into one region.
+    The neighborhood is chosen by the <tt>neighborhood</tt> parameter:
+    <tt>DirectNeighborhood</tt> (4-neighborhood in 2D, 6-neighborhood in 3D) or 
+    <tt>IndirectNeighborhood</tt> (8-neighborhood in 2D, 26-neighborhood in 3D).
+    In 2D, the result equals the one of the image version of \ref watershedsUnionFind()
+    as long as no element has several equally low neighbors, since that version 
+    resolves such ties differently.
+    
+    The directions of the lowest neighbors are stored as a bitmask of the 
+    smallest unsigned type that has one bit per neighbor (i.e. <tt>UInt8</tt> for
+    the 6-neighborhood, <tt>UInt32</tt> for the 26-neighborhood), so that at most 
+    32 neighbors are supported. The element type of <tt>src</tt> must be 
+    <tt>LessThanComparable</tt>, and the label type must be large enough to 
+    hold the number of regions. The function returns the number of regions.
+
+    <b> Declaration:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class S1, class T2, class S2>
+        unsigned int
+        watershedsUnionFind(MultiArrayView<N, T1, S1> const & src,
+                            MultiArrayView<N, T2, S2> labels,
+                            NeighborhoodType neighborhood = IndirectNeighborhood);
+    }
+    \endcode
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/watersheds3d.hxx\><br>
+    Namespace: vigra
+
+    \code
+    MultiArray<3, float> gradMag(shape);
+    MultiArray<3, UInt32> labels(shape);
+    ... // compute boundary indicator
+    
+    // find 6-connected regions
+    unsigned int max_region_label = watershedsUnionFind(gradMag, labels, DirectNeighborhood);
+    \endcode
+*/
+template <unsigned int N, class T1, class S1, class T2, class S2>
+unsigned int
+watershedsUnionFind(MultiArrayView<N, T1, S1> const & src,
+                    MultiArrayView<N, T2, S2> labels,
+                    NeighborhoodType neighborhood = IndirectNeighborhood)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    vigra_precondition(src.shape() == labels.shape(),
+        "watershedsUnionFind(): Shape mismatch between input and output.");
+
+    ArrayVector<Shape> neighbors;
+    detail::makeNeighborhoodOffsets(neighborhood, neighbors);
+
+    if(neighbors.size() <= 8)
+        return detail::watershedsUnionFindImpl<UInt8>(src, labels, neighbors);
+    if(neighbors.size() <= 16)
+        return detail::watershedsUnionFindImpl<UInt16>(src, labels, neighbors);
+    vigra_precondition(neighbors.size() <= 32,
+        "watershedsUnionFind(): at most 32 neighbors are supported.");
+    return detail::watershedsUnionFindImpl<UInt32>(src, labels, neighbors);
+}
+
+namespace detail {
+
+    // Decomposition of an array into blocks.
+template <unsigned int N>
+struct WatershedBlocks
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    Shape shape, blockShape, blockCount;
+
+    WatershedBlocks(Shape const & s, Shape const & b)
+    : shape(s), blockShape(b), 
+      blockCount((s + b - Shape(MultiArrayIndex(1))) / b)
+    {}
+
+    MultiArrayIndex size() const
+    {
+        return prod(blockCount);
+    }
+
+    Shape blockCoordinate(MultiArrayIndex k) const
+    {
+        Shape res;
+        for(unsigned int d=0; d<N; ++d)
+        {
+            res[d] = k % blockCount[d];
+            k /= blockCount[d];
+        }
+        return res;
+    }
+
+    MultiArrayIndex blockIndex(Shape const & c) const
+    {
+        MultiArrayIndex res = 0;
+        for(int d=N-1; d>=0; --d)
+            res = res*blockCount[d] + c[d];
+        return res;
+    }
+
+        // blocks of the same color are never adjacent
+    int color(MultiArrayIndex k) const
+    {
+        Shape c = blockCoordinate(k);
+        int res = 0;
+        for(unsigned int d=0; d<N; ++d)
+            res |= (int)(c[d] & 1) << d;
+        return res;
+    }
+
+    void getBlock(MultiArrayIndex k, Shape & begin, Shape & end) const
+    {
+        begin = blockCoordinate(k) * blockShape;
+        end = min(begin + blockShape, shape);
+    }
+};
+
+template <class Shape, class Label>
+struct WatershedBlockCandidate
+{
+    Shape point_;
+    Label label_;
+    UInt8 parent_;
+
+    WatershedBlockCandidate(Shape const & point, Label label, UInt8 parent)
+    : point_(point), label_(label), parent_(parent)
+    {}
+};
+
+    // Flood one block from the labelled voxels in the block and in the 
+    // 1-voxel wide shell around it, which belongs to the neighboring blocks.
+    // A voxel is assigned to the region that reaches it at the lowest flooding 
+    // level (i.e. the smallest maximal height along a path from the seed). 
+    // Each voxel remembers the direction of the neighbor it was flooded from
+    // (its parent), and also takes over the parent's label when the parent is 
+    // re-assigned at the same level. Thus, repeated flooding of the blocks 
+    // converges to the same levels as a serial flooding, and every label can 
+    // be traced back to its seed along a path of parents.
+template <unsigned int N, class T1, class S1, class T2, class S2>
+struct WatershedBlockFloodFunctor
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef WatershedBlockCandidate<Shape, T2> Candidate;
+
+    enum { NoParent = 255 };
+
+    MultiArrayView<N, T1, S1> src;
+    mutable MultiArrayView<N, T2, S2> labels;
+    mutable MultiArrayView<N, T1> levels;
+    mutable MultiArrayView<N, UInt8> parents;
+    WatershedBlocks<N> const * blocks;
+    ArrayVector<Shape> const * neighbors;
+    MultiArrayIndex const * blockIndices;
+    UInt8 * borderChanged;
+    bool firstRound;
+    std::ptrdiff_t bucketCount;
+
+    static bool isInside(Shape const & p, Shape const & begin, Shape const & end)
+    {
+        for(unsigned int d=0; d<N; ++d)
+            if(p[d] < begin[d] || p[d] >= end[d])
+                return false;
+        return true;
+    }
+
+    static bool isAtBorder(Shape const & p, Shape const & begin, Shape const & end)
+    {
+        for(unsigned int d=0; d<N; ++d)
+            if(p[d] == begin[d] || p[d] == end[d]-1)
+                return true;
+        return false;
+    }
+
+    bool isImprovement(Shape const & p, std::ptrdiff_t level, 
+                       T2 label, UInt8 parent) const
+    {
+        if(labels[p] == 0 || level < levels[p])
+            return true;
+        return level == levels[p] && parents[p] == parent && labels[p] != label;
+    }
+
+    void operator()(int, std::ptrdiff_t i) const
+    {
+        MultiArrayIndex k = blockIndices[i];
+        Shape begin, end;
+        blocks->getBlock(k, begin, end);
+        int neighborCount = (int)neighbors->size();
+
+        BucketQueue<Candidate, true> pqueue(bucketCount);
+
+        // Find improvements from the labelled neighbors. After the first 
+        // round, the block interior is consistent, and only the shell can 
+        // provide changes.
+        MultiArrayView<N, T2, S2> block = labels.subarray(begin, end);
+        typename MultiArrayView<N, T2, S2>::iterator b = block.begin(), bend = block.end();
+        for(; b != bend; ++b)
+        {
+            Shape p = b.point() + begin;
+            if(!firstRound && !isAtBorder(p, begin, end))
+                continue;
+            std::ptrdiff_t height = seedRgTurboPriority(src[p], bucketCount);
+            for(int n=0; n<neighborCount; ++n)
+            {
+                Shape q = p + (*neighbors)[n];
+                if(!labels.isInside(q) || labels[q] == 0 || 
+                   (!firstRound && isInside(q, begin, end)))
+                    continue;
+                std::ptrdiff_t level = std::max(height, (std::ptrdiff_t)levels[q]);
+                if(isImprovement(p, level, labels[q], (UInt8)n))
+                    pqueue.push(Candidate(p, labels[q], (UInt8)n), level);
+            }
+        }
+
+        bool changed = false;
+        while(!pqueue.empty())
+        {
+            Candidate candidate = pqueue.top();
+            std::ptrdiff_t level = pqueue.topPriority();
+            pqueue.pop();
+
+            Shape const & p = candidate.point_;
+            if(!isImprovement(p, level, candidate.label_, candidate.parent_))
+                continue;
+            labels[p] = candidate.label_;
+            levels[p] = (T1)level;
+            parents[p] = candidate.parent_;
+            if(isAtBorder(p, begin, end))
+                changed = true;
+
+            for(int n=0; n<neighborCount; ++n)
+            {
+                Shape q = p + (*neighbors)[n];
+                if(!isInside(q, begin, end))
+                    continue;
+                std::ptrdiff_t qlevel = 
+                    std::max(level, seedRgTurboPriority(src[q], bucketCount));
+                // the offsets are symmetric, so the opposite direction is 
+                // found at the mirrored index
+                UInt8 parent = (UInt8)(neighborCount - 1 - n);
+                if(isImprovement(q, qlevel, candidate.label_, parent))
+                    pqueue.push(Candidate(q, candidate.label_, parent), qlevel);
+            }
+        }
+        borderChanged[k] = changed;
+    }
+};
+
+} // namespace detail
+
+/********************************************************/
+/*                                                      */
+/*                   watershedsBlockwise                */
+/*                                                      */
+/********************************************************/
+
+/** \brief Parallel watershed segmentation by block decomposition.
+
+    This function computes a seeded watershed segmentation like
+    \ref fastSeededRegionGrowing() with \ref SeedRgDirectValueFunctor, but splits the 
+    array into blocks of shape <tt>blockShape</tt> which are processed in parallel 
+    according to the given \ref ParallelOptions. The <tt>labels</tt> array 
+    contains the seeds on input (e.g. the labelled minima of the boundary indicator 
+    <tt>src</tt>, see \ref generateWatershedSeeds()), and receives a complete
+    tesselation on output (provided that there is at least one seed).
+    
+    Each block is flooded independently from the seeds inside it and from the 
+    labels in a 1-voxel wide halo around the block. The flooding keeps track of
+    the flooding level of each voxel, i.e. the lowest possible maximum of the
+    boundary indicator along a path from a seed to the voxel. Conflicts at the seams
+    are then resolved by comparing these levels: whenever a neighboring block 
+    reaches a voxel on a seam at a lower level, the block is flooded again from 
+    the updated halo, until no levels change any more. Blocks are processed in 
+    2^N interleaved groups, so that adjacent blocks are never flooded at the same time.
+    
+    Each voxel also records the neighbor it was flooded from, and follows that 
+    neighbor when its label changes at the same level, so that the labels stay 
+    connected to their seeds across the seams. The resulting levels are the same 
+    as in a serial flooding. Only voxels which can be reached from different seeds 
+    at the same level may be assigned differently. The boundary indicator must have an integral type whose values 
+    are in the range <tt>[0, bucket_count)</tt>, i.e. <tt>bucket_count</tt> should be 
+    256 for <tt>UInt8</tt> and 65536 for <tt>UInt16</tt> input. An additional array 
+    of the same size and type as <tt>src</tt> is allocated for the flooding levels,
+    and a <tt>UInt8</tt> array for the flooding directions.
+    Blocks should be large compared to the typical distance between seeds,
+    so that the seam resolution needs few rounds. The function returns 
+    the largest seed label.
+
+    <b> Declaration:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class S1, class T2, class S2>
+        T2
+        watershedsBlockwise(MultiArrayView<N, T1, S1> const & src,
+                            MultiArrayView<N, T2, S2> labels,
+                            typename MultiArrayShape<N>::type const & blockShape,
+                            ParallelOptions const & options,
+                            NeighborhoodType neighborhood = DirectNeighborhood,
+                            std::ptrdiff_t bucket_count = 256);
+    }
+    \endcode
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/watersheds3d.hxx\><br>
+    Namespace: vigra
+
+    \code
+    MultiArray<3, UInt8> boundaries(shape);
+    MultiArray<3, UInt32> labels(shape);
+    ... // compute boundary indicator and mark seeds with labels 1...max_region_label
+    
+    watershedsBlockwise(boundaries, labels, Shape3(128), ParallelOptions());
+    \endcode
+*/
+template <unsigned int N, class T1, class S1, class T2, class S2>
+T2
+watershedsBlockwise(MultiArrayView<N, T1, S1> const & src,
+                    MultiArrayView<N, T2, S2> labels,
+                    typename MultiArrayShape<N>::type const & blockShape,
+                    ParallelOptions const & options,
+                    NeighborhoodType neighborhood = DirectNeighborhood,
+                    std::ptrdiff_t bucket_count = 256)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    vigra_precondition(src.shape() == labels.shape(),
+        "watershedsBlockwise(): Shape mismatch between input and output.");
+    vigra_precondition(*std::min_element(blockShape.begin(), blockShape.end()) > 0,
+        "watershedsBlockwise(): block shape must be positive.");
+
+    T2 maxRegionLabel = *std::max_element(labels.begin(), labels.end());
+
+    ArrayVector<Shape> neighbors;
+    detail::makeNeighborhoodOffsets(neighborhood, neighbors);
+    vigra_precondition(neighbors.size() < 255,
+        "watershedsBlockwise(): dimension too high for the neighborhood.");
+
+    // the flooding level of a seed is its own height
+    MultiArray<N, T1> levels(src.shape());
+    levels = src;
+    MultiArray<N, UInt8> parents(src.shape(), 
+               (UInt8)detail::WatershedBlockFloodFunctor<N, T1, S1, T2, S2>::NoParent);
+
+    detail::WatershedBlocks<N> blocks(labels.shape(), blockShape);
+    MultiArrayIndex blockCount = blocks.size();
+    ArrayVector<UInt8> active(blockCount, 1), borderChanged(blockCount, 0);
+    ArrayVector<MultiArrayIndex> blockIndices;
+
+    ThreadPool pool(options);
+
+    detail::WatershedBlockFloodFunctor<N, T1, S1, T2, S2> 
+        flood = { src, labels, levels, parents, &blocks, &neighbors, 0, 
+                  borderChanged.data(), true, bucket_count };
+
+    ArrayVector<Shape> adjacentBlocks;
+    detail::makeNeighborhoodOffsets(IndirectNeighborhood, adjacentBlocks);
+
+    // Every round extends the correctly flooded part of each optimal path 
+    // by at least one block segment, and a path crosses fewer seams than 
+    // there are voxels. More rounds indicate an inconsistent flooding.
+    MultiArrayIndex maxRounds = labels.size();
+    for(MultiArrayIndex round = 0; ; ++round)
+    {
+        vigra_postcondition(round <= maxRounds,
+            "watershedsBlockwise(): seam resolution did not converge.");
+        for(int color=0; color < (1 << N); ++color)
+        {
+            blockIndices.clear();
+            for(MultiArrayIndex k=0; k<blockCount; ++k)
+                if(active[k] && blocks.color(k) == color)
+                    blockIndices.push_back(k);
+            flood.blockIndices = blockIndices.data();
+            parallel_foreach(pool, blockIndices.size(), flood);
+        }
+
+        // re-flood the neighbors of blocks whose seams have changed
+        bool done = true;
+        std::fill(active.begin(), active.end(), 0);
+        for(MultiArrayIndex k=0; k<blockCount; ++k)
+        {
+            if(!borderChanged[k])
+                continue;
+            borderChanged[k] = 0;
+            done = false;
+            Shape c = blocks.blockCoordinate(k);
+            for(unsigned int n=0; n<adjacentBlocks.size(); ++n)
+            {
+                Shape a = c + adjacentBlocks[n];
+                bool inside = true;
+                for(unsigned int d=0; d<N; ++d)
+                    if(a[d] < 0 || a[d] >= blocks.blockCount[d])
+                        inside = false;
+                if(inside)
+                    active[blocks.blockIndex(a)] = 1;
+            }
+        }
+        if(done)
+            break;
+        flood.firstRound = false;
+    }
+
+    return maxRegionLabel;
+}
+
 }//namespace vigra
 
 #endif //VIGRA_watersheds3D_HXX
@@ -0,0 +1,142 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2011 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifdef HasZLIB
+
+#include "deflate.hxx"
+#include "error.hxx"
+#include <zlib.h>
+
+namespace vigra
+{
+    int zlibStrategy( const std::string & name, int defaultStrategy )
+    {
+        if ( name == "" )
+            return defaultStrategy;
+        if ( name == "DEFAULT" )
+            return Z_DEFAULT_STRATEGY;
+        if ( name == "FILTERED" )
+            return Z_FILTERED;
+        if ( name == "HUFFMAN_ONLY" )
+            return Z_HUFFMAN_ONLY;
+        if ( name == "RLE" )
+            return Z_RLE;
+        if ( name == "FIXED" )
+            return Z_FIXED;
+        vigra_precondition( false, "zlibStrategy(): unknown compression strategy." );
+        return defaultStrategy;
+    }
+
+    // run deflate() on 'size' bytes with the given flush mode, and append
+    // the output to 'dest', which is grown as needed
+    static void deflateAll( z_stream & stream, const UInt8 * src, std::size_t size,
+                            int flush, ArrayVector<UInt8> & dest )
+    {
+        std::size_t written = 0;
+        dest.resize( deflateBound( &stream, (uLong)size ) + 16 );
+
+        stream.next_in = const_cast< Bytef * >( src );
+        stream.avail_in = (uInt)size;
+        for(;;)
+        {
+            stream.next_out = dest.data() + written;
+            stream.avail_out = (uInt)( dest.size() - written );
+            int res = deflate( &stream, flush );
+            written = dest.size() - stream.avail_out;
+            if ( res == Z_STREAM_END || ( flush != Z_FINISH && stream.avail_out > 0 ) )
+                break;
+            vigra_postcondition( res == Z_OK || res == Z_BUF_ERROR,
+                                 "deflate(): unable to compress image data." );
+            dest.resize( 2 * dest.size() );
+        }
+        dest.resize( written );
+    }
+
+    static void deflateBuffer( const UInt8 * src, std::size_t size, int level,
+                               int strategy, int windowBits, int flush,
+                               ArrayVector<UInt8> & dest )
+    {
+        vigra_precondition( size <= 0xffffffffu,
+            "deflate(): image data too large for a single zlib call." );
+        z_stream stream;
+        stream.zalloc = Z_NULL;
+        stream.zfree = Z_NULL;
+        stream.opaque = Z_NULL;
+        vigra_postcondition( deflateInit2( &stream, level, Z_DEFLATED, windowBits,
+                                           8, strategy ) == Z_OK,
+                             "deflateInit2(): unable to initialize zlib." );
+        try
+        {
+            deflateAll( stream, src, size, flush, dest );
+        }
+        catch( ... )
+        {
+            deflateEnd( &stream );
+            throw;
+        }
+        deflateEnd( &stream );
+    }
+
+    void zlibCompress( const UInt8 * src, std::size_t size,
+                       int level, int strategy, ArrayVector<UInt8> & dest )
+    {
+        deflateBuffer( src, size, level, strategy, 15, Z_FINISH, dest );
+    }
+
+    void deflatePart( const UInt8 * src, std::size_t size,
+                      int level, int strategy, bool last,
+                      ArrayVector<UInt8> & dest )
+    {
+        // negative window bits produce raw deflate data without header
+        // and checksum, Z_SYNC_FLUSH ends them on a byte boundary
+        deflateBuffer( src, size, level, strategy, -15,
+                       last ? Z_FINISH : Z_SYNC_FLUSH, dest );
+    }
+
+    void zlibHeader( int level, UInt8 * header )
+    {
+        // deflate with 32K window, and FLEVEL as zlib sets it
+        int flevel = ( level == Z_DEFAULT_COMPRESSION || level == 6 ) ? 2
+                         : level < 2 ? 0
+                         : level < 6 ? 1
+                         : 3;
+        header[0] = 0x78;
+        header[1] = (UInt8)( flevel << 6 );
+        header[1] += (UInt8)( 31 - ( header[0] * 256 + header[1] ) % 31 );
+    }
+
+} // namespace vigra
+
+#endif // HasZLIB
@@ -0,0 +1,74 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2011 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_IMPEX_DEFLATE_HXX
+#define VIGRA_IMPEX_DEFLATE_HXX
+
+#include <string>
+#include "vigra/array_vector.hxx"
+#include "vigra/sized_int.hxx"
+
+// Helpers for codecs that compress their image data with zlib themselves,
+// instead of leaving this to libpng or libtiff, so that independent parts
+// of the data can be compressed concurrently.
+
+namespace vigra
+{
+    // zlib strategy constant for the names accepted by
+    // ImageExportInfo::setCompressionStrategy(), or 'defaultStrategy'
+    // if the name is empty.
+    int zlibStrategy( const std::string & name, int defaultStrategy );
+
+    // Compress 'size' bytes into a complete zlib stream (header, deflate
+    // data and adler32 checksum) and store it in 'dest'.
+    void zlibCompress( const UInt8 * src, std::size_t size,
+                       int level, int strategy, ArrayVector<UInt8> & dest );
+
+    // Compress one part of a zlib stream whose parts are compressed
+    // independently of each other. Only the raw deflate data are stored
+    // in 'dest'. All parts but the last end on a byte boundary, so that
+    // they can be concatenated, and the last part terminates the stream.
+    // The caller adds zlibHeader() before the first part, and the adler32
+    // checksum of the uncompressed data after the last.
+    void deflatePart( const UInt8 * src, std::size_t size,
+                      int level, int strategy, bool last,
+                      ArrayVector<UInt8> & dest );
+
+    // the two bytes that start a zlib stream compressed with 'level'
+    void zlibHeader( int level, UInt8 * header );
+
+} // namespace vigra
+
+#endif // VIGRA_IMPEX_DEFLATE_HXX
@@ -67,6 +67,10 @@
 #  include "vigra/windows.h"
 #else
 #  include <dirent.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
 #endif
 
 namespace vigra
@@ -323,6 +327,7 @@ bool isImage(char const * filename)
 
 ImageExportInfo::ImageExportInfo( const char * filename )
     : m_filename(filename),
+      m_comp_level(-1), m_num_threads(0),
       m_x_res(0), m_y_res(0),
       fromMin_(0.0), fromMax_(0.0), toMin_(0.0), toMax_(0.0)
 {}
@@ -410,6 +415,45 @@ const char * ImageExportInfo::getCompression() const
     return m_comp.c_str();
 }
 
+ImageExportInfo & ImageExportInfo::setCompressionLevel( int level )
+{
+    vigra_precondition(level >= -1 && level <= 9,
+        "ImageExportInfo::setCompressionLevel(): level must be in [-1, 9].");
+    m_comp_level = level;
+    return *this;
+}
+
+int ImageExportInfo::getCompressionLevel() const
+{
+    return m_comp_level;
+}
+
+ImageExportInfo & ImageExportInfo::setCompressionStrategy( const char * strategy )
+{
+    std::string s(strategy);
+    vigra_precondition(s == "" || s == "DEFAULT" || s == "FILTERED" ||
+                       s == "HUFFMAN_ONLY" || s == "RLE" || s == "FIXED",
+        "ImageExportInfo::setCompressionStrategy(): unknown strategy.");
+    m_comp_strategy = s;
+    return *this;
+}
+
+const char * ImageExportInfo::getCompressionStrategy() const
+{
+    return m_comp_strategy.c_str();
+}
+
+ImageExportInfo & ImageExportInfo::setNumThreads( int n )
+{
+    m_num_threads = n;
+    return *this;
+}
+
+int ImageExportInfo::getNumThreads() const
+{
+    return m_num_threads;
+}
+
 float ImageExportInfo::getXResolution() const
 {
     return m_x_res;
@@ -500,8 +544,11 @@ std::auto_ptr<Encoder> encoder( const ImageExportInfo & info )
             parsed_comp = comp.substr(0, pos);
         }
         
+        // (a failed extraction sets quality to 0 in C++11, so that
+        // e.g. "DEFLATE" must not be taken from the stream)
         std::istringstream compstream(comp.substr(start));
-        compstream >> quality;
+        if ( !(compstream >> quality) )
+            quality = -1;
         if ( quality != -1 ) 
         {
             if(parsed_comp == "")
@@ -527,6 +574,12 @@ std::auto_ptr<Encoder> encoder( const ImageExportInfo & info )
         enc->setPixelType(pixel_type);
     }
 
+    if ( info.getCompressionLevel() != -1 )
+        enc->setCompressionLevel(info.getCompressionLevel());
+    if ( std::string(info.getCompressionStrategy()) != "" )
+        enc->setCompressionStrategy(info.getCompressionStrategy());
+    enc->setNumThreads(info.getNumThreads());
+
     // set other properties
     enc->setXResolution(info.getXResolution());
     enc->setYResolution(info.getYResolution());
@@ -559,6 +612,7 @@ ImageImportInfo::ImageImportInfo( const char * filename )
     m_y_res = decoder->getYResolution();
 
     m_icc_profile = decoder->getICCProfile();
+    m_roi = Rect2D(Size2D(m_width, m_height));
 
     decoder->abort(); // there probably is no better way than this
 }
@@ -672,12 +726,159 @@ const ImageImportInfo::ICCProfile & ImageImportInfo::getICCProfile() const
     return m_icc_profile;
 }
 
+ImageImportInfo & ImageImportInfo::setRegionOfInterest( Rect2D const & roi )
+{
+    vigra_precondition(!roi.isEmpty() &&
+                       Rect2D(Size2D(m_width, m_height)).contains(roi),
+        "ImageImportInfo::setRegionOfInterest(): region must be non-empty and inside the image.");
+    m_roi = roi;
+    return *this;
+}
+
+Rect2D const & ImageImportInfo::getRegionOfInterest() const
+{
+    return m_roi;
+}
+
+namespace detail {
+
+// Crops the scanlines of a decoder that cannot restrict decoding
+// to a region of interest by itself.
+class RegionOfInterestDecoder : public Decoder
+{
+    std::auto_ptr<Decoder> dec_;
+    Diff2D ul_;
+    Size2D size_;
+    unsigned int pixelBytes_;
+    unsigned int rows_;
+
+  public:
+    RegionOfInterestDecoder( std::auto_ptr<Decoder> dec,
+                             Diff2D const & ul, Size2D const & size )
+    : dec_(dec), ul_(ul), size_(size), rows_(0)
+    {
+        std::string pixeltype = dec_->getPixelType();
+        if(pixeltype == "UINT8" || pixeltype == "INT8")
+            pixelBytes_ = 1;
+        else if(pixeltype == "UINT16" || pixeltype == "INT16")
+            pixelBytes_ = 2;
+        else if(pixeltype == "UINT32" || pixeltype == "INT32" || pixeltype == "FLOAT")
+            pixelBytes_ = 4;
+        else if(pixeltype == "DOUBLE")
+            pixelBytes_ = 8;
+        else
+            vigra_precondition(false,
+                "importImage(): region of interest not supported for pixel type " + pixeltype + ".");
+        iccProfile_ = dec_->getICCProfile();
+    }
+
+    void init( const std::string & filename )
+    {
+        dec_->init(filename);
+    }
+
+    void close()
+    {
+        // consume the rows below the region, since some codecs (e.g. JPEG)
+        // refuse to finish decoding a partially read file
+        for(unsigned int h = dec_->getHeight(); rows_ < h; ++rows_)
+            dec_->nextScanline();
+        dec_->close();
+    }
+
+    void abort()
+    {
+        dec_->abort();
+    }
+
+    std::string getFileType() const
+    {
+        return dec_->getFileType();
+    }
+
+    std::string getPixelType() const
+    {
+        return dec_->getPixelType();
+    }
+
+    unsigned int getWidth() const
+    {
+        return size_.x;
+    }
+
+    unsigned int getHeight() const
+    {
+        return size_.y;
+    }
+
+    unsigned int getNumBands() const
+    {
+        return dec_->getNumBands();
+    }
+
+    unsigned int getNumExtraBands() const
+    {
+        return dec_->getNumExtraBands();
+    }
+
+    Diff2D getPosition() const
+    {
+        return dec_->getPosition();
+    }
+
+    float getXResolution() const
+    {
+        return dec_->getXResolution();
+    }
+
+    float getYResolution() const
+    {
+        return dec_->getYResolution();
+    }
+
+    Size2D getCanvasSize() const
+    {
+        return dec_->getCanvasSize();
+    }
+
+    unsigned int getOffset() const
+    {
+        return dec_->getOffset();
+    }
+
+    const void * currentScanlineOfBand( unsigned int band ) const
+    {
+        return static_cast<const char *>(dec_->currentScanlineOfBand(band))
+                   + ul_.x * dec_->getOffset() * pixelBytes_;
+    }
+
+    void nextScanline()
+    {
+        // skip the rows above the region
+        for(; rows_ < (unsigned int)ul_.y; ++rows_)
+            dec_->nextScanline();
+        dec_->nextScanline();
+        ++rows_;
+    }
+};
+
+} // namespace detail
+
 // return a decoder for a given ImageImportInfo object
 std::auto_ptr<Decoder> decoder( const ImageImportInfo & info )
 {
     std::string filetype = info.getFileType();
     validate_filetype(filetype);
-    return getDecoder( std::string( info.getFileName() ), filetype );
+    std::auto_ptr<Decoder> dec = getDecoder( std::string( info.getFileName() ), filetype );
+
+    Rect2D const & roi = info.getRegionOfInterest();
+    if(roi != Rect2D(info.size()) &&
+       !dec->setRegionOfInterest(roi.upperLeft(), roi.size()))
+    {
+        dec = std::auto_ptr<Decoder>(
+                  new detail::RegionOfInterestDecoder(dec, roi.upperLeft(), roi.size()));
+    }
+    return dec;
 }
 
 // class VolumeExportInfo
@@ -903,14 +1104,34 @@ VolumeImportInfo::VolumeImportInfo(const std::string &filename)
                     shape_[2] = atoi(value.c_str());
                 else if(key == "datatype")
                 {
-                    // FUTURE: store bit depth / signedness
                     if((value == "UNSIGNED_CHAR") || (value == "UNSIGNED_BYTE"))
-                        numBands_ = 1;
+                        pixelType_ = "UINT8";
+                    else if((value == "SHORT") || (value == "SIGNED_SHORT"))
+                        pixelType_ = "INT16";
+                    else if(value == "UNSIGNED_SHORT")
+                        pixelType_ = "UINT16";
+                    else if((value == "INT") || (value == "SIGNED_INT"))
+                        pixelType_ = "INT32";
+                    else if(value == "UNSIGNED_INT")
+                        pixelType_ = "UINT32";
+                    else if(value == "FLOAT")
+                        pixelType_ = "FLOAT";
+                    else if(value == "DOUBLE")
+                        pixelType_ = "DOUBLE";
                     else
                     {
                         std::cerr << "Unknown datatype '" << value << "'!\n";
                         break;
                     }
+                    numBands_ = 1;
+                }
+                else if(key == "byteorder")
+                {
+                    if((value == "little-endian") || (value == "big-endian"))
+                        byteOrder_ = value;
+                    else
+                        std::cerr << "WARNING: Unknown byte order '" << value
+                                  << "' in info file!\n";
                 }
                 else if(key == "description")
                     description_ = value;
@@ -934,7 +1155,19 @@ VolumeImportInfo::VolumeImportInfo(const std::string &filename)
         if((shape_[0]*shape_[1]*shape_[2] > 0) && (rawFilename_.size() > 0))
         {
             if(!numBands_)
+            {
                 numBands_ = 1; // default to UNSIGNED_CHAR datatype
+                pixelType_ = "UINT8";
+            }
+
+            // the raw file name is relative to the info file
+            std::string::size_type split = filename.find_last_of("/\\");
+            if(split != std::string::npos &&
+               rawFilename_[0] != '/' && rawFilename_[0] != '\\' &&
+               (rawFilename_.size() < 2 || rawFilename_[1] != ':'))
+                rawFilePath_ = filename.substr(0, split + 1) + rawFilename_;
+            else
+                rawFilePath_ = rawFilename_;
 
             baseName_ = filename;
             if(name_.size() > 0)
@@ -982,7 +1215,7 @@ void VolumeImportInfo::getVolumeInfoFromFirstSlice(const std::string &filename)
     shape_[0] = info.width();
     shape_[1] = info.height();
     resolution_[1] = -1.f; // assume images to be right-handed
-    pixelType_ = info.pixelType();
+    pixelType_ = info.getPixelType();
     numBands_ = info.numBands();
 }
 
@@ -1020,5 +1253,82 @@ MultiArrayIndex VolumeImportInfo::height() const { return shape_[1]; }
 MultiArrayIndex VolumeImportInfo::depth() const { return shape_[2]; }
 const std::string & VolumeImportInfo::name() const { return name_; }
 const std::string & VolumeImportInfo::description() const { return description_; }
+const std::string & VolumeImportInfo::getRawFilename() const { return rawFilePath_; }
+const char * VolumeImportInfo::getByteOrder() const { return byteOrder_.c_str(); }
+
+// class MemoryMappedFile
+
+#if defined(_WIN32)
+
+MemoryMappedFile::MemoryMappedFile(const std::string &filename)
+: data_(0), size_(0), file_(INVALID_HANDLE_VALUE), mapping_(0)
+{
+    std::string message("MemoryMappedFile(): Unable to map file '");
+    message += filename + "'.";
+
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    vigra_precondition(file_ != INVALID_HANDLE_VALUE, message.c_str());
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file_);
+        vigra_precondition(false, message.c_str());
+    }
+    size_ = (std::size_t)size.QuadPart;
+
+    // copy-on-write: changes to the view never reach the file
+    mapping_ = CreateFileMapping(file_, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    if(mapping_ != 0)
+        data_ = MapViewOfFile(mapping_, FILE_MAP_COPY, 0, 0, 0);
+    if(data_ == 0)
+    {
+        if(mapping_ != 0)
+            CloseHandle(mapping_);
+        CloseHandle(file_);
+        vigra_precondition(false, message.c_str());
+    }
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+}
+
+#else
+
+MemoryMappedFile::MemoryMappedFile(const std::string &filename)
+: data_(0), size_(0)
+{
+    std::string message("MemoryMappedFile(): Unable to map file '");
+    message += filename + "'.";
+
+    int fd = open(filename.c_str(), O_RDONLY);
+    vigra_precondition(fd >= 0, message.c_str());
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        vigra_precondition(false, message.c_str());
+    }
+    size_ = (std::size_t)info.st_size;
+
+    // copy-on-write: changes to the view never reach the file
+    void * data = mmap(0, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file open
+    vigra_precondition(data != MAP_FAILED, message.c_str());
+    data_ = data;
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+    munmap(data_, size_);
+}
+
+#endif
 
 } // namespace vigra
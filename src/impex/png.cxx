@@ -46,17 +46,24 @@
 
 #include "vigra/config.hxx"
 #include "vigra/sized_int.hxx"
+#include "vigra/threadpool.hxx"
 #include "void_vector.hxx"
 #include "auto_file.hxx"
 #include "png.hxx"
 #include "byteorder.hxx"
+#include "deflate.hxx"
 #include "error.hxx"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
 
 extern "C"
 {
 #include <png.h>
+#ifdef HasZLIB
+#include <zlib.h>
+#endif
 }
 
 #if PNG_LIBPNG_VER < 10201
@@ -66,6 +73,11 @@ extern "C"
 // TODO: per-scanline reading/writing
 
 namespace {
+    // one message per thread, so that several images can be
+    // written concurrently
+#ifdef VIGRA_HAS_STD_THREADS
+    thread_local
+#endif
     std::string png_error_message;
 }
 
@@ -519,6 +531,11 @@ namespace vigra {
         // resolution
         float x_resolution, y_resolution;
 
+        // zlib settings, and number of threads for compressing the image
+        int compression_level;
+        std::string compression_strategy;
+        int num_threads;
+
         // ctor, dtor
         PngEncoderImpl( const std::string & filename );
         ~PngEncoderImpl();
@@ -526,8 +543,98 @@ namespace vigra {
         // methods
         void finalize();
         void write();
+        void writeParallel( int threads );
     };
 
+#ifdef HasZLIB
+
+    // Filters and compresses the rows of one part of the image. The
+    // parts are independent parts of the zlib stream (see deflatePart()).
+    struct PngCompressRows
+    {
+        const UInt8 * data;
+        png_uint_32 rowbytes, height, rowsPerPart;
+        // bytes per pixel, and whether 16-bit samples must be swapped
+        // to the big endian byte order of PNG
+        unsigned int bpp;
+        bool swap;
+        int level, strategy;
+        ArrayVector<UInt8> * compressed;
+        uLong * checksums;
+
+        void copyRow( png_uint_32 y, UInt8 * dest ) const
+        {
+            const UInt8 * row = data + (std::size_t)y * rowbytes;
+            if ( swap ) {
+                for( png_uint_32 x = 0; x < rowbytes; x += 2 ) {
+                    dest[x] = row[x+1];
+                    dest[x+1] = row[x];
+                }
+            } else {
+                std::copy( row, row + rowbytes, dest );
+            }
+        }
+
+        static int paeth( int a, int b, int c )
+        {
+            int p = a + b - c;
+            int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            return ( pa <= pb && pa <= pc ) ? a : ( pb <= pc ) ? b : c;
+        }
+
+        // store the filter type and the filtered row in 'dest', using the
+        // filter with the smallest sum of absolute (signed byte) values, as libpng does
+        void filterRow( const UInt8 * row, const UInt8 * prior,
+                        UInt8 * scratch, UInt8 * dest ) const
+        {
+            unsigned long best = ~0ul;
+            for( int type = 0; type < 5; ++type ) {
+                unsigned long sum = 0;
+                for( png_uint_32 x = 0; x < rowbytes; ++x ) {
+                    int a = x >= bpp ? row[x-bpp] : 0,
+                        b = prior[x],
+                        c = x >= bpp ? prior[x-bpp] : 0,
+                        predictor = type == 0 ? 0
+                                  : type == 1 ? a
+                                  : type == 2 ? b
+                                  : type == 3 ? ( a + b ) >> 1
+                                  : paeth( a, b, c );
+                    UInt8 v = (UInt8)( row[x] - predictor );
+                    scratch[x] = v;
+                    sum += v < 128 ? v : 256 - v;
+                }
+                if ( sum < best ) {
+                    best = sum;
+                    dest[0] = (UInt8)type;
+                    std::copy( scratch, scratch + rowbytes, dest + 1 );
+                }
+            }
+        }
+
+        void operator()( int, std::ptrdiff_t part ) const
+        {
+            png_uint_32 begin = (png_uint_32)part * rowsPerPart,
+                        end = std::min( begin + rowsPerPart, height );
+            ArrayVector<UInt8> filtered( (std::size_t)( rowbytes + 1 ) * ( end - begin ) ),
+                               row( rowbytes ), prior( rowbytes, (UInt8)0 ),
+                               scratch( rowbytes );
+            if ( begin > 0 )
+                copyRow( begin - 1, prior.data() );
+            UInt8 * dest = filtered.data();
+            for( png_uint_32 y = begin; y < end; ++y, dest += rowbytes + 1 ) {
+                copyRow( y, row.data() );
+                filterRow( row.data(), prior.data(), scratch.data(), dest );
+                std::swap( row, prior );
+            }
+            checksums[part] = adler32( adler32( 0, Z_NULL, 0 ),
+                                       filtered.data(), (uInt)filtered.size() );
+            deflatePart( filtered.data(), filtered.size(), level, strategy,
+                         end == height, compressed[part] );
+        }
+    };
+
+#endif // HasZLIB
+
     PngEncoderImpl::PngEncoderImpl( const std::string & filename )
 #ifdef VIGRA_NEED_BIN_STREAMS
         : file( filename.c_str(), "wb" ),
@@ -536,7 +643,8 @@ namespace vigra {
 #endif
           bands(0),
           scanline(0), finalized(false),
-          x_resolution(0), y_resolution(0)
+          x_resolution(0), y_resolution(0),
+          compression_level(-1), num_threads(0)
     {
         png_error_message = "";
         // create png struct with user defined handlers
@@ -577,6 +685,14 @@ namespace vigra {
                       PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
                       PNG_FILTER_TYPE_DEFAULT );
 
+        // set zlib parameters
+        if (compression_level != -1)
+            png_set_compression_level(png, compression_level);
+#ifdef HasZLIB
+        if (compression_strategy != "")
+            png_set_compression_strategy(png, zlibStrategy(compression_strategy, Z_FILTERED));
+#endif
+
         // set resolution
         if (x_resolution > 0 && y_resolution > 0) {
             if (setjmp(png_jmpbuf(png)))
@@ -619,6 +735,14 @@ namespace vigra {
 
     void PngEncoderImpl::write()
     {
+#ifdef HasZLIB
+        int threads = ParallelOptions().numThreads(num_threads).getActualNumThreads();
+        if (threads > 1 && height > 1) {
+            writeParallel(threads);
+            return;
+        }
+#endif
+
         // prepare row pointers
         png_uint_32 row_stride = ( bit_depth >> 3 ) * width * components;
         void_vector<png_byte *>  row_pointers(height);
@@ -646,6 +770,77 @@ namespace vigra {
         png_write_end(png, info);
     }
 
+    void PngEncoderImpl::writeParallel( int threads )
+    {
+#ifdef HasZLIB
+        const png_uint_32 bpp = ( bit_depth >> 3 ) * components,
+                          rowbytes = bpp * width;
+        typedef void_vector<png_byte> vector_type;
+        vector_type & cbands = static_cast< vector_type & >(bands);
+
+        // one part per thread, but at most 256 MB of image data per part,
+        // so that each part fits into a single IDAT chunk
+        // (parts is const, because it is still needed after the setjmp() below)
+        const UIntBiggest size = (UIntBiggest)( rowbytes + 1 ) * height;
+        const png_uint_32 maxParts = std::min( std::max( (png_uint_32)threads,
+                                                         (png_uint_32)( size >> 28 ) + 1 ),
+                                               height ),
+                          rowsPerPart = ( height + maxParts - 1 ) / maxParts,
+                          parts = ( height + rowsPerPart - 1 ) / rowsPerPart;
+
+        PngCompressRows compress;
+        compress.data = cbands.data();
+        compress.rowbytes = rowbytes;
+        compress.height = height;
+        compress.rowsPerPart = rowsPerPart;
+        compress.bpp = bpp;
+        compress.swap = bit_depth == 16 &&
+                        byteorder().get_host_byteorder() == "little endian";
+        compress.level = compression_level;
+        compress.strategy = zlibStrategy( compression_strategy, Z_FILTERED );
+
+        ArrayVector<ArrayVector<UInt8> > compressed( parts );
+        ArrayVector<uLong> checksums( parts );
+        compress.compressed = compressed.data();
+        compress.checksums = checksums.data();
+        parallel_foreach( ParallelOptions().numThreads(threads), parts, compress );
+
+        // zlib header and (big endian) adler32 checksum of the whole stream
+        UInt8 header[2], trailer[4];
+        zlibHeader( compression_level, header );
+        uLong checksum = checksums[0];
+        for( png_uint_32 k = 1; k < parts; ++k ) {
+            png_uint_32 rows = std::min( rowsPerPart, height - k * rowsPerPart );
+            checksum = adler32_combine( checksum, checksums[k],
+                                        (z_off_t)( rowbytes + 1 ) * rows );
+        }
+        for( int k = 0; k < 4; ++k )
+            trailer[k] = (UInt8)( checksum >> ( 24 - 8 * k ) );
+
+        // write one IDAT chunk per part
+        if (setjmp(png_jmpbuf(png)))
+            vigra_postcondition( false, png_error_message.insert(0, "error in png_write_chunk(): ").c_str() );
+        for( png_uint_32 k = 0; k < parts; ++k ) {
+            png_uint_32 length = (png_uint_32)compressed[k].size() +
+                                 ( k == 0 ? 2 : 0 ) + ( k == parts - 1 ? 4 : 0 );
+            png_write_chunk_start( png, (png_bytep)"IDAT", length );
+            if ( k == 0 )
+                png_write_chunk_data( png, header, 2 );
+            png_write_chunk_data( png, compressed[k].data(), compressed[k].size() );
+            if ( k == parts - 1 )
+                png_write_chunk_data( png, trailer, 4 );
+            png_write_chunk_end( png );
+        }
+
+        // png_write_end() only accepts IDAT data written by libpng itself,
+        // so terminate the file directly (there are no chunks after the image data)
+        png_write_chunk( png, (png_bytep)"IEND", 0, 0 );
+        png_write_flush( png );
+#else
+        vigra_fail( "PngEncoderImpl::writeParallel(): zlib is not available." );
+#endif
+    }
+
     void PngEncoder::init( const std::string & filename )
     {
         pimpl = new PngEncoderImpl(filename);
@@ -694,6 +889,24 @@ namespace vigra {
         // nothing is settable => do nothing
     }
 
+    void PngEncoder::setCompressionLevel( int level )
+    {
+        VIGRA_IMPEX_FINALIZED(pimpl->finalized);
+        pimpl->compression_level = level;
+    }
+
+    void PngEncoder::setCompressionStrategy( const std::string & strategy )
+    {
+        VIGRA_IMPEX_FINALIZED(pimpl->finalized);
+        pimpl->compression_strategy = strategy;
+    }
+
+    void PngEncoder::setNumThreads( int n )
+    {
+        VIGRA_IMPEX_FINALIZED(pimpl->finalized);
+        pimpl->num_threads = n;
+    }
+
     void PngEncoder::setPosition( const Diff2D & pos )
     {
         VIGRA_IMPEX_FINALIZED(pimpl->finalized);
@@ -114,6 +114,9 @@ namespace vigra {
         void setHeight( unsigned int );
         void setNumBands( unsigned int );
         void setCompressionType( const std::string &, int = -1 );
+        void setCompressionLevel( int );
+        void setCompressionStrategy( const std::string & );
+        void setNumThreads( int );
         void setPixelType( const std::string & );
 
         void setPosition( const Diff2D & pos );
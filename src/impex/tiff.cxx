@@ -59,17 +59,24 @@
 #endif
 
 #include "vigra/sized_int.hxx"
+#include "vigra/threadpool.hxx"
 #include "error.hxx"
+#include "deflate.hxx"
 #include "tiff.hxx"
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 
 extern "C"
 {
 #include <tiff.h>
 #include <tiffio.h>
 #include <tiffvers.h>
+#ifdef HasZLIB
+#include <zlib.h>
+#endif
 }
 
 namespace vigra {
@@ -216,16 +223,43 @@ namespace vigra {
     {
         friend class TIFFDecoder;
 
+        // how the image data are fetched from the file
+        enum ReadMode { ReadScanlines, ReadStrips, ReadTiles };
+
+        ReadMode readmode;
+
+        // next file row to be decoded
         unsigned int scanline;
 
+        uint32 rowsperstrip, tilewidth, tileheight;
+
+        // the region of interest, defaults to the whole image
+        uint32 roi_x, roi_y, roi_width, roi_height;
+
+        // row stride of the buffers and horizontal position of the
+        // region in a buffer row (tiles are assembled cropped)
+        tsize_t bufferrowsize;
+        uint32 bufferxoffset;
+
+        // a single decoded tile, reused for all tiles (ReadTiles only)
+        tdata_t tilebuffer;
+
         std::string get_pixeltype_by_sampleformat() const;
         std::string get_pixeltype_by_datatype() const;
 
+        unsigned int numBuffers() const;
+        void allocateBuffers();
+        void readScanline();
+        void readStrip();
+        void readTileRow();
+
     public:
 
         TIFFDecoderImpl( const std::string & filename );
+        ~TIFFDecoderImpl();
 
         void init();
+        bool setRegionOfInterest( const Diff2D & ul, const Size2D & size );
 
         const void * currentScanlineOfBand( unsigned int band ) const;
         void nextScanline();
@@ -242,7 +276,18 @@ namespace vigra {
             vigra_precondition(0, msg.c_str());
         }
 
+        readmode = ReadScanlines;
         scanline = 0;
+        rowsperstrip = tilewidth = tileheight = 0;
+        bufferrowsize = 0;
+        bufferxoffset = 0;
+        tilebuffer = 0;
+    }
+
+    TIFFDecoderImpl::~TIFFDecoderImpl()
+    {
+        if ( tilebuffer != 0 )
+            _TIFFfree(tilebuffer);
     }
 
     std::string TIFFDecoderImpl::get_pixeltype_by_sampleformat() const
@@ -324,16 +369,19 @@ namespace vigra {
         TIFFGetField( tiff, TIFFTAG_IMAGEWIDTH, &width );
         TIFFGetField( tiff, TIFFTAG_IMAGELENGTH, &height );
 
-        // check for tiled TIFFs
-        uint32 tileWidth, tileHeight;
-        if( TIFFGetField( tiff, TIFFTAG_TILEWIDTH, &tileWidth ) &&
-            TIFFGetField( tiff, TIFFTAG_TILELENGTH, &tileHeight ) )
-            vigra_precondition( (tileWidth == width) && (tileHeight == height),
-                                "TIFFDecoderImpl::init(): "
-                                "Cannot read tiled TIFFs (not implemented)." );
+        roi_x = roi_y = 0;
+        roi_width = width;
+        roi_height = height;
 
-        // find out strip heights
-        stripheight = 1; // now using scanline interface instead of strip interface
+        // tiled TIFFs are read one row of tiles at a time
+        if( TIFFIsTiled( tiff ) ) {
+            TIFFGetField( tiff, TIFFTAG_TILEWIDTH, &tilewidth );
+            TIFFGetField( tiff, TIFFTAG_TILELENGTH, &tileheight );
+            readmode = ReadTiles;
+        } else {
+            TIFFGetFieldDefaulted( tiff, TIFFTAG_ROWSPERSTRIP, &rowsperstrip );
+            rowsperstrip = std::min( rowsperstrip, height );
+        }
 
         // get samples_per_pixel
         samples_per_pixel = 0;
@@ -467,6 +515,10 @@ namespace vigra {
             // get fillorder
             if ( !TIFFGetField( tiff, TIFFTAG_FILLORDER, &fillorder ) )
                 fillorder = FILLORDER_MSB2LSB;
+
+            vigra_precondition( readmode != ReadTiles,
+                                "TIFFDecoderImpl::init(): "
+                                "Cannot read tiled bilevel TIFFs (not implemented)." );
         }
 
         // make sure the LogLuv has correct pixeltype because only float is supported
@@ -540,28 +592,146 @@ namespace vigra {
             iccProfile.swap(iccData);
         }
 
-        // allocate data buffers
-        const unsigned int stripsize = TIFFScanlineSize(tiff);
-        if ( planarconfig == PLANARCONFIG_SEPARATE ) {
-            stripbuffer = new tdata_t[samples_per_pixel];
-            for( unsigned int i = 0; i < samples_per_pixel; ++i ) {
-                stripbuffer[i] = 0;
-            }
-            for( unsigned int i = 0; i < samples_per_pixel; ++i ) {
-                stripbuffer[i] = _TIFFmalloc(stripsize);
-                if(stripbuffer[i] == 0)
-                    throw std::bad_alloc();
-            }
+        // Whole strips are decoded at once unless they are so large
+        // that they would hog memory (e.g. single-strip files), in which
+        // case the scanline interface is used. Bilevel images are
+        // always read by scanline.
+        if ( readmode != ReadTiles && bits_per_sample != 1 &&
+             TIFFStripSize(tiff) <= (1 << 24) )
+            readmode = ReadStrips;
+
+        // the data buffers are allocated by the first nextScanline(),
+        // because setRegionOfInterest() may still change their size
+        stripheight = 0;
+        stripindex = stripheight;
+    }
+
+    bool TIFFDecoderImpl::setRegionOfInterest( const Diff2D & ul,
+                                               const Size2D & size )
+    {
+        vigra_precondition( stripbuffer == 0,
+            "TIFFDecoderImpl::setRegionOfInterest(): "
+            "must be called before the first scanline is read." );
+        vigra_precondition( ul.x >= 0 && ul.y >= 0 && size.x > 0 && size.y > 0 &&
+                            (uint32)(ul.x + size.x) <= width &&
+                            (uint32)(ul.y + size.y) <= height,
+            "TIFFDecoderImpl::setRegionOfInterest(): "
+            "region must be non-empty and inside the image." );
+
+        // bits are not addressable by the scanline pointers
+        if ( bits_per_sample == 1 )
+            return false;
+
+        roi_x = ul.x;
+        roi_y = ul.y;
+        roi_width = size.x;
+        roi_height = size.y;
+        return true;
+    }
+
+    unsigned int TIFFDecoderImpl::numBuffers() const
+    {
+        return planarconfig == PLANARCONFIG_SEPARATE ? samples_per_pixel : 1;
+    }
+
+    void TIFFDecoderImpl::allocateBuffers()
+    {
+        tsize_t buffersize;
+        if ( readmode == ReadTiles ) {
+            // one row of tiles, cropped to the region of interest
+            const unsigned int pixelsize = ( bits_per_sample / 8 ) *
+                ( planarconfig == PLANARCONFIG_SEPARATE ? 1 : samples_per_pixel );
+            bufferrowsize = roi_width * pixelsize;
+            bufferxoffset = 0;
+            buffersize = bufferrowsize * tileheight;
+            tilebuffer = _TIFFmalloc( TIFFTileSize(tiff) );
+            if(tilebuffer == 0)
+                throw std::bad_alloc();
         } else {
-            stripbuffer = new tdata_t[1];
-            stripbuffer[0] = 0;
-            stripbuffer[0] = _TIFFmalloc(stripsize);
-            if(stripbuffer[0] == 0)
+            bufferrowsize = TIFFScanlineSize(tiff);
+            bufferxoffset = roi_x;
+            buffersize = readmode == ReadStrips
+                             ? TIFFStripSize(tiff)
+                             : bufferrowsize;
+        }
+
+        const unsigned int n = numBuffers();
+        stripbuffer = new tdata_t[n];
+        for( unsigned int i = 0; i < n; ++i ) {
+            stripbuffer[i] = 0;
+        }
+        for( unsigned int i = 0; i < n; ++i ) {
+            stripbuffer[i] = _TIFFmalloc(buffersize);
+            if(stripbuffer[i] == 0)
                 throw std::bad_alloc();
         }
 
-        // let the codec read a new strip
-        stripindex = stripheight;
+        scanline = roi_y;
+    }
+
+    void TIFFDecoderImpl::readScanline()
+    {
+        if ( planarconfig == PLANARCONFIG_SEPARATE ) {
+            for( unsigned int i = 0; i < samples_per_pixel; ++i )
+                TIFFReadScanline(tiff, stripbuffer[i], scanline, i);
+        } else {
+            TIFFReadScanline( tiff, stripbuffer[0], scanline, 0);
+        }
+        stripindex = 0;
+        stripheight = 1;
+        ++scanline;
+    }
+
+    void TIFFDecoderImpl::readStrip()
+    {
+        // the first strip of a region may start above the region
+        const uint32 stripstart = ( scanline / rowsperstrip ) * rowsperstrip;
+        const uint32 rows = std::min( rowsperstrip, height - stripstart );
+
+        for( unsigned int i = 0; i < numBuffers(); ++i ) {
+            tsize_t success = TIFFReadEncodedStrip( tiff,
+                TIFFComputeStrip( tiff, scanline, i ), stripbuffer[i],
+                (tsize_t)-1 );
+            vigra_postcondition( success != -1,
+                "importImage(): Unable to read TIFF strip." );
+        }
+
+        stripindex = scanline - stripstart;
+        stripheight = std::min( rows, roi_y + roi_height - stripstart );
+        scanline = stripstart + rows;
+    }
+
+    void TIFFDecoderImpl::readTileRow()
+    {
+        const uint32 tilerowstart = ( scanline / tileheight ) * tileheight;
+        const uint32 rows = std::min( tileheight, height - tilerowstart );
+        const unsigned int pixelsize = ( bits_per_sample / 8 ) *
+            ( planarconfig == PLANARCONFIG_SEPARATE ? 1 : samples_per_pixel );
+        const tsize_t tilerowsize = TIFFTileRowSize(tiff);
+
+        // decode only the tiles that intersect the region
+        const uint32 roi_end = roi_x + roi_width;
+        for( uint32 tx = ( roi_x / tilewidth ) * tilewidth; tx < roi_end;
+             tx += tilewidth ) {
+            const uint32 x0 = std::max( tx, roi_x );
+            const uint32 x1 = std::min( tx + tilewidth, roi_end );
+            for( unsigned int i = 0; i < numBuffers(); ++i ) {
+                tsize_t success = TIFFReadTile( tiff, tilebuffer, tx, tilerowstart, 0, i );
+                vigra_postcondition( success != -1,
+                    "importImage(): Unable to read TIFF tile." );
+                const UInt8 * src = static_cast< UInt8 * >(tilebuffer)
+                                        + ( x0 - tx ) * pixelsize;
+                UInt8 * dest = static_cast< UInt8 * >(stripbuffer[i])
+                                        + ( x0 - roi_x ) * pixelsize;
+                for( uint32 r = 0; r < rows; ++r,
+                     src += tilerowsize, dest += bufferrowsize )
+                    std::memcpy( dest, src, ( x1 - x0 ) * pixelsize );
+            }
+        }
+
+        stripindex = scanline - tilerowstart;
+        stripheight = std::min( rows, roi_y + roi_height - tilerowstart );
+        scanline = tilerowstart + rows;
     }
 
     const void *
@@ -573,31 +743,39 @@ namespace vigra {
             // XXX probably wrong
             return buf + ( stripindex * width ) / 8;
         } else {
+            const unsigned int atomicbytes = bits_per_sample / 8;
             if ( planarconfig == PLANARCONFIG_SEPARATE ) {
                 UInt8 * const buf
                     = static_cast< UInt8 * >(stripbuffer[band]);
-                return buf + ( stripindex * width ) * ( bits_per_sample / 8 );
+                return buf + stripindex * bufferrowsize
+                    + bufferxoffset * atomicbytes;
             } else {
                 UInt8 * const buf
                     = static_cast< UInt8 * >(stripbuffer[0]);
-                return buf + ( band + stripindex * width * samples_per_pixel )
-                    * ( bits_per_sample / 8 );
+                return buf + stripindex * bufferrowsize
+                    + ( band + bufferxoffset * samples_per_pixel ) * atomicbytes;
             }
         }
     }
 
     void TIFFDecoderImpl::nextScanline()
     {
+        if ( stripbuffer == 0 )
+            allocateBuffers();
+
         // eventually read a new strip
         if ( ++stripindex >= stripheight ) {
-            stripindex = 0;
 
-            if ( planarconfig == PLANARCONFIG_SEPARATE ) {
-                const tsize_t size = TIFFScanlineSize(tiff);
-                for( unsigned int i = 0; i < samples_per_pixel; ++i )
-                    TIFFReadScanline(tiff, stripbuffer[i], scanline++, size);
-            } else {
-                TIFFReadScanline( tiff, stripbuffer[0], scanline++, 0);
+            switch ( readmode ) {
+                case ReadScanlines:
+                    readScanline();
+                    break;
+                case ReadStrips:
+                    readStrip();
+                    break;
+                case ReadTiles:
+                    readTileRow();
+                    break;
             }
 
             // XXX handle bilevel images
@@ -606,10 +784,10 @@ namespace vigra {
             if ( photometric == PHOTOMETRIC_MINISWHITE &&
                  samples_per_pixel == 1 && pixeltype == "UINT8" ) {
 
-                UInt8 * buf = static_cast< UInt8 * >(stripbuffer[0]);
-                const unsigned int n = TIFFScanlineSize(tiff);
-
-                // invert every pixel
+                // invert every pixel of the rows still to be delivered
+                UInt8 * buf = static_cast< UInt8 * >(stripbuffer[0])
+                                  + stripindex * bufferrowsize;
+                const unsigned int n = ( stripheight - stripindex ) * bufferrowsize;
                 for ( unsigned int i = 0; i < n; ++i, ++buf )
                     *buf = 0xff - *buf;
             }
@@ -635,12 +813,12 @@ namespace vigra {
 
     unsigned int TIFFDecoder::getWidth() const
     {
-        return pimpl->width;
+        return pimpl->roi_width;
     }
 
     unsigned int TIFFDecoder::getHeight() const
     {
-        return pimpl->height;
+        return pimpl->roi_height;
     }
 
     unsigned int TIFFDecoder::getNumBands() const
@@ -684,6 +862,11 @@ namespace vigra {
             1 : pimpl->samples_per_pixel;
     }
 
+    bool TIFFDecoder::setRegionOfInterest( const Diff2D & ul, const Size2D & size )
+    {
+        return pimpl->setRegionOfInterest(ul, size);
+    }
+
     const void * TIFFDecoder::currentScanlineOfBand( unsigned int band ) const
     {
         return pimpl->currentScanlineOfBand(band);
@@ -697,6 +880,27 @@ namespace vigra {
     void TIFFDecoder::close() {}
     void TIFFDecoder::abort() {}
 
+#ifdef HasZLIB
+
+    // Compresses a batch of strips into independent zlib streams,
+    // as they are stored in DEFLATE compressed TIFF files.
+    struct TIFFCompressStrips
+    {
+        const UInt8 * data;
+        tsize_t stripsize;
+        const tsize_t * sizes;
+        int level, strategy;
+        ArrayVector<UInt8> * compressed;
+
+        void operator()( int, std::ptrdiff_t k ) const
+        {
+            zlibCompress( data + k * stripsize, sizes[k], level, strategy,
+                          compressed[k] );
+        }
+    };
+
+#endif // HasZLIB
+
     // this encoder always writes interleaved tiff files
     class TIFFEncoderImpl : public TIFFCodecImpl
     {
@@ -707,12 +911,29 @@ namespace vigra {
         unsigned short tiffcomp;
         bool finalized;
 
+        // zlib settings, and number of threads for compressing strips
+        int complevel;
+        std::string compstrategy;
+        int numthreads;
+
+        // when DEFLATE compression is done here rather than by libtiff,
+        // the strips are collected in 'batchbuffer' (one strip per thread)
+        // and compressed concurrently by 'pool'
+        bool compressstrips;
+        std::auto_ptr<ThreadPool> pool;
+        ArrayVector<UInt8> batchbuffer;
+        ArrayVector<tsize_t> batchsizes;
+        unsigned int batchstrips;
+        tsize_t stripsize;
+
     public:
 
         // ctor, dtor
 
         TIFFEncoderImpl( const std::string & filename )
-            : tiffcomp(COMPRESSION_NONE), finalized(false)
+            : tiffcomp(COMPRESSION_NONE), finalized(false),
+              complevel(-1), numthreads(0),
+              compressstrips(false), batchstrips(0), stripsize(0)
         {
             tiff = TIFFOpen( filename.c_str(), "w" );
             if (!tiff)
@@ -734,18 +955,32 @@ namespace vigra {
         void * currentScanlineOfBand( unsigned int band ) const
         {
             const unsigned int atomicbytes = bits_per_sample >> 3;
-            UInt8 * buf = ( UInt8 * ) stripbuffer[0];
+            UInt8 * buf = compressstrips
+                              ? const_cast< UInt8 * >( batchbuffer.data() ) + batchstrips * stripsize
+                              : ( UInt8 * ) stripbuffer[0];
             return buf + atomicbytes *
                 ( width * samples_per_pixel * stripindex + band );
         }
 
+        void writeStripBatch();
+
         void nextScanline()
         {
             // compute the number of rows in the current strip
             unsigned int rows = ( strip + 1 ) * stripheight > height ?
                 height - strip * stripheight : stripheight;
 
-            if ( ++stripindex >= rows ) {
+            if ( ++stripindex >= rows && compressstrips ) {
+
+                // add the strip to the batch, and compress the batch when
+                // it is full or the image is complete
+                stripindex = 0;
+                batchsizes[batchstrips++] = TIFFVStripSize( tiff, rows );
+                ++strip;
+                if ( batchstrips == batchsizes.size() || strip == TIFFNumberOfStrips( tiff ) )
+                    writeStripBatch();
+            }
+            else if ( stripindex >= rows ) {
 
                 // write next strip
                 stripindex = 0;
@@ -782,6 +1017,30 @@ namespace vigra {
             tiffcomp = COMPRESSION_DEFLATE;
     }
 
+    void TIFFEncoderImpl::writeStripBatch()
+    {
+#ifdef HasZLIB
+        ArrayVector<ArrayVector<UInt8> > compressed( batchstrips );
+        TIFFCompressStrips compress;
+        compress.data = batchbuffer.data();
+        compress.stripsize = stripsize;
+        compress.sizes = batchsizes.data();
+        compress.level = complevel;
+        compress.strategy = zlibStrategy( compstrategy, Z_DEFAULT_STRATEGY );
+        compress.compressed = compressed.data();
+        parallel_foreach( *pool, batchstrips, compress );
+
+        // libtiff only stores the compressed strips
+        for( unsigned int k = 0; k < batchstrips; ++k ) {
+            tsize_t success = TIFFWriteRawStrip( tiff, strip - batchstrips + k,
+                                                 compressed[k].data(), compressed[k].size() );
+            vigra_postcondition(success != -1,
+                    "exportImage(): Unable to write TIFF data.");
+        }
+#endif
+        batchstrips = 0;
+    }
+
     void TIFFEncoderImpl::finalizeSettings()
     {
         // decide if we should write Grey, or RGB files
@@ -887,12 +1146,31 @@ namespace vigra {
                          iccProfile.size(), iccProfile.begin());
         }
 
+        // zlib settings: libtiff can set the level, but only our own
+        // compression supports a strategy and several threads
+        if ( tiffcomp == COMPRESSION_DEFLATE ) {
+            if ( complevel != -1 )
+                TIFFSetField( tiff, TIFFTAG_ZIPQUALITY, complevel );
+#ifdef HasZLIB
+            int threads = ParallelOptions().numThreads( numthreads ).getActualNumThreads();
+            compressstrips = threads > 1 || compstrategy != "";
+            if ( compressstrips ) {
+                stripsize = TIFFStripSize( tiff );
+                batchsizes.resize( std::max( threads, 1 ) );
+                batchbuffer.resize( batchsizes.size() * stripsize );
+                pool.reset( new ThreadPool( threads ) );
+            }
+#endif
+        }
+
         // alloc memory
         stripbuffer = new tdata_t[1];
         stripbuffer[0] = 0;
-        stripbuffer[0] = _TIFFmalloc( TIFFStripSize(tiff) );
-        if(stripbuffer[0] == 0)
-            throw std::bad_alloc();
+        if ( !compressstrips ) {
+            stripbuffer[0] = _TIFFmalloc( TIFFStripSize(tiff) );
+            if(stripbuffer[0] == 0)
+                throw std::bad_alloc();
+        }
 
         finalized = true;
     }
@@ -937,6 +1215,24 @@ namespace vigra {
         pimpl->setCompressionType( comp, quality );
     }
 
+    void TIFFEncoder::setCompressionLevel( int level )
+    {
+        VIGRA_IMPEX_FINALIZED(pimpl->finalized);
+        pimpl->complevel = level;
+    }
+
+    void TIFFEncoder::setCompressionStrategy( const std::string & strategy )
+    {
+        VIGRA_IMPEX_FINALIZED(pimpl->finalized);
+        pimpl->compstrategy = strategy;
+    }
+
+    void TIFFEncoder::setNumThreads( int n )
+    {
+        VIGRA_IMPEX_FINALIZED(pimpl->finalized);
+        pimpl->numthreads = n;
+    }
+
     void TIFFEncoder::setPixelType( const std::string & pixeltype )
     {
         VIGRA_IMPEX_FINALIZED(pimpl->finalized);
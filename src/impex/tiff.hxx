@@ -84,6 +84,8 @@ namespace vigra {
         float getXResolution() const;
         float getYResolution() const;
 
+        bool setRegionOfInterest( const Diff2D & ul, const Size2D & size );
+
         const void * currentScanlineOfBand( unsigned int ) const;
         void nextScanline();
 
@@ -111,6 +113,9 @@ namespace vigra {
         void setNumBands( unsigned int );
 
         void setCompressionType( const std::string &, int = -1 );
+        void setCompressionLevel( int );
+        void setCompressionStrategy( const std::string & );
+        void setNumThreads( int );
         void setPixelType( const std::string & );
 
         void setPosition( const vigra::Diff2D & pos );
@@ -80,6 +80,22 @@ struct UnaryRandomFunctor
 };
 
 
+template <class Features>
+struct PredictLabelFunctor
+{
+    vigra::RandomForest<> const *   rf;
+    Features                        features;
+    MultiArrayView<2, double>       labels;
+
+    void operator()(int, std::ptrdiff_t row) const
+    {
+        // all threads share the same const forest
+        MultiArrayView<2, double> l(labels);
+        l(row, 0) = rf->predictLabel(rowVector(features, row));
+    }
+};
+
+
 struct ClassifierTest
 {
     RF_Test_Training_Data data;
@@ -539,6 +555,467 @@ struct ClassifierTest
         std::cerr << "done \n";
     }
 
+    /** checks that parallel prediction gives the same result as serial 
+     * prediction, also with early stopping
+     */
+    void RFparallelPredictionTest()
+    {
+        std::cerr << "RFparallelPredictionTest()....";
+        typedef MultiArrayShape<2>::type Shp;
+        int ii = data.size() - 3; // this is the pina_indians dataset
+        vigra::RandomForest<>
+            RF(vigra::RandomForestOptions().tree_count(32)); 
+        RF.learn( data.features(ii),
+                  data.labels(ii),
+                  rf_default(),
+                  rf_default(),
+                  rf_default(),
+                  vigra::RandomMT19937(1));
+
+        int rows = data.features(ii).shape(0),
+            classes = data.ClassIter(ii).size();
+        MultiArray<2, double> prob(Shp(rows, classes)), 
+                              stopProb(Shp(rows, classes));
+        MultiArray<2, double> labels(Shp(rows, 1));
+        MultiArray<2, Int32>  stopLabels(Shp(rows, 1));
+        StopIfMargin stopIfMargin(0.5);
+        StopAfterVoteCount stopAfterVoteCount(0.5);
+        RF.predictProbabilities(data.features(ii), prob);
+        RF.predictProbabilities(data.features(ii), stopProb, stopIfMargin);
+        RF.predictLabels(data.features(ii), labels);
+        RF.predictLabels(data.features(ii), stopLabels, stopAfterVoteCount);
+        should(stopIfMargin.depths.size() > 0);
+
+        for(int threads = 0; threads < 5; ++threads)
+        {
+            ParallelOptions options;
+            options.numThreads(threads);
+
+            MultiArray<2, double> pprob(Shp(rows, classes)), 
+                                  pstopProb(Shp(rows, classes));
+            MultiArray<2, double> plabels(Shp(rows, 1));
+            MultiArray<2, Int32>  pstopLabels(Shp(rows, 1));
+            StopIfMargin pstopIfMargin(0.5);
+            StopAfterVoteCount pstopAfterVoteCount(0.5);
+
+            RF.predictProbabilities(data.features(ii), pprob, options);
+            RF.predictProbabilities(data.features(ii), pstopProb, pstopIfMargin, options);
+            RF.predictLabels(data.features(ii), plabels, ParallelOptions().numThreads(threads));
+            RF.predictLabels(data.features(ii), pstopLabels, pstopAfterVoteCount, options);
+
+            shouldEqual(pprob, prob);
+            shouldEqual(pstopProb, stopProb);
+            shouldEqual(plabels, labels);
+            shouldEqual(pstopLabels, stopLabels);
+            shouldEqual(pstopIfMargin.depths, stopIfMargin.depths);
+            shouldEqual(pstopAfterVoteCount.depths, stopAfterVoteCount.depths);
+        }
+        std::cerr << "done \n";
+    }
+
+    void RFparallelLearnTest()
+    {
+        std::cerr << "RFparallelLearnTest()....";
+        typedef MultiArrayShape<2>::type Shp;
+        int ii = data.size() - 3; // this is the pina_indians dataset
+
+        vigra::RandomForest<> RF(vigra::RandomForestOptions().tree_count(16));
+        rf::visitors::OOB_Error oob_v;
+        rf::visitors::VariableImportanceVisitor varimp_v;
+        RF.learn( data.features(ii),
+                  data.labels(ii),
+                  rf::visitors::create_visitor(oob_v, varimp_v),
+                  rf_default(),
+                  rf_default(),
+                  vigra::RandomMT19937(1),
+                  ParallelOptions().numThreads(0));
+        should(oob_v.oob_breiman > 0.0 && oob_v.oob_breiman < 0.5);
+
+        int columns = varimp_v.variable_importance_.shape(1);
+        for(int threads = 1; threads < 5; ++threads)
+        {
+            vigra::RandomForest<> pRF(vigra::RandomForestOptions().tree_count(16));
+            rf::visitors::OOB_Error poob_v;
+            rf::visitors::VariableImportanceVisitor pvarimp_v;
+            pRF.learn( data.features(ii),
+                       data.labels(ii),
+                       rf::visitors::create_visitor(poob_v, pvarimp_v),
+                       rf_default(),
+                       rf_default(),
+                       vigra::RandomMT19937(1),
+                       ParallelOptions().numThreads(threads));
+
+            shouldEqual(pRF.tree_count(), RF.tree_count());
+            for(int k=0; k<RF.tree_count(); ++k)
+            {
+                should(pRF.trees_[k].topology_ == RF.trees_[k].topology_);
+                should(pRF.trees_[k].parameters_ == RF.trees_[k].parameters_);
+            }
+            shouldEqual(poob_v.oob_breiman, oob_v.oob_breiman);
+
+            // permutation importance is computed in tree order, whereas the
+            // Gini decrease (last column) is accumulated in arbitrary order
+            shouldEqual(pvarimp_v.variable_importance_.shape(), 
+                        varimp_v.variable_importance_.shape());
+            should(pvarimp_v.variable_importance_.subarray(Shp(0, 0), Shp(RF.column_count(), columns-1)) ==
+                   varimp_v.variable_importance_.subarray(Shp(0, 0), Shp(RF.column_count(), columns-1)));
+            for(int k=0; k<RF.column_count(); ++k)
+                shouldEqualTolerance(pvarimp_v.variable_importance_(k, columns-1),
+                                     varimp_v.variable_importance_(k, columns-1), 1e-10);
+        }
+        std::cerr << "done \n";
+    }
+
+    void RFcompiledTreeTest()
+    {
+        std::cerr << "RFcompiledTreeTest()....";
+        typedef MultiArrayShape<2>::type Shp;
+        for(int ii = 0; ii < data.size(); ++ii)
+        {
+            vigra::RandomForest<> RF(vigra::RandomForestOptions().tree_count(8));
+            RF.learn( data.features(ii),
+                      data.labels(ii),
+                      rf_default(),
+                      rf_default(),
+                      rf_default(),
+                      vigra::RandomMT19937(1));
+            should(RF.is_compiled());
+
+            int rows = data.features(ii).shape(0),
+                classes = RF.class_count();
+            for(int k=0; k<RF.tree_count(); ++k)
+            {
+                detail::CompiledDecisionTree const & tree = RF.compiled_trees_[k];
+                // breadth-first order: children follow their parents
+                for(unsigned int n=0; n<tree.nodes_.size(); ++n)
+                    if(tree.nodes_[n].column >= 0)
+                        should(tree.nodes_[n].child > (int)n && 
+                               tree.nodes_[n].child+1 < (int)tree.nodes_.size());
+
+                for(int row=0; row<rows; ++row)
+                {
+                    ArrayVector<double>::const_iterator 
+                        w  = RF.trees_[k].predict(rowVector(data.features(ii), row)),
+                        cw = tree.predict(rowVector(data.features(ii), row));
+                    shouldEqualSequence(cw-1, cw+classes, w-1);
+                }
+            }
+
+            vigra::RandomForest<> uncompiledRF(RF);
+            uncompiledRF.compiled_trees_.clear();
+            should(!uncompiledRF.is_compiled());
+
+            MultiArray<2, double> prob(Shp(rows, classes)), 
+                                  uncompiledProb(Shp(rows, classes));
+            RF.predictProbabilities(data.features(ii), prob);
+            uncompiledRF.predictProbabilities(data.features(ii), uncompiledProb);
+            shouldEqual(prob, uncompiledProb);
+        }
+        std::cerr << "done \n";
+    }
+
+    void RFblockedPredictionTest()
+    {
+        std::cerr << "RFblockedPredictionTest()....";
+        typedef MultiArrayShape<2>::type Shp;
+        int ii = data.size() - 3; // this is the pina_indians dataset
+        vigra::RandomForest<> RF(vigra::RandomForestOptions().tree_count(16));
+        RF.learn( data.features(ii),
+                  data.labels(ii),
+                  rf_default(),
+                  rf_default(),
+                  rf_default(),
+                  vigra::RandomMT19937(1));
+        should(RF.is_compiled());
+        vigra::RandomForest<> rowwiseRF(RF);
+        rowwiseRF.compiled_trees_.clear();
+
+        int classes = RF.class_count();
+        MultiArray<2, float> ffeatures(data.features(ii));
+        // row counts around the minimum (8) and maximum (64) tile size
+        int sizes[] = { 1, 7, 8, 63, 64, 65, 130, static_cast<int>(data.features(ii).shape(0)) - 3 };
+        for(int s=0; s<8; ++s)
+        {
+            MultiArrayView<2, double, StridedArrayTag> features = 
+                data.features(ii).subarray(Shp(3, 0), Shp(3+sizes[s], RF.column_count()));
+            MultiArray<2, double> prob(Shp(sizes[s], classes)), 
+                                  rowwiseProb(Shp(sizes[s], classes));
+            RF.predictProbabilities(features, prob);
+            rowwiseRF.predictProbabilities(features, rowwiseProb);
+            shouldEqual(prob, rowwiseProb);
+
+            MultiArray<2, float> fprob(Shp(sizes[s], classes)), 
+                                 rowwiseFProb(Shp(sizes[s], classes));
+            MultiArrayView<2, float> ffeaturesView = 
+                ffeatures.subarray(Shp(3, 0), Shp(3+sizes[s], RF.column_count()));
+            RF.predictProbabilities(ffeaturesView, fprob);
+            rowwiseRF.predictProbabilities(ffeaturesView, rowwiseFProb);
+            shouldEqual(fprob, rowwiseFProb);
+
+            // predictLabels() classifies blocks of rows
+            MultiArray<2, double> labels(Shp(sizes[s], 1)), 
+                                  rowwiseLabels(Shp(sizes[s], 1));
+            RF.predictLabels(features, labels);
+            for(int k=0; k<sizes[s]; ++k)
+                rowwiseLabels(k, 0) = rowwiseRF.predictLabel(rowVector(features, k));
+            shouldEqual(labels, rowwiseLabels);
+        }
+        {
+            // too many columns for the stack buffer of the tiles
+            int rows = 300, columns = 50;
+            MultiArray<2, double> features(Shp(rows, columns)), labels(Shp(rows, 1));
+            for(int k=0; k<rows; ++k)
+            {
+                for(int c=0; c<columns; ++c)
+                    features(k, c) = (k*(c+1)) % 17;
+                labels(k, 0) = (features(k, 3) + features(k, 40)) > 16;
+            }
+            vigra::RandomForest<> wideRF(vigra::RandomForestOptions().tree_count(8));
+            wideRF.learn(features, labels, rf_default(), rf_default(), rf_default(),
+                         vigra::RandomMT19937(1));
+            should(wideRF.is_compiled());
+            vigra::RandomForest<> rowwiseWideRF(wideRF);
+            rowwiseWideRF.compiled_trees_.clear();
+            MultiArray<2, double> prob(Shp(rows, 2)), rowwiseProb(Shp(rows, 2));
+            wideRF.predictProbabilities(features, prob);
+            rowwiseWideRF.predictProbabilities(features, rowwiseProb);
+            shouldEqual(prob, rowwiseProb);
+        }
+        std::cerr << "done \n";
+    }
+
+    void RFfloatFeatureTest()
+    {
+        std::cerr << "RFfloatFeatureTest()....";
+        typedef MultiArrayShape<2>::type Shp;
+        {
+            // rounded thresholds give the same decisions for all floats
+            float fmax = std::numeric_limits<float>::max();
+            double t[] = { 0.1, -0.1, 1.0, 0.5 + 1e-12, 1e-40, -1e-40, 3e38, -3e38, 1e300, -1e300 };
+            for(int k=0; k<10; ++k)
+            {
+                float f = detail::roundThresholdUp(t[k]);
+                float x[] = { f, nextafterf(f, -fmax), nextafterf(f, fmax), 
+                              (float)t[k], 0.0f, fmax, -fmax };
+                for(int j=0; j<7; ++j)
+                    shouldEqual(x[j] < t[k], x[j] < f);
+            }
+        }
+
+        int ii = data.size() - 3; // this is the pina_indians dataset
+        MultiArray<2, float>  ffeatures(data.features(ii));
+        MultiArray<2, double> dfeatures(ffeatures);
+        int rows = ffeatures.shape(0);
+
+        // training on float features is equivalent to training on 
+        // the same values in double precision
+        vigra::RandomForest<> RF(vigra::RandomForestOptions().tree_count(16)),
+                              dRF(vigra::RandomForestOptions().tree_count(16));
+        RF.learn( ffeatures, data.labels(ii),
+                  rf_default(), rf_default(), rf_default(),
+                  vigra::RandomMT19937(1));
+        dRF.learn( dfeatures, data.labels(ii),
+                   rf_default(), rf_default(), rf_default(),
+                   vigra::RandomMT19937(1));
+        should(RF.is_compiled());
+        for(int k=0; k<RF.tree_count(); ++k)
+        {
+            should(RF.trees_[k].topology_ == dRF.trees_[k].topology_);
+            should(RF.trees_[k].parameters_ == dRF.trees_[k].parameters_);
+        }
+
+        // the single precision nodes take the same path as the original trees
+        int classes = RF.class_count();
+        for(int k=0; k<RF.tree_count(); ++k)
+        {
+            detail::CompiledDecisionTree const & tree = RF.compiled_trees_[k];
+            shouldEqual(tree.float_nodes_.size(), tree.nodes_.size());
+            for(int row=0; row<rows; ++row)
+            {
+                ArrayVector<double>::const_iterator 
+                    w  = RF.trees_[k].predict(rowVector(ffeatures, row)),
+                    cw = tree.predict(rowVector(ffeatures, row));
+                shouldEqualSequence(cw-1, cw+classes, w-1);
+            }
+        }
+        vigra::RandomForest<> uncompiledRF(RF);
+        uncompiledRF.compiled_trees_.clear();
+        MultiArray<2, float> prob(Shp(rows, classes)), 
+                             uncompiledProb(Shp(rows, classes));
+        RF.predictProbabilities(ffeatures, prob);
+        uncompiledRF.predictProbabilities(ffeatures, uncompiledProb);
+        shouldEqual(prob, uncompiledProb);
+
+        // the single precision nodes are shared read-only by all threads
+        MultiArray<2, double> labels(Shp(rows, 1)), parallelLabels(Shp(rows, 1));
+        uncompiledRF.predictLabels(ffeatures, labels);
+        for(int threads = 2; threads < 9; threads *= 2)
+        {
+            vigra::RandomForest<> copiedRF(RF);
+            PredictLabelFunctor<MultiArrayView<2, float> > f = { &copiedRF, ffeatures, parallelLabels };
+            parallel_foreach(ParallelOptions().numThreads(threads), rows, f);
+            shouldEqual(parallelLabels, labels);
+        }
+
+#ifdef HasHDF5
+        std::string filename = "float_rf.hdf5";
+        std::remove(filename.c_str());
+        rf_export_HDF5(RF, filename);
+        vigra::RandomForest<> RF2;
+        rf_import_HDF5(RF2, filename);
+        should(RF2.is_compiled());
+        MultiArray<2, float> prob2(Shp(rows, classes));
+        RF2.predictProbabilities(ffeatures, prob2);
+        shouldEqual(prob, prob2);
+        vigra::RandomForest<> RF3;
+        rf_import_HDF5(RF3, filename);
+        PredictLabelFunctor<MultiArrayView<2, float> > f = { &RF3, ffeatures, parallelLabels };
+        parallel_foreach(ParallelOptions().numThreads(4), rows, f);
+        shouldEqual(parallelLabels, labels);
+#endif
+        std::cerr << "done \n";
+    }
+
+    void RFreentrantPredictionTest()
+    {
+        std::cerr << "RFreentrantPredictionTest()....";
+        typedef MultiArrayShape<2>::type Shp;
+        {
+            int ii = data.size() - 3; // this is the pina_indians dataset
+            vigra::RandomForest<> RF(vigra::RandomForestOptions().tree_count(16));
+            RF.learn( data.features(ii),
+                      data.labels(ii),
+                      rf_default(),
+                      rf_default(),
+                      rf_default(),
+                      vigra::RandomMT19937(1));
+            int rows = data.features(ii).shape(0);
+            MultiArray<2, double> labels(Shp(rows, 1)), 
+                                  parallelLabels(Shp(rows, 1));
+            RF.predictLabels(data.features(ii), labels);
+
+            typedef MultiArrayView<2, double, StridedArrayTag> Features;
+            PredictLabelFunctor<Features> f = { &RF, data.features(ii), parallelLabels };
+            parallel_foreach(ParallelOptions().numThreads(4), rows, f);
+            shouldEqual(parallelLabels, labels);
+
+            // the same with float features, which use the single precision nodes
+            MultiArray<2, float> ffeatures(data.features(ii));
+            MultiArray<2, double> flabels(Shp(rows, 1)), 
+                                  parallelFLabels(Shp(rows, 1));
+            RF.predictLabels(ffeatures, flabels);
+            PredictLabelFunctor<MultiArrayView<2, float> > ff = { &RF, ffeatures, parallelFLabels };
+            parallel_foreach(ParallelOptions().numThreads(4), rows, ff);
+            shouldEqual(parallelFLabels, flabels);
+        }
+        {
+            // more classes than fit into the stack buffer of predictLabel()
+            int rows = 400, classes = 40;
+            MultiArray<2, double> features(Shp(rows, 2)), labels(Shp(rows, 1)),
+                                  rowLabels(Shp(rows, 1));
+            for(int k=0; k<rows; ++k)
+            {
+                features(k, 0) = k % classes;
+                features(k, 1) = k;
+                labels(k, 0)   = k % classes;
+            }
+            vigra::RandomForest<> RF(vigra::RandomForestOptions().tree_count(4));
+            RF.learn(features, labels, rf_default(), rf_default(), rf_default(),
+                     vigra::RandomMT19937(1));
+            shouldEqual(RF.class_count(), classes);
+            for(int k=0; k<rows; ++k)
+                rowLabels(k, 0) = RF.predictLabel(rowVector(features, k));
+            MultiArray<2, double> predicted(Shp(rows, 1));
+            RF.predictLabels(features, predicted);
+            shouldEqual(rowLabels, predicted);
+
+            MultiArray<2, float> ffeatures(features);
+            PredictLabelFunctor<MultiArrayView<2, float> > f = { &RF, ffeatures, predicted };
+            parallel_foreach(ParallelOptions().numThreads(4), rows, f);
+            shouldEqual(rowLabels, predicted);
+        }
+        std::cerr << "done \n";
+    }
+
+    void RFhistogramSplitTest()
+    {
+        std::cerr << "RFhistogramSplitTest()....";
+        typedef MultiArrayShape<2>::type Shp;
+        {
+            // few distinct values: all midpoints become cuts
+            MultiArray<2, double> features(Shp(6, 2));
+            double f[] = { 3.0, 1.0, 2.0, 1.0, 3.0, 2.0,
+                           0.5, 0.5, 0.5, 0.5, 0.5, 0.5 };
+            std::copy(f, f+12, features.begin());
+            rf::split::HistogramGiniSplit split(4);
+            split.bin(features);
+            shouldEqual(split.binned_->cut_counts_[0], 2);
+            shouldEqual(split.binned_->cut_counts_[1], 0);
+            shouldEqual(split.binned_->cuts_(0, 0), 1.5);
+            shouldEqual(split.binned_->cuts_(1, 0), 2.5);
+            UInt8 bins[] = { 2, 0, 1, 0, 2, 1 };
+            shouldEqualSequence(split.binned_->bins_.begin(), split.binned_->bins_.begin()+6, bins);
+            for(int k=0; k<6; ++k)
+                shouldEqual(split.binned_->bins_(k, 1), 0);
+
+            // copies (e.g. one per tree) share the bins, and keep them 
+            // when the original is destroyed or binned again
+            rf::split::HistogramGiniSplit copy, assigned;
+            {
+                rf::split::HistogramGiniSplit original(split);
+                should(original.binned_.get() == split.binned_.get());
+                copy = rf::split::HistogramGiniSplit(original);
+                assigned = original;
+            }
+            split.bin(features.subarray(Shp(0, 0), Shp(3, 2)));
+            shouldEqual(split.binned_->bins_.shape(0), 3);
+            should(copy.binned_.get() == assigned.binned_.get());
+            shouldEqual(copy.binned_->cut_counts_[0], 2);
+            shouldEqualSequence(copy.binned_->bins_.begin(), copy.binned_->bins_.begin()+6, bins);
+        }
+        {
+            // many distinct values: quantile bins of about equal size
+            MultiArray<2, double> features(Shp(1000, 1));
+            RandomMT19937 random(1);
+            for(int k=0; k<1000; ++k)
+                features(k, 0) = random.uniform();
+            rf::split::HistogramGiniSplit split(4);
+            split.bin(features);
+            shouldEqual(split.binned_->cut_counts_[0], 3);
+            int counts[4] = { 0, 0, 0, 0 };
+            for(int k=0; k<1000; ++k)
+            {
+                int b = split.binned_->bins_(k, 0);
+                ++counts[b];
+                if(b > 0)
+                    should(split.binned_->cuts_(b-1, 0) <= features(k, 0));
+                if(b < 3)
+                    should(features(k, 0) < split.binned_->cuts_(b, 0));
+            }
+            for(int b=0; b<4; ++b)
+                shouldEqual(counts[b], 250);
+        }
+
+        // the oob error must be comparable to the one of the exact search
+        for(int ii = 0; ii < data.size(); ++ii)
+        {
+            rf::visitors::OOB_Error oob_v;
+            vigra::RandomForest<> RF(vigra::RandomForestOptions().tree_count(100));
+            RF.learn( data.features(ii),
+                      data.labels(ii),
+                      rf::visitors::create_visitor(oob_v),
+                      rf::split::HistogramGiniSplit(),
+                      rf_default(),
+                      vigra::RandomMT19937(1));
+            std::ostringstream s1;
+            s1 << "Error - oob error of histogram split exceeds 3 sigma bound:  "
+               << oob_v.oob_breiman << "<-->" <<  data.oobError(ii) << std::endl;
+            vigra::detail::should_impl(oob_v.oob_breiman < data.oobError(ii) + 3*data.oobSTD(ii),
+                                       s1.str().c_str(), __FILE__, __LINE__);
+        }
+        std::cerr << "done \n";
+    }
+
 /** Learns The Refactored Random Forest with 100 trees 10 times and
  * 	calulates the mean oob error. The distribution of the oob error
  * 	is gaussian as a first approximation. The mean oob error should
@@ -953,9 +1430,16 @@ struct ClassifierTestSuite
         add( testCase( &ClassifierTest::RF_AlgorithmTest));
 #endif
         add( testCase( &ClassifierTest::RFresponseTest));
+        add( testCase( &ClassifierTest::RFparallelPredictionTest));
+        add( testCase( &ClassifierTest::RFparallelLearnTest));
+        add( testCase( &ClassifierTest::RFcompiledTreeTest));
+        add( testCase( &ClassifierTest::RFblockedPredictionTest));
+        add( testCase( &ClassifierTest::RFfloatFeatureTest));
+        add( testCase( &ClassifierTest::RFreentrantPredictionTest));
         
         add( testCase( &ClassifierTest::RFridgeRegressionTest));
         add( testCase( &ClassifierTest::RFSplitFunctorTest));
+        add( testCase( &ClassifierTest::RFhistogramSplitTest));
 #ifdef HasHDF5
         add( testCase( &ClassifierTest::HDF5ImpexTest));
 #endif
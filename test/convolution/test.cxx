@@ -99,6 +99,49 @@ vigra::DImage getUnsymmetricImage(){
     return src;
 }
 
+    // an accessor that doesn't qualify for the contiguous fast path of convolveLine()
+template <class T>
+struct GenericTestAccessor
+: public vigra::StandardConstValueAccessor<T>
+{};
+
+template <class T, class KernelType>
+void checkConvolveLineFastPath(vigra::Kernel1D<KernelType> const & kernel)
+{
+    static const vigra::BorderTreatmentMode modes[] = {
+        vigra::BORDER_TREATMENT_AVOID, vigra::BORDER_TREATMENT_CLIP,
+        vigra::BORDER_TREATMENT_REPEAT, vigra::BORDER_TREATMENT_REFLECT,
+        vigra::BORDER_TREATMENT_WRAP };
+    static const int sizes[] = { 9, 17, 64, 65, 143, 300 };
+
+    for(int s=0; s<6; ++s)
+    {
+        int w = sizes[s];
+        if(w < std::max(kernel.right(), -kernel.left()) + 1)
+            continue;
+
+        vigra::ArrayVector<T> src(w);
+        for(int x=0; x<w; ++x)
+            src[x] = (T)((x * 37 + 11) % 101);
+
+        for(int m=0; m<5; ++m)
+        {
+            vigra::ArrayVector<float> fast(w, -1.0f), generic(w, -1.0f);
+
+            vigra::convolveLine(src.begin(), src.end(), vigra::StandardConstValueAccessor<T>(),
+                                fast.begin(), vigra::StandardValueAccessor<float>(),
+                                kernel.center(), kernel.accessor(),
+                                kernel.left(), kernel.right(), modes[m]);
+            vigra::convolveLine(src.begin(), src.end(), GenericTestAccessor<T>(),
+                                generic.begin(), vigra::StandardValueAccessor<float>(),
+                                kernel.center(), kernel.accessor(),
+                                kernel.left(), kernel.right(), modes[m]);
+
+            shouldEqualSequence(fast.begin(), fast.end(), generic.begin());
+        }
+    }
+}
+
 struct ConvolutionTest
 {
     typedef vigra::DImage Image;
@@ -752,6 +795,26 @@ struct ConvolutionTest
         should(acc(i1) == 2.75);
     }
     
+    void convolveLineFastPathTest()
+    {
+        vigra::Kernel1D<double> gauss, deriv, asym;
+        gauss.initGaussian(2.0);
+        deriv.initGaussianDerivative(1.5, 1);
+        asym.initExplicitly(-1, 3) = 1.0, 2.0, -4.0, 0.5, 3.0;
+        vigra::Kernel1D<float> fgauss;
+        fgauss.initGaussian(2.0);
+
+        checkConvolveLineFastPath<float>(gauss);
+        checkConvolveLineFastPath<float>(deriv);
+        checkConvolveLineFastPath<float>(asym);
+        checkConvolveLineFastPath<float>(fgauss);
+        checkConvolveLineFastPath<double>(gauss);
+        checkConvolveLineFastPath<double>(asym);
+        checkConvolveLineFastPath<unsigned char>(fgauss);
+        checkConvolveLineFastPath<unsigned char>(deriv);
+        checkConvolveLineFastPath<int>(asym);
+    }
+    
     void gaussianSmoothingTest()
     {
         double scale = 1.0;
@@ -2138,6 +2201,7 @@ struct ConvolutionTestSuite
         add( testCase( &ConvolutionTest::separableDerivativeAvoidTest));
         add( testCase( &ConvolutionTest::separableSmoothClipTest));
         add( testCase( &ConvolutionTest::separableSmoothWrapTest));
+        add( testCase( &ConvolutionTest::convolveLineFastPathTest));
         add( testCase( &ConvolutionTest::gaussianSmoothingTest));
         add( testCase( &ConvolutionTest::optimalSmoothing3Test));
         add( testCase( &ConvolutionTest::optimalSmoothing5Test));
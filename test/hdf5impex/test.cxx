@@ -41,6 +41,8 @@
 #include "unittest.hxx"
 #include "vigra/hdf5impex.hxx"
 #include "vigra/multi_array.hxx"
+#include "vigra/hdf5blockwise.hxx"
+#include "vigra/random.hxx"
 
 using namespace vigra;
 
@@ -1175,6 +1177,62 @@ public:
         file_open.readAttribute("/group2/float_array","float_array_attribute",read_attr);
     }
 
+    void testHDF5BlockwiseFilters()
+    {
+        typedef MultiArrayShape<3>::type Shape;
+        Shape shape(31, 27, 19);
+        MultiArray<3, float> data(shape);
+        RandomMT19937 random(42);
+        for(int k=0; k<data.size(); ++k)
+            data[k] = (float)random.uniform();
+
+        std::string file_name("testfile_HDF5File_blockwise.hdf5");
+        HDF5File file(file_name, HDF5File::New);
+        file.write("/data", data);
+
+        double sigma = 1.5;
+        MultiArray<3, float> smooth(shape);
+        MultiArray<3, TinyVector<float, 3> > grad(shape);
+        MultiArray<3, TinyVector<float, 6> > hessian(shape);
+        gaussianSmoothMultiArray(srcMultiArrayRange(data), destMultiArray(smooth), sigma);
+        gaussianGradientMultiArray(srcMultiArrayRange(data), destMultiArray(grad), sigma);
+        hessianOfGaussianMultiArray(srcMultiArrayRange(data), destMultiArray(hessian), sigma);
+
+        for(int threads=0; threads<4; ++threads)
+        {
+            BlockwiseOptions<3> options;
+            options.blockShape(Shape(10, 12, 7)).numThreads(threads).compression(threads % 2 ? 6 : 0);
+
+            gaussianSmoothHDF5<float>(file, "/data", file, "/smooth", sigma, options);
+            gaussianGradientHDF5<float>(file, "/data", file, "/grad", sigma, options);
+            hessianOfGaussianHDF5<float>(file, "/data", file, "/hessian", sigma, options);
+            file.flushToDisk();
+
+            MultiArray<3, float> smooth_in(shape);
+            MultiArray<3, TinyVector<float, 3> > grad_in(shape);
+            MultiArray<3, TinyVector<float, 6> > hessian_in(shape);
+            file.read("/smooth", smooth_in);
+            file.read("/grad", grad_in);
+            file.read("/hessian", hessian_in);
+
+            should(smooth_in == smooth);
+            should(grad_in == grad);
+            should(hessian_in == hessian);
+        }
+
+        try
+        {
+            gaussianSmoothHDF5<float>(file, "/data", file, "/data", sigma, BlockwiseOptions<3>());
+            failTest("no exception thrown");
+        }
+        catch(vigra::ContractViolation & c)
+        {
+            std::string expected("\nPrecondition violation!\ngaussianSmoothHDF5(): source and destination must be different datasets.");
+            std::string message(c.what());
+            should(0 == expected.compare(message.substr(0,expected.size())));
+        }
+    }
+
 };
 
 
@@ -1211,6 +1269,7 @@ struct HDF5ImportExportTestSuite : public vigra::test_suite
         add(testCase(&HDF5ExportImportTest::testHDF5FileBrowsing));
         add(testCase(&HDF5ExportImportTest::testHDF5FileAttributes));
         add(testCase(&HDF5ExportImportTest::testHDF5FileTutorial));
+        add(testCase(&HDF5ExportImportTest::testHDF5BlockwiseFilters));
 
     }
 };
@@ -37,10 +37,14 @@
 #include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include "vigra/stdimage.hxx"
 #include "vigra/impex.hxx"
 #include "unittest.hxx"
 #include "vigra/multi_array.hxx"
+#if defined(HasTIFF)
+# include <tiffio.h>
+#endif
 
 using namespace vigra;
 
@@ -559,10 +563,10 @@ class CanvasSizeTest
     void testTIFFCanvasSize ()
     {
         vigra::ImageExportInfo exportinfo ("res.tif");
+        FRGBImage img(1, 1);
 #if !defined(HasTIFF)
         failCodec(img, exportinfo);
 #else
-        FRGBImage img(1, 1);
         img(0,0) = 1;
         exportinfo.setCompression ("LZW");
         Size2D canvasSize(3, 8);
@@ -576,6 +580,372 @@ class CanvasSizeTest
     }
 };
 
+class RegionOfInterestTest
+{
+    vigra::BRGBImage img;
+
+  public:
+    RegionOfInterestTest ()
+    {
+        vigra::ImageImportInfo info ("lennargb.xv");
+        img.resize (info.width (), info.height ());
+        importImage (info, destImage (img));
+    }
+
+    void testFile (const char * filename, bool lossless = true)
+    {
+        exportImage (srcImageRange (img), vigra::ImageExportInfo (filename));
+
+        vigra::ImageImportInfo info (filename);
+        should (info.getRegionOfInterest () == Rect2D (info.size ()));
+
+        // lossy formats are compared against the full image read back
+        vigra::BRGBImage ref (info.width (), info.height ());
+        if (lossless)
+            ref = img;
+        else
+            importImage (info, destImage (ref));
+
+        Rect2D roi (Point2D (17, 33), Size2D (40, 25));
+        info.setRegionOfInterest (roi);
+        shouldEqual (info.width (), img.width ());
+
+        vigra::BRGBImage res (roi.size ());
+        importImage (info, destImage (res));
+
+        for (int y = 0; y < roi.height (); ++y)
+            for (int x = 0; x < roi.width (); ++x)
+                shouldEqual (res (x, y), ref (x + roi.left (), y + roi.top ()));
+
+        try
+        {
+            info.setRegionOfInterest (Rect2D (Point2D (10, 10), info.size ()));
+            failTest ("Failed to throw exception.");
+        }
+        catch (vigra::PreconditionViolation &)
+        {}
+    }
+
+    void testVIFF ()
+    {
+        testFile ("res.xv");
+    }
+
+    void testPNG ()
+    {
+#if defined(HasPNG)
+        testFile ("res.png");
+#endif
+    }
+
+    void testTIFF ()
+    {
+#if defined(HasTIFF)
+        testFile ("res.tif");
+#endif
+    }
+
+    void testJPEG ()
+    {
+#if defined(HasJPEG)
+        testFile ("res.jpg", false);
+#endif
+    }
+
+#if defined(HasTIFF)
+    // write an RGB image with libtiff, in tiles of 32x16 pixels or in
+    // strips of 7 rows, with interleaved or separate color planes
+    void writeTIFF (const char * filename, const vigra::BRGBImage & src,
+                    int planarconfig, bool tiled)
+    {
+        TIFF * tiff = TIFFOpen (filename, "w");
+        should (tiff != 0);
+        const UInt32 w = src.width (), h = src.height ();
+        TIFFSetField (tiff, TIFFTAG_IMAGEWIDTH, w);
+        TIFFSetField (tiff, TIFFTAG_IMAGELENGTH, h);
+        TIFFSetField (tiff, TIFFTAG_BITSPERSAMPLE, 8);
+        TIFFSetField (tiff, TIFFTAG_SAMPLESPERPIXEL, 3);
+        TIFFSetField (tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+        TIFFSetField (tiff, TIFFTAG_PLANARCONFIG, planarconfig);
+        TIFFSetField (tiff, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+
+        const int planes = planarconfig == PLANARCONFIG_SEPARATE ? 3 : 1,
+                  samples = 3 / planes;
+        if (tiled)
+        {
+            const UInt32 tw = 32, th = 16;
+            TIFFSetField (tiff, TIFFTAG_TILEWIDTH, tw);
+            TIFFSetField (tiff, TIFFTAG_TILELENGTH, th);
+            std::vector<UInt8> tile (tw * th * samples);
+            for (int p = 0; p < planes; ++p)
+                for (UInt32 ty = 0; ty < h; ty += th)
+                    for (UInt32 tx = 0; tx < w; tx += tw)
+                    {
+                        std::fill (tile.begin (), tile.end (), 0);
+                        for (UInt32 y = ty; y < std::min (ty + th, h); ++y)
+                            for (UInt32 x = tx; x < std::min (tx + tw, w); ++x)
+                                for (int c = 0; c < samples; ++c)
+                                    tile[((y - ty) * tw + x - tx) * samples + c] = src (x, y)[p + c];
+                        should (TIFFWriteTile (tiff, &tile[0], tx, ty, 0, p) != -1);
+                    }
+        }
+        else
+        {
+            TIFFSetField (tiff, TIFFTAG_ROWSPERSTRIP, 7);
+            std::vector<UInt8> row (w * samples);
+            for (int p = 0; p < planes; ++p)
+                for (UInt32 y = 0; y < h; ++y)
+                {
+                    for (UInt32 x = 0; x < w; ++x)
+                        for (int c = 0; c < samples; ++c)
+                            row[x * samples + c] = src (x, y)[p + c];
+                    should (TIFFWriteScanline (tiff, &row[0], y, p) == 1);
+                }
+        }
+        TIFFClose (tiff);
+    }
+#endif
+
+    void testTIFFLayouts ()
+    {
+#if defined(HasTIFF)
+        // partial tiles and strips at the right and bottom border
+        vigra::BRGBImage src (90, 70);
+        copyImage (srcIterRange (img.upperLeft (), img.upperLeft () + Diff2D (90, 70)),
+                   destImage (src));
+
+        // regions crossing tile and strip boundaries, and the whole image
+        Rect2D rois[] = { Rect2D (Point2D (17, 13), Size2D (40, 25)),
+                          Rect2D (Point2D (50, 40), Size2D (40, 30)),
+                          Rect2D (Point2D (33, 20), Size2D (1, 1)),
+                          Rect2D (src.size ()) };
+        int planarconfigs[] = { PLANARCONFIG_CONTIG, PLANARCONFIG_SEPARATE };
+        for (int p = 0; p < 2; ++p)
+        {
+            for (int tiled = 0; tiled < 2; ++tiled)
+            {
+                writeTIFF ("res.tif", src, planarconfigs[p], tiled == 1);
+                for (int r = 0; r < 4; ++r)
+                {
+                    vigra::ImageImportInfo info ("res.tif");
+                    info.setRegionOfInterest (rois[r]);
+                    vigra::BRGBImage res (rois[r].size ());
+                    importImage (info, destImage (res));
+                    for (int y = 0; y < rois[r].height (); ++y)
+                        for (int x = 0; x < rois[r].width (); ++x)
+                            shouldEqual (res (x, y), src (x + rois[r].left (), y + rois[r].top ()));
+                }
+            }
+        }
+#endif
+    }
+};
+
+class ScanlineTransferTest
+{
+    vigra::BRGBImage img;
+
+  public:
+    ScanlineTransferTest ()
+    {
+        vigra::ImageImportInfo info ("lennargb.xv");
+        img.resize (info.width (), info.height ());
+        importImage (info, destImage (img));
+    }
+
+    // Import whole scanlines into plain images and compare with the
+    // per-pixel path, which is taken for accessors without a fast path.
+    template <class Image>
+    void testImport (const char * filename)
+    {
+        typedef typename Image::value_type Value;
+
+        exportImage (srcImageRange (img), vigra::ImageExportInfo (filename));
+        vigra::ImageImportInfo info (filename);
+
+        Image fast (info.size ()), slow (info.size ());
+        importImage (info, destImage (fast));
+        importImage (info, destImage (slow, VectorAccessor<Value> ()));
+
+        shouldEqualSequence (fast.begin (), fast.end (), slow.begin ());
+        shouldEqual (fast (17, 33)[1], img (17, 33)[1]);
+    }
+
+    template <class Image>
+    void testExport (const char * filename)
+    {
+        typedef typename Image::value_type Value;
+
+        Image src (img.size ());
+        copyImage (srcImageRange (img), destImage (src));
+
+        exportImage (srcImageRange (src, VectorAccessor<Value> ()),
+                     vigra::ImageExportInfo (filename));
+        vigra::ImageImportInfo slowinfo (filename);
+        vigra::BRGBImage slow (slowinfo.size ());
+        importImage (slowinfo, destImage (slow));
+
+        exportImage (srcImageRange (src), vigra::ImageExportInfo (filename));
+        vigra::ImageImportInfo fastinfo (filename);
+        vigra::BRGBImage fast (fastinfo.size ());
+        importImage (fastinfo, destImage (fast));
+
+        shouldEqualSequence (fast.begin (), fast.end (), slow.begin ());
+        shouldEqualSequence (fast.begin (), fast.end (), img.begin ());
+    }
+
+    void testScalar ()
+    {
+        vigra::BImage gray (img.size ());
+        copyImage (srcImageRange (img, RedAccessor<BRGBImage::value_type> ()),
+                   destImage (gray));
+        exportImage (srcImageRange (gray), vigra::ImageExportInfo ("res.xv"));
+
+        vigra::ImageImportInfo info ("res.xv");
+        vigra::FImage fast (info.size ()), slow (info.size ());
+        importImage (info, destImage (fast));
+        importImage (info, destImage (slow, StandardAccessor<float> ()));
+        shouldEqualSequence (fast.begin (), fast.end (), slow.begin ());
+        shouldEqual (fast (17, 33), gray (17, 33));
+    }
+
+    void testVIFF ()
+    {
+        testImport<vigra::BRGBImage> ("res.xv");
+        testImport<vigra::FRGBImage> ("res.xv");
+        testExport<vigra::BRGBImage> ("res.xv");
+    }
+
+    void testPNG ()
+    {
+#if defined(HasPNG)
+        testImport<vigra::BRGBImage> ("res.png");
+        testImport<vigra::FRGBImage> ("res.png");
+        testExport<vigra::BRGBImage> ("res.png");
+        testExport<vigra::BasicImage<TinyVector<UInt8, 3> > > ("res.png");
+#endif
+    }
+};
+
+class CompressionTest
+{
+    vigra::BRGBImage img;
+
+  public:
+    CompressionTest ()
+    {
+        vigra::ImageImportInfo info ("lennargb.xv");
+        img.resize (info.width (), info.height ());
+        importImage (info, destImage (img));
+    }
+
+    template <class Image>
+    void testRoundTrip (Image const & src, vigra::ImageExportInfo const & exportinfo)
+    {
+        exportImage (srcImageRange (src), exportinfo);
+
+        vigra::ImageImportInfo info (exportinfo.getFileName ());
+        shouldEqual (info.width (), src.width ());
+        shouldEqual (info.height (), src.height ());
+        Image res (info.size ());
+        importImage (info, destImage (res));
+        shouldEqualSequence (res.begin (), res.end (), src.begin ());
+    }
+
+    void testSettings ()
+    {
+        vigra::ImageExportInfo info ("res.png");
+        shouldEqual (info.getCompressionLevel (), -1);
+        shouldEqual (std::string (info.getCompressionStrategy ()), std::string (""));
+        shouldEqual (info.getNumThreads (), 0);
+
+        info.setCompressionLevel (9).setCompressionStrategy ("RLE").setNumThreads (4);
+        shouldEqual (info.getCompressionLevel (), 9);
+        shouldEqual (std::string (info.getCompressionStrategy ()), std::string ("RLE"));
+        shouldEqual (info.getNumThreads (), 4);
+
+        try
+        {
+            info.setCompressionLevel (10);
+            failTest ("Failed to throw exception.");
+        }
+        catch (vigra::PreconditionViolation &)
+        {}
+        try
+        {
+            info.setCompressionStrategy ("FAST");
+            failTest ("Failed to throw exception.");
+        }
+        catch (vigra::PreconditionViolation &)
+        {}
+    }
+
+    void testPNG ()
+    {
+#if defined(HasPNG)
+        testRoundTrip (img, vigra::ImageExportInfo ("res.png").setCompressionLevel (1)
+                                                             .setCompressionStrategy ("RLE"));
+
+        // parallel compression, also with fewer rows than threads
+        testRoundTrip (img, vigra::ImageExportInfo ("res.png").setNumThreads (4));
+        testRoundTrip (img, vigra::ImageExportInfo ("res.png").setNumThreads (3)
+                                                             .setCompressionLevel (9));
+        vigra::BRGBImage small (5, 2);
+        small (4, 1) = img (100, 100);
+        testRoundTrip (small, vigra::ImageExportInfo ("res.png").setNumThreads (8));
+
+        vigra::UInt16Image gray (img.width (), img.height ());
+        for (int y = 0; y < img.height (); ++y)
+            for (int x = 0; x < img.width (); ++x)
+                gray (x, y) = img (x, y).red () * 257 + y;
+        testRoundTrip (gray, vigra::ImageExportInfo ("res.png").setNumThreads (4)
+                                                              .setCompressionStrategy ("FILTERED"));
+#endif
+    }
+
+    void testTIFF ()
+    {
+#if defined(HasTIFF)
+        testRoundTrip (img, vigra::ImageExportInfo ("res.tif").setCompression ("DEFLATE")
+                                                             .setCompressionLevel (9));
+        testRoundTrip (img, vigra::ImageExportInfo ("res.tif").setCompression ("DEFLATE")
+                                                             .setCompressionStrategy ("RLE"));
+
+        // tall enough for several strips (of 65536 rows), which are 
+        // compressed in batches, and different in each strip
+        vigra::BImage tall (16, 150000);
+        for (int y = 0; y < tall.height (); ++y)
+            for (int x = 0; x < tall.width (); ++x)
+                tall (x, y) = (UInt8)(x * y + y / 1000);
+        testRoundTrip (tall, vigra::ImageExportInfo ("res.tif").setCompression ("DEFLATE")
+                                                              .setNumThreads (2));
+        // the strips were really compressed, and not written uncompressed
+        // after a failure of the compressor
+        std::ifstream file ("res.tif", std::ios::binary | std::ios::ate);
+        should ((long)file.tellg () < tall.width () * tall.height () / 4);
+
+        // 16-bit data, with a partial last strip and a partial last batch
+        vigra::UInt16Image gray (16, 200000);
+        for (int y = 0; y < gray.height (); ++y)
+            for (int x = 0; x < gray.width (); ++x)
+                gray (x, y) = (UInt16)(img (x * 16, y % img.height ()).red () * 257 + y / 100);
+        testRoundTrip (gray, vigra::ImageExportInfo ("res.tif").setCompression ("DEFLATE")
+                                                              .setNumThreads (3));
+        testRoundTrip (gray, vigra::ImageExportInfo ("res.tif").setCompression ("DEFLATE")
+                                                              .setCompressionStrategy ("FILTERED")
+                                                              .setNumThreads (4));
+        vigra::UInt16RGBImage rgb (img.width (), img.height ());
+        for (int y = 0; y < img.height (); ++y)
+            for (int x = 0; x < img.width (); ++x)
+                rgb (x, y) = vigra::UInt16RGBImage::value_type (img (x, y).red () * 257,
+                                                                img (x, y).green () + x,
+                                                                img (x, y).blue () * 256 + y);
+        testRoundTrip (rgb, vigra::ImageExportInfo ("res.tif").setCompression ("DEFLATE")
+                                                             .setNumThreads (4));
+#endif
+    }
+};
+
 class PNGInt16Test
 {
   public:
@@ -1478,6 +1848,23 @@ struct ImageImportExportTestSuite : public vigra::test_suite
 
         add(testCase(&CanvasSizeTest::testTIFFCanvasSize));
 
+        // region of interest import
+        add(testCase(&RegionOfInterestTest::testVIFF));
+        add(testCase(&RegionOfInterestTest::testPNG));
+        add(testCase(&RegionOfInterestTest::testTIFF));
+        add(testCase(&RegionOfInterestTest::testJPEG));
+        add(testCase(&RegionOfInterestTest::testTIFFLayouts));
+
+        // whole-scanline transfer
+        add(testCase(&ScanlineTransferTest::testVIFF));
+        add(testCase(&ScanlineTransferTest::testPNG));
+        add(testCase(&ScanlineTransferTest::testScalar));
+
+        // zlib settings and parallel compression
+        add(testCase(&CompressionTest::testSettings));
+        add(testCase(&CompressionTest::testPNG));
+        add(testCase(&CompressionTest::testTIFF));
+
         // grayscale float images
         add(testCase(&FloatImageExportImportTest::testGIF));
         add(testCase(&FloatImageExportImportTest::testJPEG));
@@ -1085,6 +1085,43 @@ struct MultiImpexTest
         shouldEqual(result(0,1,2), 3);
         shouldEqual(result(0,1,3), 4);
 
+        Array parallelResult;
+        exportVolume(array, VolumeExportInfo("impex/ptest", ext2), ParallelOptions().numThreads(4));
+        importVolume(parallelResult, std::string("impex/ptest"), std::string(ext2),
+                     ParallelOptions().numThreads(4));
+        shouldEqual(parallelResult.shape(), Shape(2,3,4));
+        should(parallelResult == result);
+
+        VolumeImportInfo parallel_info("impex/ptest", ext2);
+        parallelResult.init(0);
+        importVolume(parallel_info, parallelResult, ParallelOptions().numThreads(ParallelOptions::NoThreads));
+        should(parallelResult == result);
+
+        {
+            std::ofstream raw("impex/raw.dat", std::ios::binary);
+            raw.write((char const *)array.data(), array.size()*sizeof(unsigned char));
+            std::ofstream info("impex/raw.info");
+            info << "width = 2\nheight = 3\ndepth = 4\n"
+                    "datatype = UNSIGNED_CHAR\nfilename = raw.dat\n";
+        }
+        VolumeImportInfo raw_info("impex/raw.info");
+        shouldEqual(raw_info.shape(), Shape(2,3,4));
+        shouldEqual(std::string(raw_info.getPixelType()), std::string("UINT8"));
+
+        MemoryMappedVolume<unsigned char> mapped(raw_info);
+        shouldEqual(mapped.shape(), Shape(2,3,4));
+        should(mapped.view() == array);
+        should(mapped.subarray(Shape(0,1,1), Shape(2,3,3)) ==
+               array.subarray(Shape(0,1,1), Shape(2,3,3)));
+
+        try
+        {
+            MemoryMappedVolume<float> wrongType(raw_info);
+            failTest("MemoryMappedVolume failed to throw exception.");
+        }
+        catch(PreconditionViolation &)
+        {}
+
 #ifdef _WIN32
         exportVolume(array, VolumeExportInfo("impex\\test", ext2));
         
@@ -417,6 +417,59 @@ struct MultiArraySeparableConvolutionTest
         shouldEqualSequenceTolerance(st.data(), st.data()+size, rst.data(), epsilon);
     }
 
+    void test_parallel()
+    {
+        Image3D random(shape), serial(shape), parallel(shape);
+        makeRandom(random);
+
+        std::vector<vigra::Kernel1D<float> > kernels( 3 );
+        kernels[0].initGaussian( kernelSize );
+        kernels[1].initGaussianDerivative( kernelSize, 1 );
+        kernels[2].initGaussian( 2.5 );
+
+        separableConvolveMultiArray( srcMultiArrayRange(random),
+                                     destMultiArray(serial),
+                                     kernels.begin() );
+
+        for(int threads = 0; threads <= 5; ++threads)
+        {
+            parallel.init(0.0f);
+            separableConvolveMultiArray( srcMultiArrayRange(random),
+                                         destMultiArray(parallel),
+                                         kernels.begin(),
+                                         ParallelOptions().numThreads(threads) );
+            shouldEqualSequence( serial.begin(), serial.end(), parallel.begin() );
+        }
+
+        // in-place operation
+        parallel = random;
+        separableConvolveMultiArray( srcMultiArrayRange(parallel),
+                                     destMultiArray(parallel),
+                                     kernels.begin(),
+                                     ParallelOptions().numThreads(3) );
+        shouldEqualSequence( serial.begin(), serial.end(), parallel.begin() );
+
+        // rounding to an integer destination via the temporary array
+        MultiArray<3, unsigned char> serial8(shape), parallel8(shape);
+        separableConvolveMultiArray( srcMultiArrayRange(srcImage),
+                                     destMultiArray(serial8),
+                                     kernels[0] );
+        separableConvolveMultiArray( srcMultiArrayRange(srcImage),
+                                     destMultiArray(parallel8),
+                                     kernels[0],
+                                     ParallelOptions().numThreads(4) );
+        shouldEqualSequence( serial8.begin(), serial8.end(), parallel8.begin() );
+
+        // 2D (splitting along the other dimension)
+        MultiArray<2, double> src2(MultiArrayShape<2>::type(93, 57)), serial2(src2.shape()), parallel2(src2.shape());
+        makeRandom(src2);
+        separableConvolveMultiArray( srcMultiArrayRange(src2), destMultiArray(serial2),
+                                     kernels[1] );
+        separableConvolveMultiArray( srcMultiArrayRange(src2), destMultiArray(parallel2),
+                                     kernels[1], ParallelOptions().numThreads(4) );
+        shouldEqualSequence( serial2.begin(), serial2.end(), parallel2.begin() );
+    }
+
     //--------------------------------------------
 
     const Size3 shape;
@@ -479,6 +532,7 @@ struct MultiArraySeparableConvolutionTestSuite
                 add( testCase( &MultiArraySeparableConvolutionTest::test_InplaceN ) );
                 add( testCase( &MultiArraySeparableConvolutionTest::test_Inplace1 ) );
                 add( testCase( &MultiArraySeparableConvolutionTest::test_gradient1 ) );
+                add( testCase( &MultiArraySeparableConvolutionTest::test_parallel ) );
                 add( testCase( &MultiArraySeparableConvolutionTest::test_laplacian ) );
                 add( testCase( &MultiArraySeparableConvolutionTest::test_hessian ) );
                 add( testCase( &MultiArraySeparableConvolutionTest::test_structureTensor ) );
@@ -1151,6 +1151,107 @@ struct MultiDistanceTest
         separableMultiDistance(srcMultiArrayRange(img2), destMultiArray(res), true);
         shouldEqualSequence(res.begin(), res.end(), desired);
     }
+    void testDistanceParallel()
+    {
+        typedef MultiArrayShape<3>::type Shape;
+        MultiArrayView<3, double> vol(Shape(12,10,35), volume_data);
+        MultiArrayView<3, double, StridedArrayTag> pvol(vol.transpose());
+
+        MultiArray<3, double> res(vol.shape()), pres(vol.shape());
+        MultiArray<3, int> ires(vol.shape()), pires(vol.shape());
+        TinyVector<double, 3> pixelPitch(1.2, 1.0, 2.4);
+
+        int threads[] = { 0, 4 };
+        for(int t=0; t<2; ++t)
+        {
+            ParallelOptions options = ParallelOptions().numThreads(threads[t]);
+
+            separableMultiDistSquared(srcMultiArrayRange(vol), destMultiArray(res), false);
+            separableMultiDistSquared(srcMultiArrayRange(vol), destMultiArray(pres), false, options);
+            shouldEqualSequence(res.begin(), res.end(), pres.begin());
+            shouldEqualSequence(pres.data(), pres.data()+pres.elementCount(), ref_dist2);
+
+            // integer destination is transformed in-place
+            separableMultiDistSquared(srcMultiArrayRange(vol), destMultiArray(ires), true);
+            separableMultiDistSquared(srcMultiArrayRange(vol), destMultiArray(pires), true, options);
+            shouldEqualSequence(ires.begin(), ires.end(), pires.begin());
+
+            // strided input and output
+            MultiArrayView<3, double, StridedArrayTag> tres(res.transpose()), tpres(pres.transpose());
+            separableMultiDistSquared(srcMultiArrayRange(pvol), destMultiArray(tres), true);
+            separableMultiDistSquared(srcMultiArrayRange(pvol), destMultiArray(tpres), true, options);
+            shouldEqualSequence(res.begin(), res.end(), pres.begin());
+
+            separableMultiDistance(srcMultiArrayRange(vol), destMultiArray(res), true, pixelPitch);
+            separableMultiDistance(srcMultiArrayRange(vol), destMultiArray(pres), true, pixelPitch, options);
+            shouldEqualSequence(res.begin(), res.end(), pres.begin());
+        }
+    }
+    void testVectorDistance()
+    {
+        typedef MultiArrayShape<3>::type Shape;
+        typedef TinyVector<MultiArrayIndex, 3> Offset;
+        MultiArrayView<3, double> vol(Shape(12,10,35), volume_data);
+
+        MultiArray<3, Offset> offsets(vol.shape());
+        MultiArray<3, double> dist(vol.shape());
+        TinyVector<double, 3> pixelPitch(1.2, 1.0, 2.4);
+
+        for(int b=0; b<2; ++b)
+        {
+            bool background = (b == 0);
+
+            separableVectorDistance(vol, offsets, background);
+            separableMultiDistSquared(srcMultiArrayRange(vol), destMultiArray(dist), background);
+
+            MultiArrayView<3, Offset> o(offsets);
+            MultiArrayView<3, Offset>::iterator i = o.begin(), end = o.end();
+            for(; i != end; ++i)
+            {
+                Shape nearest = i.point() + *i;
+                should(vol.isInside(nearest));
+                shouldEqual(vol[nearest] != 0.0, background);
+                shouldEqual((double)squaredNorm(*i), dist[i.point()]);
+            }
+
+            separableVectorDistance(vol, offsets, background, pixelPitch);
+            separableMultiDistSquared(srcMultiArrayRange(vol), destMultiArray(dist), background, pixelPitch);
+
+            for(i = o.begin(); i != end; ++i)
+            {
+                Shape nearest = i.point() + *i;
+                should(vol.isInside(nearest));
+                shouldEqual(vol[nearest] != 0.0, background);
+                shouldEqualTolerance(squaredNorm(pixelPitch*(*i)), dist[i.point()], 1e-10);
+            }
+        }
+
+        // nearest seed assignment
+        MultiArray<2, int> seeds(MultiArrayShape<2>::type(9, 7)), voronoi(seeds.shape());
+        seeds(1, 1) = 1;
+        seeds(7, 2) = 2;
+        seeds(3, 6) = 3;
+        MultiArray<2, TinyVector<MultiArrayIndex, 2> > offsets2D(seeds.shape());
+        separableVectorDistance(seeds, offsets2D, true);
+
+        MultiArrayShape<2>::type seedPoints[] = { 
+            MultiArrayShape<2>::type(1, 1), MultiArrayShape<2>::type(7, 2), MultiArrayShape<2>::type(3, 6) };
+        MultiArrayView<2, int> v(voronoi);
+        for(MultiArrayView<2, int>::iterator i = v.begin(); i != v.end(); ++i)
+        {
+            *i = seeds[i.point() + offsets2D[i.point()]];
+            should(*i > 0);
+
+            // the assigned seed is a nearest one
+            MultiArrayIndex minDist = squaredNorm(i.point() - seedPoints[0]);
+            for(int k=1; k<3; ++k)
+                minDist = std::min(minDist, squaredNorm(i.point() - seedPoints[k]));
+            shouldEqual(squaredNorm(i.point() - seedPoints[*i-1]), minDist);
+        }
+        shouldEqual(voronoi(0, 0), 1);
+        shouldEqual(voronoi(8, 0), 2);
+        shouldEqual(voronoi(0, 6), 3);
+    }
 };
 
 
@@ -1166,6 +1267,8 @@ struct SimpleAnalysisTestSuite
         add( testCase( &MultiDistanceTest::testDistanceVolumesAnisoptopic));
         add( testCase( &MultiDistanceTest::distanceTransform2DCompare));
         add( testCase( &MultiDistanceTest::distanceTest1D));
+        add( testCase( &MultiDistanceTest::testDistanceParallel));
+        add( testCase( &MultiDistanceTest::testVectorDistance));
     }
 };
 
@@ -34,11 +34,13 @@
 /************************************************************************/
 
 #include <iostream>
+#include <algorithm>
 #include "unittest.hxx"
 #include "vigra/stdimage.hxx"
 #include "vigra/multi_morphology.hxx"
 #include "vigra/linear_algebra.hxx"
 #include "vigra/matrix.hxx"
+#include "vigra/random.hxx"
 
 using namespace vigra;
 
@@ -282,6 +284,125 @@ struct MultiMorphologyTest
         multiGrayscaleErosion(srcMultiArrayRange(in), destMultiArray(tmp),2);
         multiGrayscaleDilation(srcMultiArrayRange(tmp), destMultiArray(res),2);
     }
+
+    void binaryMorphologyAnisotropicTest()
+    {
+        typedef MultiArrayShape<3>::type Shape;
+        typedef MultiArray<3, UInt8> UInt8Volume;
+
+        // a ball and a box in a volume with coarse z resolution
+        Shape shape(14, 12, 8);
+        UInt8Volume in(shape), res(shape), desired(shape);
+        for(int z=0; z<shape[2]; ++z)
+            for(int y=0; y<shape[1]; ++y)
+                for(int x=0; x<shape[0]; ++x)
+                    in(x,y,z) = (sq(x-5) + sq(y-5) + sq(3*(z-3)) <= 20) || 
+                                (x >= 9 && x < 13 && y >= 2 && y < 11 && z >= 2);
+
+        TinyVector<double, 3> pitches[] = { TinyVector<double, 3>(1.0, 1.0, 3.0),
+                                            TinyVector<double, 3>(1.0, 1.2, 2.7) };
+        double radii[] = { 2.5, 2.3 };
+
+        for(int k=0; k<2; ++k)
+        {
+            TinyVector<double, 3> const & pitch = pitches[k];
+            double radius2 = sq(radii[k]);
+
+            for(int dilation=0; dilation<2; ++dilation)
+            {
+                // brute force: distance to the nearest element of the other class
+                MultiArrayView<3, UInt8> view(desired);
+                for(MultiArrayView<3, UInt8>::iterator i = view.begin(); i != view.end(); ++i)
+                {
+                    bool isObject = in[i.point()] != 0;
+                    if(isObject != (dilation == 0))
+                    {
+                        *i = isObject;
+                        continue;
+                    }
+                    double minDist = NumericTraits<double>::max();
+                    MultiArrayView<3, UInt8> inView(in);
+                    for(MultiArrayView<3, UInt8>::iterator j = inView.begin(); j != inView.end(); ++j)
+                        if((*j != 0) != isObject)
+                            minDist = std::min(minDist, 
+                                        squaredNorm(pitch*TinyVector<double, 3>(i.point() - j.point())));
+                    *i = dilation 
+                            ? minDist < radius2
+                            : minDist >= radius2;
+                }
+
+                if(dilation)
+                    multiBinaryDilation(srcMultiArrayRange(in), destMultiArray(res), radii[k], pitch);
+                else
+                    multiBinaryErosion(srcMultiArrayRange(in), destMultiArray(res), radii[k], pitch);
+                shouldEqualSequence(res.begin(), res.end(), desired.begin());
+            }
+        }
+
+        // unit pitch gives the isotropic result
+        UInt8Volume iso(shape);
+        multiBinaryErosion(srcMultiArrayRange(in), destMultiArray(iso), 2.0);
+        multiBinaryErosion(srcMultiArrayRange(in), destMultiArray(res), 2.0, TinyVector<double, 3>(1.0));
+        shouldEqualSequence(res.begin(), res.end(), iso.begin());
+    }
+    
+    template <class T>
+    void checkGrayscaleBoxMorphology(MultiArray<3, T> const & in, TinyVector<int, 3> const & radii)
+    {
+        typedef MultiArrayShape<3>::type Shape;
+        Shape shape(in.shape());
+        MultiArray<3, T> erosion(shape), dilation(shape), desiredErosion(shape), desiredDilation(shape);
+
+        // brute force: extrema over the clipped box
+        MultiArrayView<3, T> view(desiredErosion);
+        for(typename MultiArrayView<3, T>::iterator i = view.begin(); i != view.end(); ++i)
+        {
+            Shape p(i.point()), 
+                  start(max(p - Shape(radii), Shape(0, 0, 0))),
+                  stop(min(p + Shape(radii) + Shape(1, 1, 1), shape));
+            MultiArrayView<3, T> box(in.subarray(start, stop));
+            T minimum = *std::min_element(box.begin(), box.end()),
+              maximum = *std::max_element(box.begin(), box.end());
+            *i = minimum;
+            desiredDilation[p] = maximum;
+        }
+
+        multiGrayscaleBoxErosion(srcMultiArrayRange(in), destMultiArray(erosion), radii);
+        shouldEqualSequence(erosion.begin(), erosion.end(), desiredErosion.begin());
+        multiGrayscaleBoxDilation(srcMultiArrayRange(in), destMultiArray(dilation), radii);
+        shouldEqualSequence(dilation.begin(), dilation.end(), desiredDilation.begin());
+
+        // in-place operation
+        MultiArray<3, T> inplace(in);
+        multiGrayscaleBoxErosion(srcMultiArrayRange(inplace), destMultiArray(inplace), radii);
+        shouldEqualSequence(inplace.begin(), inplace.end(), desiredErosion.begin());
+    }
+
+    void grayBoxMorphologyTest3D()
+    {
+        typedef MultiArrayShape<3>::type Shape;
+        Shape shape(17, 9, 11);
+        MultiArray<3, UInt8> in8(shape);
+        MultiArray<3, float> inf(shape);
+        RandomMT19937 random(42);
+        for(int k=0; k<in8.size(); ++k)
+        {
+            in8[k] = random.uniformInt(256);
+            inf[k] = (float)random.normal();
+        }
+
+        TinyVector<int, 3> radii[] = { TinyVector<int, 3>(2, 0, 1),
+                                       TinyVector<int, 3>(1, 1, 1),
+                                       TinyVector<int, 3>(0, 3, 0),
+                                       TinyVector<int, 3>(4, 2, 3),
+                                       TinyVector<int, 3>(20, 1, 0),
+                                       TinyVector<int, 3>(0, 0, 0) };
+        for(int k=0; k<6; ++k)
+        {
+            checkGrayscaleBoxMorphology(in8, radii[k]);
+            checkGrayscaleBoxMorphology(inf, radii[k]);
+        }
+    }
     
     IntImage img, img2, lin;
     IntVolume vol;
@@ -298,10 +419,12 @@ struct MorphologyTestSuite
         add( testCase( &MultiMorphologyTest::binaryErosionTest2));
         add( testCase( &MultiMorphologyTest::binaryErosionTest1D));
         add( testCase( &MultiMorphologyTest::binaryErosionTest3D));
+        add( testCase( &MultiMorphologyTest::binaryMorphologyAnisotropicTest));
         add( testCase( &MultiMorphologyTest::grayErosionTest2D));
         add( testCase( &MultiMorphologyTest::grayDilationTest2D));
         add( testCase( &MultiMorphologyTest::grayErosionAndDilationTest2D));
         add( testCase( &MultiMorphologyTest::grayClosingTest2D));
+        add( testCase( &MultiMorphologyTest::grayBoxMorphologyTest3D));
     }
 };
 
@@ -39,6 +39,7 @@
 #include "unittest.hxx"
 
 #include "vigra/seededregiongrowing3d.hxx"
+#include "vigra/random.hxx"
 
 using namespace vigra;
 
@@ -288,6 +289,151 @@ struct SeededRegionGrowing3DTest
         shouldEqualSequence(res.begin(), res.end(), vol3.begin());
     }
     
+    void fastVoronoiTestWithBorder()
+    {
+        static const int desired[] = {  1, 1, 1, 1, 1, 
+                                        1, 1, 1, 1, 1,  
+                                        1, 1, 1, 1, 1,  
+                                        1, 1, 1, 1, 1,  
+                                        1, 1, 1, 1, 1,
+
+                                        1, 1, 1, 1, 1,  
+                                        1, 1, 1, 1, 1,  
+                                        1, 1, 1, 1, 1,  
+                                        1, 1, 1, 1, 1,  
+                                        1, 1, 1, 1, 1,
+
+                                        0, 0, 0, 0, 0,  
+                                        0, 0, 0, 0, 0,  
+                                        0, 0, 0, 0, 0,  
+                                        0, 0, 0, 0, 0,  
+                                        0, 0, 0, 0, 0,
+
+                                        2, 2, 2, 2, 2,  
+                                        2, 2, 2, 2, 2,  
+                                        2, 2, 2, 2, 2,  
+                                        2, 2, 2, 2, 2,  
+                                        2, 2, 2, 2, 2,
+
+                                        2, 2, 2, 2, 2,  
+                                        2, 2, 2, 2, 2,  
+                                        2, 2, 2, 2, 2,  
+                                        2, 2, 2, 2, 2,   
+                                        2, 2, 2, 2, 2};
+
+        IntVolume res(vol1);
+
+        vigra::ArrayOfRegionStatistics<DirectCostFunctor> cost(2);
+        shouldEqual(fastSeededRegionGrowing(distvol1, res, cost, KeepContours), 2);
+        shouldEqualSequence(res.begin(), res.end(), desired);
+    }
+
+    void fastSimpleTest()
+    {
+        IntVolume res(vol3);
+
+        vigra::ArrayOfRegionStatistics<DirectCostFunctor> cost(4);
+        shouldEqual(fastSeededRegionGrowing(vol3, res, cost), 4);
+        shouldEqualSequence(res.begin(), res.end(), vol3.begin());
+
+        // the turbo algorithm treats costs as bucket indices
+        DoubleVolume negative(vol3.shape(), -1.0);
+        res.init(0);
+        res(2,2,2) = 1;
+        try
+        {
+            fastSeededRegionGrowing(negative, res, cost);
+            failTest("fastSeededRegionGrowing() failed to throw exception.");
+        }
+        catch(vigra::PreconditionViolation & c)
+        {
+            std::string expected("\nPrecondition violation!\nfastSeededRegionGrowing(): cost outside of the range [0, bucket_count).");
+            std::string message(c.what());
+            should(0 == expected.compare(message.substr(0,expected.size())));
+        }
+    }
+
+    template <unsigned int N>
+    static bool hasAdjacentRegions(MultiArrayView<N, UInt32> const & labels, 
+                                   NeighborhoodType neighborhood)
+    {
+        typedef typename MultiArrayShape<N>::type Shape;
+        ArrayVector<Shape> neighbors;
+        detail::makeNeighborhoodOffsets(neighborhood, neighbors);
+        
+        typename MultiArrayView<N, UInt32>::const_iterator i = labels.begin(), end = labels.end();
+        for(; i != end; ++i)
+        {
+            for(unsigned int k=0; k<neighbors.size(); ++k)
+            {
+                Shape p = i.point() + neighbors[k];
+                if(*i != 0 && labels.isInside(p) && labels[p] != 0 && labels[p] != *i)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    template <unsigned int N>
+    void fastRandomTest(typename MultiArrayShape<N>::type const & shape)
+    {
+        typedef typename MultiArrayShape<N>::type Shape;
+        
+        MultiArray<N, UInt8> boundaries(shape);
+        MultiArray<N, UInt32> seeds(shape);
+        RandomMT19937 random(42);
+        for(int k=0; k<boundaries.size(); ++k)
+            boundaries[k] = random.uniformInt(256);
+        UInt32 seedCount = 20;
+        for(UInt32 label=1; label<=seedCount; ++label)
+        {
+            // seeds at even coordinates are never adjacent
+            Shape p = seeds.scanOrderIndexToCoordinate(random.uniformInt(seeds.size()));
+            for(unsigned int k=0; k<N; ++k)
+                p[k] &= ~1;
+            seeds[p] = label;
+        }
+        UInt32 maxLabel = *std::max_element(seeds.begin(), seeds.end());
+
+        NeighborhoodType neighborhoods[] = { DirectNeighborhood, IndirectNeighborhood };
+        for(int n=0; n<2; ++n)
+        {
+            ArrayOfRegionStatistics<SeedRgDirectValueFunctor<UInt8> > stats(maxLabel);
+            
+            MultiArray<N, UInt32> labels(seeds);
+            shouldEqual(fastSeededRegionGrowing(boundaries, labels, stats, CompleteGrow, 
+                                                neighborhoods[n]), maxLabel);
+            should(std::find(labels.begin(), labels.end(), 0u) == labels.end());
+            for(int k=0; k<seeds.size(); ++k)
+                if(seeds[k] != 0)
+                    shouldEqual(labels[k], seeds[k]);
+
+            labels = seeds;
+            fastSeededRegionGrowing(boundaries, labels, stats, KeepContours, neighborhoods[n]);
+            should(!hasAdjacentRegions<N>(labels, neighborhoods[n]));
+            should(std::count(labels.begin(), labels.end(), 0u) > 0);
+            for(int k=0; k<seeds.size(); ++k)
+                if(seeds[k] != 0)
+                    shouldEqual(labels[k], seeds[k]);
+
+            labels = seeds;
+            fastSeededRegionGrowing(boundaries, labels, stats, StopAtThreshold, neighborhoods[n], 100.0);
+            for(int k=0; k<seeds.size(); ++k)
+                if(seeds[k] == 0 && labels[k] != 0)
+                    should(boundaries[k] <= 100);
+        }
+    }
+
+    void fastRandomTest2D()
+    {
+        fastRandomTest<2>(MultiArrayShape<2>::type(40, 30));
+    }
+
+    void fastRandomTest3D()
+    {
+        fastRandomTest<3>(MultiArrayShape<3>::type(20, 15, 10));
+    }
+    
     IntVolume    vol1;
     DoubleVolume vol2;
     IntVolume    vol3;
@@ -306,6 +452,10 @@ struct SeededRegionGrowing3DTestSuite
         add( testCase( &SeededRegionGrowing3DTest::voronoiTest));
         add( testCase( &SeededRegionGrowing3DTest::voronoiTestWithBorder));
         add( testCase( &SeededRegionGrowing3DTest::simpleTest));
+        add( testCase( &SeededRegionGrowing3DTest::fastVoronoiTestWithBorder));
+        add( testCase( &SeededRegionGrowing3DTest::fastSimpleTest));
+        add( testCase( &SeededRegionGrowing3DTest::fastRandomTest2D));
+        add( testCase( &SeededRegionGrowing3DTest::fastRandomTest3D));
     }
 };
 
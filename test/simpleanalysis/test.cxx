@@ -1685,10 +1685,18 @@ struct RegionGrowingTest
         };
 
         vigra::ArrayOfRegionStatistics<DirectCostFunctor> cost(2);
+        vigra::BlockAllocatorStatistics allocatorStats;
         seededRegionGrowing(srcImageRange(img), srcImage(seeds),
-                            destImage(res), cost, KeepContours);
+                            destImage(res), cost, KeepContours, FourNeighborCode(),
+                            NumericTraits<double>::max(), &allocatorStats);
 
         shouldEqualSequence(res.begin(), res.end(), reference);
+
+        // all candidates of the 7x7 image fit into the first block
+        shouldEqual(allocatorStats.blockCount, 1u);
+        should(allocatorStats.allocationCount >= 47u);
+        should(allocatorStats.peakSize > 0u &&
+               allocatorStats.peakSize <= allocatorStats.allocationCount);
     }
 
     Image img, seeds;
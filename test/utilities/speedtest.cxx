@@ -0,0 +1,137 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2004 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#include <iostream>
+#include <algorithm>
+#include "unittest.hxx"
+#include "vigra/union_find.hxx"
+#include "vigra/threadpool.hxx"
+#include "vigra/random.hxx"
+#include "vigra/timing.hxx"
+
+using namespace vigra;
+
+// Merges the 4-neighbors of equal value in a random binary image, i.e.
+// the union-find work of a connected components labeling.
+struct UnionFindSpeedTest
+{
+    typedef detail::ConcurrentUnionFindArray<UInt32> ConcurrentUnionFind;
+
+    enum { width = 2048, height = 2048, rowsPerChunk = 16 };
+
+    ArrayVector<UInt8> image;
+
+    UnionFindSpeedTest()
+    : image(width*height)
+    {
+        RandomMT19937 random(1);
+        for(int k=0; k<width*height; ++k)
+            image[k] = random.uniform() < 0.55;
+    }
+
+    template <class UnionFind>
+    void mergeRows(UnionFind & unionFind, int yBegin, int yEnd) const
+    {
+        for(int y=std::max(yBegin, 1); y<yEnd; ++y)
+        {
+            for(int x=1; x<width; ++x)
+            {
+                UInt32 k = y*width + x;
+                if(image[k] == image[k-1])
+                    unionFind.makeUnion(k-1, k);
+                if(image[k] == image[k-width])
+                    unionFind.makeUnion(k-width, k);
+            }
+        }
+    }
+
+    struct MergeFunctor
+    {
+        UnionFindSpeedTest const * test;
+        ConcurrentUnionFind * unionFind;
+
+        void operator()(int, std::ptrdiff_t chunk) const
+        {
+            test->mergeRows(*unionFind, (int)chunk*rowsPerChunk, (int)(chunk+1)*rowsPerChunk);
+        }
+    };
+
+    void testSequential()
+    {
+        USETICTOC;
+        TIC;
+        detail::UnionFindArray<UInt32> unionFind(width*height);
+        mergeRows(unionFind, 0, height);
+        unsigned int count = unionFind.makeContiguous();
+        std::cout << "UnionFindArray: " << TOCS << " (" << count << " sets)" << std::endl;
+    }
+
+    void testConcurrent()
+    {
+        int threads[] = { 1, 2, 4, 8 };
+        for(int t=0; t<4; ++t)
+        {
+            USETICTOC;
+            TIC;
+            ConcurrentUnionFind unionFind(width*height);
+            MergeFunctor f = { this, &unionFind };
+            parallel_foreach(ParallelOptions().numThreads(threads[t]), height / rowsPerChunk, f);
+            unsigned int count = unionFind.makeContiguous();
+            std::cout << "ConcurrentUnionFindArray, " << threads[t] << " thread(s): "
+                      << TOCS << " (" << count << " sets)" << std::endl;
+        }
+    }
+};
+
+struct UnionFindSpeedTestSuite
+: public vigra::test_suite
+{
+    UnionFindSpeedTestSuite()
+    : vigra::test_suite("UnionFindSpeedTestSuite")
+    {
+        add( testCase( &UnionFindSpeedTest::testSequential));
+        add( testCase( &UnionFindSpeedTest::testConcurrent));
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    UnionFindSpeedTestSuite test;
+
+    int failed = test.run(vigra::testsToBeExecuted(argc, argv));
+
+    std::cout << test.report() << std::endl;
+    return (failed != 0);
+}
@@ -44,6 +44,10 @@
 #include "vigra/copyimage.hxx"
 #include "vigra/sized_int.hxx"
 #include "vigra/bucket_queue.hxx"
+#include "vigra/union_find.hxx"
+#include "vigra/memory.hxx"
+#include "vigra/threadpool.hxx"
+#include "vigra/random.hxx"
 
 using namespace vigra;
 
@@ -373,6 +377,141 @@ struct BucketQueueTest
     }
 };
 
+struct UnionFindTest
+{
+    typedef detail::ConcurrentUnionFindArray<UInt32> ConcurrentUnionFind;
+
+    // random pairs of labels in [1, size), biased towards nearby labels 
+    // so that there are large sets as well as singletons
+    static void makePairs(int size, int count, ArrayVector<UInt32> & pairs)
+    {
+        RandomMT19937 random(size + count);
+        pairs.resize(2*count);
+        for(int k=0; k<count; ++k)
+        {
+            pairs[2*k] = 1 + random.uniformInt(size - 1);
+            int other = (int)pairs[2*k] + (int)random.uniformInt(17) - 8;
+            pairs[2*k+1] = (UInt32)std::max(1, std::min(size - 1, other));
+        }
+    }
+
+    struct UnionFunctor
+    {
+        ConcurrentUnionFind * unionFind;
+        UInt32 const * pairs;
+        std::ptrdiff_t chunkSize, count;
+
+        void operator()(int, std::ptrdiff_t chunk) const
+        {
+            std::ptrdiff_t end = std::min(count, (chunk+1)*chunkSize);
+            for(std::ptrdiff_t k=chunk*chunkSize; k<end; ++k)
+                unionFind->makeUnion(pairs[2*k], pairs[2*k+1]);
+        }
+    };
+
+    void testSequential()
+    {
+        int size = 1000, count = 700;
+        ArrayVector<UInt32> pairs;
+        makePairs(size, count, pairs);
+
+        detail::UnionFindArray<UInt32> reference(size);
+        ConcurrentUnionFind unionFind(size);
+        shouldEqual(unionFind.size(), (std::size_t)size);
+        for(int k=0; k<count; ++k)
+        {
+            UInt32 root = unionFind.makeUnion(pairs[2*k], pairs[2*k+1]);
+            shouldEqual(root, reference.makeUnion(pairs[2*k], pairs[2*k+1]));
+            shouldEqual(unionFind.find(pairs[2*k+1]), root);
+        }
+        shouldEqual(unionFind.makeContiguous(), reference.makeContiguous());
+        for(int k=0; k<size; ++k)
+            shouldEqual(unionFind[k], reference[k]);
+    }
+
+    void testConcurrentStress()
+    {
+        int size = 100000, count = 200000;
+        ArrayVector<UInt32> pairs;
+        makePairs(size, count, pairs);
+
+        detail::UnionFindArray<UInt32> reference(size);
+        for(int k=0; k<count; ++k)
+            reference.makeUnion(pairs[2*k], pairs[2*k+1]);
+        unsigned int referenceCount = reference.makeContiguous();
+
+        // many small chunks, so that the threads interleave a lot
+        for(int threads=0; threads<=8; threads += 2)
+        {
+            for(int round=0; round<3; ++round)
+            {
+                ConcurrentUnionFind unionFind(size);
+                UnionFunctor f = { &unionFind, pairs.data(), 97, count };
+                parallel_foreach(ParallelOptions().numThreads(threads), (count + 96) / 97, f);
+
+                shouldEqual(unionFind.makeContiguous(), referenceCount);
+                for(int k=0; k<size; ++k)
+                    shouldEqual(unionFind[k], reference[k]);
+            }
+        }
+    }
+};
+
+struct BlockAllocatorTest
+{
+    struct Record
+    {
+        double value;
+        int label;
+    };
+
+    void testAllocation()
+    {
+        detail::BlockAllocator<Record> arena(4);
+        shouldEqual(arena.blockSize(), 4u);
+        shouldEqual(arena.blockCount(), 0u);
+
+        Record * records[10];
+        for(int k=0; k<10; ++k)
+        {
+            records[k] = arena.allocate();
+            records[k]->value = k;
+            records[k]->label = k;
+        }
+        shouldEqual(arena.blockCount(), 3u);
+        shouldEqual(arena.capacity(), 12u);
+        shouldEqual(arena.size(), 10u);
+        // records within a block are contiguous
+        shouldEqual(records[1] - records[0], 1);
+        shouldEqual(records[3] - records[0], 3);
+
+        for(int k=0; k<5; ++k)
+            arena.deallocate(records[k]);
+        shouldEqual(arena.size(), 5u);
+
+        // freed records are reused before new blocks are requested
+        for(int k=4; k>=0; --k)
+            shouldEqual(arena.allocate(), records[k]);
+        arena.allocate();
+        arena.allocate();
+        shouldEqual(arena.blockCount(), 3u);
+        arena.allocate();
+        shouldEqual(arena.blockCount(), 4u);
+
+        shouldEqual(arena.size(), 13u);
+        shouldEqual(arena.peakSize(), 13u);
+        shouldEqual(arena.allocationCount(), 18u);
+
+        BlockAllocatorStatistics stats = arena.statistics();
+        shouldEqual(stats.blockSize, 4u);
+        shouldEqual(stats.blockCount, 4u);
+        shouldEqual(stats.peakSize, 13u);
+        shouldEqual(stats.allocationCount, 18u);
+        for(int k=5; k<10; ++k)
+            shouldEqual(records[k]->label, k);
+    }
+};
+
 struct SizedIntTest
 {
     void testSizedInt()
@@ -484,6 +623,9 @@ struct UtilitiesTestSuite
         add( testCase( &BucketQueueTest::testAscending));
         add( testCase( &BucketQueueTest::testDescendingMapped));
         add( testCase( &BucketQueueTest::testAscendingMapped));
+        add( testCase( &UnionFindTest::testSequential));
+        add( testCase( &UnionFindTest::testConcurrentStress));
+        add( testCase( &BlockAllocatorTest::testAllocation));
         add( testCase( &SizedIntTest::testSizedInt));
         add( testCase( &MetaprogrammingTest::testInt));
         add( testCase( &MetaprogrammingTest::testLogic));
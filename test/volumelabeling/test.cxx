@@ -39,6 +39,7 @@
 #include "unittest.hxx"
 
 #include "vigra/labelvolume.hxx"
+#include "vigra/random.hxx"
 
 using namespace vigra;
 
@@ -383,6 +384,56 @@ struct VolumeLabelingTest
 
 	}
 
+    void labelingParallelTest()
+    {
+        // random volumes with blobs of different sizes, and thin volumes 
+        // with fewer planes than threads
+        IntVolume::difference_type shapes[] = { 
+            IntVolume::difference_type(23, 17, 31), 
+            IntVolume::difference_type(9, 11, 2),
+            IntVolume::difference_type(40, 3, 7) };
+        RandomMT19937 random(42);
+        for(int s=0; s<3; ++s)
+        {
+            for(int valueCount=2; valueCount<=4; ++valueCount)
+            {
+                IntVolume src(shapes[s]), res(shapes[s]), parallelRes(shapes[s]);
+                for(IntVolume::iterator i = src.begin(); i != src.end(); ++i)
+                    *i = random.uniformInt(valueCount);
+
+                for(int threads=0; threads<6; ++threads)
+                {
+                    ParallelOptions options;
+                    options.numThreads(threads);
+
+                    unsigned int count = labelVolumeSix(srcMultiArrayRange(src), destMultiArray(res));
+                    shouldEqual(labelVolumeSix(srcMultiArrayRange(src), destMultiArray(parallelRes), 
+                                               options), count);
+                    should(res == parallelRes);
+
+                    count = labelVolume(srcMultiArrayRange(src), destMultiArray(res), 
+                                        NeighborCode3DTwentySix());
+                    shouldEqual(labelVolume(srcMultiArrayRange(src), destMultiArray(parallelRes), 
+                                            NeighborCode3DTwentySix(), options), count);
+                    should(res == parallelRes);
+
+                    count = labelVolumeWithBackground(srcMultiArrayRange(src), destMultiArray(res), 
+                                                      NeighborCode3DSix(), 0);
+                    parallelRes.init(-1);
+                    shouldEqual(labelVolumeWithBackground(srcMultiArrayRange(src), destMultiArray(parallelRes), 
+                                                          NeighborCode3DSix(), 0, options), count);
+                    should(res == parallelRes);
+
+                    count = labelVolumeWithBackground(srcMultiArrayRange(src), destMultiArray(res), 
+                                                      NeighborCode3DTwentySix(), 0);
+                    shouldEqual(labelVolumeWithBackground(srcMultiArrayRange(src), destMultiArray(parallelRes), 
+                                                          NeighborCode3DTwentySix(), 0, options), count);
+                    should(res == parallelRes);
+                }
+            }
+        }
+    }
+
     IntVolume vol1, vol2, vol3;
     DoubleVolume vol4, vol5, vol6;
 };
@@ -405,6 +456,7 @@ struct VolumeLabelingTestSuite
         add( testCase( &VolumeLabelingTest::labelingTwentySixTest3));
         add( testCase( &VolumeLabelingTest::labelingTwentySixWithBackgroundTest1));
 		add( testCase( &VolumeLabelingTest::labelingAllTest));
+        add( testCase( &VolumeLabelingTest::labelingParallelTest));
     }
 };
 
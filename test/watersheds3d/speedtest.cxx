@@ -0,0 +1,125 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2004 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#include <iostream>
+#include <cmath>
+#include "unittest.hxx"
+#include "vigra/watersheds3d.hxx"
+#include "vigra/multi_array.hxx"
+#include "vigra/random.hxx"
+#include "vigra/timing.hxx"
+
+using namespace vigra;
+
+// Compares the dimension-independent watershedsUnionFind() with 
+// watersheds3DSix() and watersheds3DTwentySix() on a 512^3 volume 
+// of smooth basins with a little noise.
+struct WatershedsSpeedTest
+{
+    typedef MultiArray<3, float> Volume;
+    typedef MultiArray<3, int>   LabelVolume;
+
+    enum { size = 512 };
+
+    Volume volume;
+
+    WatershedsSpeedTest()
+    : volume(Volume::difference_type(size, size, size))
+    {
+        RandomMT19937 random(1);
+        for(int z=0; z<size; ++z)
+            for(int y=0; y<size; ++y)
+                for(int x=0; x<size; ++x)
+                    volume(x, y, z) = (float)(std::sin(x / 7.0) + std::sin(y / 9.0) + 
+                                              std::sin(z / 11.0) + 0.01*random.uniform());
+    }
+
+    void compare(NeighborhoodType neighborhood)
+    {
+        LabelVolume labels(volume.shape()), labelsND(volume.shape());
+        unsigned int count;
+        {
+            USETICTOC;
+            TIC;
+            count = neighborhood == DirectNeighborhood
+                        ? watersheds3DSix(srcMultiArrayRange(volume), destMultiArray(labels))
+                        : watersheds3DTwentySix(srcMultiArrayRange(volume), destMultiArray(labels));
+            std::cout << (neighborhood == DirectNeighborhood ? "watersheds3DSix: " 
+                                                             : "watersheds3DTwentySix: ")
+                      << TOCS << " (" << count << " regions)" << std::endl;
+        }
+        {
+            USETICTOC;
+            TIC;
+            unsigned int countND = watershedsUnionFind(volume, labelsND, neighborhood);
+            std::cout << "watershedsUnionFind, " 
+                      << (neighborhood == DirectNeighborhood ? "direct" : "indirect") 
+                      << " neighborhood: " << TOCS << " (" << countND << " regions)" << std::endl;
+            shouldEqual(countND, count);
+        }
+        should(labels == labelsND);
+    }
+
+    void testDirect()
+    {
+        compare(DirectNeighborhood);
+    }
+
+    void testIndirect()
+    {
+        compare(IndirectNeighborhood);
+    }
+};
+
+struct WatershedsSpeedTestSuite
+: public vigra::test_suite
+{
+    WatershedsSpeedTestSuite()
+    : vigra::test_suite("WatershedsSpeedTestSuite")
+    {
+        add( testCase( &WatershedsSpeedTest::testDirect));
+        add( testCase( &WatershedsSpeedTest::testIndirect));
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    WatershedsSpeedTestSuite test;
+
+    int failed = test.run(vigra::testsToBeExecuted(argc, argv));
+
+    std::cout << test.report() << std::endl;
+    return (failed != 0);
+}
@@ -40,7 +40,9 @@
 
 #include "vigra/watersheds3d.hxx"
 #include "vigra/multi_array.hxx"
+#include "vigra/random.hxx"
 #include "list"
+#include <queue>
 
 #include <stdlib.h>
 #include <time.h>
@@ -456,10 +458,232 @@ struct Watersheds3dTest
         }
     }
 
+    void testWatershedsUnionFindND()
+    {
+        RandomMT19937 random(42);
+
+        DVolume vol(IntVolume::difference_type(30, 25, 20));
+        for(DVolume::iterator iter=vol.begin(); iter!=vol.end(); ++iter)
+            *iter = random.uniform();
+
+        IntVolume labelVolume(vol.shape()), labelVolumeND(vol.shape());
+
+        int max_region_label = vigra::watersheds3DSix( vigra::srcMultiArrayRange(vol),
+                                                       vigra::destMultiArray(labelVolume));
+        int max_region_labelND = vigra::watershedsUnionFind(vol, labelVolumeND, DirectNeighborhood);
+        shouldEqual(max_region_label, max_region_labelND);
+        should(labelVolume == labelVolumeND);
+
+        max_region_label = vigra::watersheds3DTwentySix( vigra::srcMultiArrayRange(vol),
+                                                         vigra::destMultiArray(labelVolume));
+        max_region_labelND = vigra::watershedsUnionFind(vol, labelVolumeND);
+        shouldEqual(max_region_label, max_region_labelND);
+        should(labelVolume == labelVolumeND);
+
+        // 2D arrays give the same result as the image version
+        MultiArray<2, double> image(MultiArrayShape<2>::type(40, 30));
+        for(MultiArray<2, double>::iterator iter=image.begin(); iter!=image.end(); ++iter)
+            *iter = random.uniform();
+        MultiArray<2, int> labelImage(image.shape()), labelImageND(image.shape());
+
+        max_region_label = vigra::watershedsUnionFind(srcImageRange(image), destImage(labelImage),
+                                                      FourNeighborCode());
+        max_region_labelND = vigra::watershedsUnionFind(image, labelImageND, DirectNeighborhood);
+        shouldEqual(max_region_label, max_region_labelND);
+        should(labelImage == labelImageND);
+
+        max_region_label = vigra::watershedsUnionFind(srcImageRange(image), destImage(labelImage),
+                                                      EightNeighborCode());
+        max_region_labelND = vigra::watershedsUnionFind(image, labelImageND, IndirectNeighborhood);
+        shouldEqual(max_region_label, max_region_labelND);
+        should(labelImage == labelImageND);
+    }
+
+    void testWatershedsUnionFindNDPlateaus()
+    {
+        // few gray levels, so that the input contains large plateaus
+        RandomMT19937 random(42);
+
+        DVolume vol(IntVolume::difference_type(30, 25, 20));
+        for(DVolume::iterator iter=vol.begin(); iter!=vol.end(); ++iter)
+            *iter = (double)random.uniformInt(4);
+
+        IntVolume labelVolume(vol.shape()), labelVolumeND(vol.shape());
+
+        int max_region_label = vigra::watersheds3DSix( vigra::srcMultiArrayRange(vol),
+                                                       vigra::destMultiArray(labelVolume));
+        int max_region_labelND = vigra::watershedsUnionFind(vol, labelVolumeND, DirectNeighborhood);
+        shouldEqual(max_region_label, max_region_labelND);
+        should(labelVolume == labelVolumeND);
+
+        max_region_label = vigra::watersheds3DTwentySix( vigra::srcMultiArrayRange(vol),
+                                                         vigra::destMultiArray(labelVolume));
+        max_region_labelND = vigra::watershedsUnionFind(vol, labelVolumeND);
+        shouldEqual(max_region_label, max_region_labelND);
+        should(labelVolume == labelVolumeND);
+
+        // 2D arrays give the same result as a volume of two identical slices
+        // (the image version of watershedsUnionFind() resolves plateaus 
+        // differently, and watersheds3D() does not support a single slice)
+        DVolume slice(IntVolume::difference_type(40, 30, 2));
+        MultiArrayView<2, double> image = slice.bindOuter(0);
+        for(MultiArrayView<2, double>::iterator iter=image.begin(); iter!=image.end(); ++iter)
+            *iter = (double)random.uniformInt(4);
+        slice.bindOuter(1) = image;
+        IntVolume labelSlice(slice.shape());
+        MultiArray<2, int> labelImageND(image.shape());
+
+        max_region_label = vigra::watersheds3DSix( vigra::srcMultiArrayRange(slice),
+                                                   vigra::destMultiArray(labelSlice));
+        max_region_labelND = vigra::watershedsUnionFind(image, labelImageND, DirectNeighborhood);
+        shouldEqual(max_region_label, max_region_labelND);
+        should(labelSlice.bindOuter(0) == labelImageND);
+
+        max_region_label = vigra::watersheds3DTwentySix( vigra::srcMultiArrayRange(slice),
+                                                         vigra::destMultiArray(labelSlice));
+        max_region_labelND = vigra::watershedsUnionFind(image, labelImageND, IndirectNeighborhood);
+        shouldEqual(max_region_label, max_region_labelND);
+        should(labelSlice.bindOuter(0) == labelImageND);
+    }
 
 };
 
 
+struct WatershedsBlockwiseTest
+{
+    typedef MultiArrayShape<3>::type Shape;
+
+    MultiArray<3, UInt16> boundaries;
+    MultiArray<3, UInt32> seeds;
+
+    // voronoi-like boundary map: distance to the nearest of some random points,
+    // plus a little noise to avoid plateaus
+    WatershedsBlockwiseTest()
+    : boundaries(Shape(48, 40, 36)),
+      seeds(Shape(48, 40, 36))
+    {
+        RandomMT19937 random(3);
+        ArrayVector<Shape> points;
+        for(UInt32 label=1; label<=40; ++label)
+        {
+            Shape p(random.uniformInt(48), random.uniformInt(40), random.uniformInt(36));
+            if(seeds[p] != 0)
+                continue;
+            seeds[p] = label;
+            points.push_back(p);
+        }
+        for(int z=0; z<36; ++z)
+        for(int y=0; y<40; ++y)
+        for(int x=0; x<48; ++x)
+        {
+            double dist = NumericTraits<double>::max();
+            for(unsigned int k=0; k<points.size(); ++k)
+                dist = std::min(dist, norm(Shape(x,y,z) - points[k]));
+            boundaries(x,y,z) = (UInt16)(1000.0*dist + random.uniformInt(100));
+        }
+    }
+
+    // lowest flooding level of every voxel, i.e. the smallest maximal 
+    // height along a path from any seed
+    void floodingLevels(ArrayVector<Shape> const & neighbors, MultiArray<3, int> & levels)
+    {
+        typedef std::pair<int, MultiArrayIndex> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > pqueue;
+        levels.reshape(seeds.shape(), NumericTraits<int>::max());
+        for(int k=0; k<seeds.size(); ++k)
+            if(seeds[k] != 0)
+                pqueue.push(Entry(boundaries[k], k));
+        while(!pqueue.empty())
+        {
+            Entry e = pqueue.top();
+            pqueue.pop();
+            if(levels[e.second] <= e.first)
+                continue;
+            levels[e.second] = e.first;
+            Shape p = levels.scanOrderIndexToCoordinate(e.second);
+            for(unsigned int n=0; n<neighbors.size(); ++n)
+            {
+                Shape q = p + neighbors[n];
+                if(levels.isInside(q))
+                    pqueue.push(Entry(std::max(e.first, (int)boundaries[q]), 
+                                      levels.coordinateToScanOrderIndex(q)));
+            }
+        }
+    }
+
+    // every voxel must be reached by its own region at the lowest flooding level
+    bool isWatershedLabeling(MultiArray<3, UInt32> const & labels, 
+                             ArrayVector<Shape> const & neighbors, 
+                             MultiArray<3, int> const & levels)
+    {
+        for(int k=0; k<labels.size(); ++k)
+        {
+            if(labels[k] == 0)
+                return false;
+            if(seeds[k] != 0)
+            {
+                if(labels[k] != seeds[k])
+                    return false;
+                continue;
+            }
+            Shape p = labels.scanOrderIndexToCoordinate(k);
+            bool reached = false;
+            for(unsigned int n=0; n<neighbors.size(); ++n)
+            {
+                Shape q = p + neighbors[n];
+                if(labels.isInside(q) && labels[q] == labels[k] && 
+                   std::max(levels[q], (int)boundaries[k]) == levels[k])
+                    reached = true;
+            }
+            if(!reached)
+                return false;
+        }
+        return true;
+    }
+
+    void testBlockwise()
+    {
+        NeighborhoodType neighborhoods[] = { DirectNeighborhood, IndirectNeighborhood };
+        for(int n=0; n<2; ++n)
+        {
+            ArrayVector<Shape> neighbors;
+            detail::makeNeighborhoodOffsets(neighborhoods[n], neighbors);
+            MultiArray<3, int> levels;
+            floodingLevels(neighbors, levels);
+
+            MultiArray<3, UInt32> reference(seeds);
+            ArrayOfRegionStatistics<SeedRgDirectValueFunctor<UInt16> > stats(40);
+            UInt32 maxLabel = fastSeededRegionGrowing(boundaries, reference, stats, CompleteGrow, 
+                                                      neighborhoods[n], NumericTraits<double>::max(), 
+                                                      1 << 16);
+            should(isWatershedLabeling(reference, neighbors, levels));
+
+            // a single block
+            MultiArray<3, UInt32> labels(seeds);
+            shouldEqual(watershedsBlockwise(boundaries, labels, boundaries.shape(),
+                                            ParallelOptions(), neighborhoods[n], 1 << 16), 
+                        maxLabel);
+            should(isWatershedLabeling(labels, neighbors, levels));
+
+            // many blocks, whose results must be independent of the number of threads
+            MultiArray<3, UInt32> previous;
+            int threads[] = { 0, 4 };
+            for(int t=0; t<2; ++t)
+            {
+                labels = seeds;
+                shouldEqual(watershedsBlockwise(boundaries, labels, Shape(16, 12, 5),
+                                                ParallelOptions().numThreads(threads[t]), 
+                                                neighborhoods[n], 1 << 16), 
+                            maxLabel);
+                should(isWatershedLabeling(labels, neighbors, levels));
+                if(t > 0)
+                    should(labels == previous);
+                previous = labels;
+            }
+        }
+    }
+};
+
 struct SimpleAnalysisTestSuite
 : public vigra::test_suite
 {
@@ -472,6 +696,9 @@ struct SimpleAnalysisTestSuite
         add( testCase( &Watersheds3dTest::testWatersheds3dSix2));
         add( testCase( &Watersheds3dTest::testWatersheds3dGradient1));
         add( testCase( &Watersheds3dTest::testWatersheds3dGradient2));
+        add( testCase( &Watersheds3dTest::testWatershedsUnionFindND));
+        add( testCase( &Watersheds3dTest::testWatershedsUnionFindNDPlateaus));
+        add( testCase( &WatershedsBlockwiseTest::testBlockwise));
     }
 };
 